@@ -0,0 +1,102 @@
+#include <stdint.h>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include "clock.h"
+#include "bus.h"
+#include "ffwrapper.h"
+#include "audio_render.h"
+#include "host_frame.h"
+#include "host_avi.h"
+
+#define TEST_SAMPLE_RATE    44100
+#define TEST_FRAMES         (TEST_SAMPLE_RATE*3/2)
+#define WAV_HEADER_SIZE     44
+
+// the decoded frames of the engine, pushed on as the render takes them
+static int feed(FFWrapper* engine, AudioRender* render) {
+    int firstSamples = -1;
+    for (;;) {
+        AVPacket packet;
+        bool isEOF = false;
+        if (!engine->readPacket(packet, &isEOF)) {
+            if (isEOF) {
+                break;
+            }
+            continue;
+        }
+        if (engine->isAudio(packet)) {
+            CHECK(engine->sendAudioPacket(&packet));
+        }
+        engine->freePacket(packet);
+        AVFrame* frame = nullptr;
+        while (engine->receiveAudioFrame(&frame)) {
+            if (firstSamples < 0) {
+                firstSamples = frame->nb_samples;
+            }
+            while (render->onBuffer(Buffer(BUFFER_AVFRAME, frame)) != STATUS_SUCCESS) {
+                usleep(5000);
+            }
+        }
+    }
+    return firstSamples;
+}
+
+// the samples of an AVI file decoded by the engine, played in real time by the audio render through a WavAudioDevice,
+// which saves the samples it consumes. the render takes the first frame for the clock only
+int main() {
+    std::string input = "audio_render_test_in.avi";
+    std::string output = "audio_render_test_out.wav";
+    AviLayout layout;
+    layout.sampleRate = TEST_SAMPLE_RATE;
+    layout.frames = TEST_FRAMES;
+    std::vector<int16_t> samples = writeAvi(input, layout);
+
+    FFWrapper engine;
+    CHECK(engine.open(input.c_str()));
+    CHECK(engine.audioSampleRate() == TEST_SAMPLE_RATE);
+    Bus bus;
+    AudioRender render;
+    CHECK(render.setDevice("WavAudioDevice"));
+    CHECK(render.setDeviceProperty(AUDIO_FILE_PATH, (void*)output.c_str()));
+    render.setBus(&bus);
+    render.setEngine(&engine);
+    CHECK(render.setState(STATE_READY) == STATUS_SUCCESS);
+    CHECK(render.setState(STATE_PAUSED) == STATUS_SUCCESS);
+    CHECK(render.setState(STATE_PLAYING) == STATUS_SUCCESS);
+
+    int64_t start = monotonicTime();
+    int firstSamples = feed(&engine, &render);
+    CHECK(firstSamples > 0);
+    CHECK(render.onEvent(Event(EVENT_EOS)) == STATUS_SUCCESS);
+    Message message;
+    while (!bus.getMessage(message) || message.id != MESSAGE_EOS) {
+        CHECK(monotonicTime() - start < 10000000);
+        usleep(5000);
+    }
+    int64_t elapsed = monotonicTime() - start;
+    // written in real time, up to the buffer of the device ahead of the playback
+    int64_t duration = int64_t(TEST_FRAMES - firstSamples)*1000000/TEST_SAMPLE_RATE;
+    printf("audio_render_test: %lldms of samples written in %lldms\n", (long long)duration/1000,
+        (long long)elapsed/1000);
+    CHECK(elapsed >= duration - 300000);
+    // the clock stops with the device once the samples are played out, it may have been read
+    // a little ahead before the device was seen stalled
+    usleep(400000);
+    int64_t running = render.getClock()->runningTime();
+    CHECK(running > duration - 50000 && running <= duration + AUDIO_CLOCK_STALL_TIME);
+
+    CHECK(render.setState(STATE_PAUSED) == STATUS_SUCCESS);
+    CHECK(render.setState(STATE_READY) == STATUS_SUCCESS);
+    CHECK(render.setState(STATE_NULL) == STATUS_SUCCESS);
+
+    // all samples after the first frame, unchanged
+    std::vector<uint8_t> saved = readFile(output);
+    CHECK(saved.size() == WAV_HEADER_SIZE + (samples.size() - firstSamples*2)*2);
+    CHECK(!memcmp(saved.data() + WAV_HEADER_SIZE, samples.data() + firstSamples*2, saved.size() - WAV_HEADER_SIZE));
+    unlink(input.c_str());
+    unlink(output.c_str());
+    printf("audio_render_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,239 @@
+#include <stdint.h>
+#include <chrono>
+#include "clock.h"
+#include "utils.h"
+#include "audio_device.h"
+#include "frame_scheduler.h"
+#include "video_qos.h"
+#include "host_frame.h"
+
+#define TEST_SAMPLE_RATE    44100
+// NOTES: in microseconds, the period the fake device position moves in
+#define DEVICE_PERIOD       10000
+#define FRAME_DURATION      40000
+// of the render, see video_render.cpp
+#define RENDER_WAIT_SLICE   10000
+
+//
+// A device whose playback position is set by the test, in sample frames
+//
+struct FakeAudioDevice: public AudioDevice {
+    bool setProperty(int key, void* value) override {
+        return true;
+    }
+    int getSampleRate() override {
+        return TEST_SAMPLE_RATE;
+    }
+    int getSampleFormat() override {
+        return 1;
+    }
+    int getChannels() override {
+        return 2;
+    }
+    int getPlaybackPosition() override {
+        return frames;
+    }
+    int write(void* buf, int buflen) override {
+        return buflen;
+    }
+    void play() override {}
+    void pause() override {}
+    void flush() override {}
+    void stop() override {}
+
+    int frames = 0;
+};
+
+static int64_t distance(int64_t a, int64_t b) {
+    return a > b ? a - b : b - a;
+}
+
+// NOTES: the device plays for duration, the time moves with it one device period at a time
+static void play(FakeTimeSource* time, FakeAudioDevice* device, int64_t duration) {
+    for (int64_t played = 0; played < duration; played += DEVICE_PERIOD) {
+        time->advance(DEVICE_PERIOD);
+        device->frames += TEST_SAMPLE_RATE*DEVICE_PERIOD/1000000;
+    }
+}
+
+// the clock follows the device, between the readings of the device too, and stops with it
+static void testClock(FakeTimeSource* time) {
+    FakeAudioDevice device;
+    AudioDeviceClock clock(&device);
+    clock.setOffset(5000000);
+    // not playing yet
+    time->advance(200000);
+    CHECK(clock.runningTime() == 5000000);
+    play(time, &device, 1000000);
+    CHECK(distance(clock.runningTime(), 6000000) <= DEVICE_PERIOD);
+    // interpolated until the next reading of the device
+    int64_t running = clock.runningTime();
+    time->advance(AUDIO_CLOCK_SAMPLE_INTERVAL/2);
+    CHECK(clock.runningTime() == running + AUDIO_CLOCK_SAMPLE_INTERVAL/2);
+    // the device stalls, the clock stops where it is within the stall time
+    time->advance(AUDIO_CLOCK_STALL_TIME + AUDIO_CLOCK_SAMPLE_INTERVAL);
+    running = clock.runningTime();
+    CHECK(running <= 6000000 + AUDIO_CLOCK_STALL_TIME + AUDIO_CLOCK_SAMPLE_INTERVAL);
+    time->advance(1000000);
+    CHECK(clock.runningTime() == running);
+
+    // a plain clock has one segment
+    Clock plain;
+    CHECK(plain.getSegment() == 0 && plain.untilNextSegment() == -1);
+}
+
+// frames on time are presented at their deadline, late ones are dropped, as the render does it
+static void testScheduler(FakeTimeSource* time) {
+    FakeAudioDevice device;
+    AudioDeviceClock clock(&device);
+    clock.setOffset(0);
+    play(time, &device, 200000);
+    FrameScheduler scheduler;
+    scheduler.reset(1000000.0/FRAME_DURATION);
+
+    int64_t pts = clock.runningTime() + FRAME_DURATION;
+    int64_t deadline = 0;
+    CHECK(scheduler.schedule(pts, clock.runningTime(), &deadline) == FrameScheduler::ACTION_PRESENT);
+    CHECK(deadline == time->now() + FRAME_DURATION);
+    CHECK(scheduler.lateness() == -FRAME_DURATION);
+    // the render waits in slices and handles its events in between
+    int slices = 0;
+    while (!scheduler.waitUntil(deadline, RENDER_WAIT_SLICE)) {
+        slices++;
+    }
+    CHECK(slices == FRAME_DURATION/RENDER_WAIT_SLICE - 1);
+    CHECK(time->now() == deadline);
+    int64_t start = time->now();
+    time->advance(5000);
+    scheduler.presented(deadline, start, time->now());
+
+    // writing starts early by the render cost
+    pts += FRAME_DURATION;
+    CHECK(scheduler.schedule(pts, clock.runningTime(), &deadline) == FrameScheduler::ACTION_PRESENT);
+    CHECK(deadline == time->now() + (pts - clock.runningTime()) - 5000);
+
+    // late by more than a frame once written, it's dropped
+    pts = clock.runningTime() - FRAME_DURATION + 4000;
+    CHECK(scheduler.schedule(pts, clock.runningTime(), &deadline) == FrameScheduler::ACTION_DROP);
+    CHECK(scheduler.lateness() == FRAME_DURATION - 4000 + 5000);
+    scheduler.dropped();
+    // late, but shown before the next one is due
+    pts = clock.runningTime() - FRAME_DURATION/2;
+    CHECK(scheduler.schedule(pts, clock.runningTime(), &deadline) == FrameScheduler::ACTION_PRESENT);
+    CHECK(deadline < time->now());
+    CHECK(scheduler.waitUntil(deadline, RENDER_WAIT_SLICE));
+    CHECK(scheduler.stats().presented == 1 && scheduler.stats().dropped == 1);
+}
+
+// a decoder slower than the frame rate raises the skip level one step at a time, frames in time
+// lower it again
+static void testQoS(FakeTimeSource* time) {
+    FakeAudioDevice device;
+    AudioDeviceClock clock(&device);
+    clock.setOffset(0);
+    FrameScheduler scheduler;
+    scheduler.reset(1000000.0/FRAME_DURATION);
+    VideoQoS qos;
+    qos.reset(1000000.0/FRAME_DURATION);
+    qos.resetStats();
+
+    // each frame takes 60ms to decode, so it's later than the one before
+    int64_t pts = 0;
+    int64_t raised[SKIP_LEVELS] = {0};
+    while (qos.level() < SKIP_LEVEL_TO_KEYFRAME) {
+        play(time, &device, 60000);
+        int64_t deadline = 0;
+        if (scheduler.schedule(pts, clock.runningTime(), &deadline) == FrameScheduler::ACTION_DROP) {
+            scheduler.dropped();
+        }
+        if (qos.report(scheduler.lateness(), time->now())) {
+            raised[qos.level()] = time->now();
+        }
+        pts += FRAME_DURATION;
+        CHECK(pts < 60000000);
+    }
+    // each step had its time to take effect
+    for (int level = SKIP_LEVEL_FILTER; level <= SKIP_LEVEL_TO_KEYFRAME; level++) {
+        CHECK(raised[level] - raised[level - 1] >= 500000);
+    }
+    CHECK(scheduler.stats().dropped > 0);
+    QoSStats stats = qos.getStats();
+    CHECK(stats.level == SKIP_LEVEL_TO_KEYFRAME && stats.levelChanges == SKIP_LEVEL_TO_KEYFRAME);
+
+    // the packets already late are skipped up to the next keyframe
+    int64_t running = clock.runningTime();
+    CHECK(!qos.skipPacket(false, running + 1000, running));
+    CHECK(qos.skipPacket(false, running - 1000, running));
+    CHECK(qos.skipPacket(false, running + 1000, running));
+    CHECK(!qos.skipPacket(true, running - 1000, running));
+    CHECK(qos.getStats().skippedPackets == 2);
+    // no more than the top level
+    CHECK(!qos.report(FRAME_DURATION*10, time->now() + 1000000));
+
+    // in time again, down one level per period in time
+    int64_t start = time->now();
+    while (qos.level() > SKIP_LEVEL_NONE) {
+        play(time, &device, FRAME_DURATION);
+        qos.report(-FRAME_DURATION/2, time->now());
+        CHECK(time->now() - start < 20000000);
+    }
+    CHECK(time->now() - start >= SKIP_LEVEL_TO_KEYFRAME*2000000);
+    CHECK(qos.getStats().levelChanges == 2*SKIP_LEVEL_TO_KEYFRAME);
+}
+
+// the next source starts once the device plays its first sample: the render waits for it in the
+// time of the clock, which the fake time source doesn't block on
+static void testSegmentSwitch(FakeTimeSource* time) {
+    FakeAudioDevice device;
+    AudioDeviceClock clock(&device);
+    Clock* base = &clock;
+    clock.setOffset(30000000);
+    play(time, &device, 500000);
+    Notifier notifier;
+    base->setSegmentNotifier(&notifier);
+    CHECK(base->getSegment() == 0 && base->untilNextSegment() == -1);
+
+    // the next source follows the 300ms still queued in the device, its pts start at 0
+    int64_t position = device.frames*int64_t(1000000)/TEST_SAMPLE_RATE + 300000;
+    clock.setNextOffset(position, 0);
+    CHECK(notifier.waitUntil(time->now() + 1000000));
+    CHECK(base->getSegment() == 0);
+    int64_t remaining = base->untilNextSegment();
+    CHECK(distance(remaining, 300000) <= DEVICE_PERIOD);
+
+    // the render holds the first frame of the next source while the clock is in the segment
+    // before, nothing wakes it up until the switch
+    std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+    int64_t deadline = time->now() + remaining + 1000;
+    CHECK(!notifier.waitUntil(deadline));
+    CHECK(time->now() == deadline);
+    CHECK(std::chrono::steady_clock::now() - waitStart < std::chrono::milliseconds(100));
+    // the device played on meanwhile, the first reading past the switch is in the new segment
+    device.frames += TEST_SAMPLE_RATE*(remaining + 1000)/1000000;
+    int64_t running = base->runningTime();
+    CHECK(base->getSegment() == 1);
+    CHECK(base->untilNextSegment() == -1);
+    CHECK(distance(running, 1000) <= DEVICE_PERIOD);
+
+    // its frames are on time in the new segment
+    FrameScheduler scheduler;
+    scheduler.reset(1000000.0/FRAME_DURATION);
+    int64_t frameDeadline = 0;
+    CHECK(scheduler.schedule(running + FRAME_DURATION/2, running, &frameDeadline) == FrameScheduler::ACTION_PRESENT);
+    CHECK(scheduler.lateness() == -FRAME_DURATION/2);
+    base->setSegmentNotifier(nullptr);
+}
+
+// clock, scheduler and QoS decisions driven by a fake time source and a fake device, so they're
+// the same on every run and take no time
+int main() {
+    FakeTimeSource time(1000000);
+    TimeSource::install(&time);
+    testClock(&time);
+    testScheduler(&time);
+    testQoS(&time);
+    testSegmentSwitch(&time);
+    TimeSource::install(nullptr);
+    printf("av_sync_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include <stdint.h>
+#include <unistd.h>
+#include <vector>
+#include <string>
+#include "byte_source.h"
+#include "host_frame.h"
+#include "host_avi.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#define TEST_SIZE           100000
+#define TEST_SAMPLE_RATE    44100
+
+// NOTES: a MemorySource which doesn't know its size, like a live stream
+class UnsizedSource: public MemorySource {
+public:
+    UnsizedSource(const uint8_t* data, int64_t size) : MemorySource(data, size) {}
+    int64_t size() override {
+        return -1;
+    }
+};
+
+static int readAt(AVIOContext* context, uint8_t* buf, int size) {
+    return context->read_packet(context->opaque, buf, size);
+}
+
+static int64_t seekTo(AVIOContext* context, int64_t offset, int whence) {
+    return context->seek(context->opaque, offset, whence);
+}
+
+// the callbacks of the context as FFmpeg calls them
+static void testCallbacks(const std::vector<uint8_t>& data) {
+    MemorySource source(data.data(), data.size());
+    AVIOContext* context = ByteSource::openContext(&source, 0);
+    CHECK(context);
+    CHECK(context->buffer_size >= 4096);
+    CHECK(seekTo(context, 0, AVSEEK_SIZE) == TEST_SIZE);
+    CHECK(seekTo(context, 0, AVSEEK_SIZE | AVSEEK_FORCE) == TEST_SIZE);
+
+    uint8_t buf[256];
+    CHECK(seekTo(context, 1000, SEEK_SET) == 1000);
+    CHECK(readAt(context, buf, 10) == 10);
+    CHECK(!memcmp(buf, data.data() + 1000, 10));
+    // from after the read
+    CHECK(seekTo(context, 500, SEEK_CUR) == 1510);
+    CHECK(readAt(context, buf, 20) == 20);
+    CHECK(!memcmp(buf, data.data() + 1510, 20));
+    CHECK(seekTo(context, -30, SEEK_CUR | AVSEEK_FORCE) == 1500);
+    CHECK(readAt(context, buf, 1) == 1 && buf[0] == data[1500]);
+    // before the start, the position is kept
+    CHECK(seekTo(context, -2000, SEEK_CUR) == AVERROR(EINVAL));
+    CHECK(seekTo(context, -1, SEEK_SET) == AVERROR(EINVAL));
+    CHECK(seekTo(context, -TEST_SIZE - 1, SEEK_END) == AVERROR(EINVAL));
+    CHECK(readAt(context, buf, 1) == 1 && buf[0] == data[1501]);
+
+    // the last bytes, then the end
+    CHECK(seekTo(context, -100, SEEK_END) == TEST_SIZE - 100);
+    CHECK(readAt(context, buf, 200) == 100);
+    CHECK(!memcmp(buf, data.data() + TEST_SIZE - 100, 100));
+    CHECK(readAt(context, buf, 200) == AVERROR_EOF);
+    CHECK(seekTo(context, 0, SEEK_END) == TEST_SIZE);
+    CHECK(readAt(context, buf, 1) == AVERROR_EOF);
+    // past the end is allowed, nothing is read there
+    CHECK(seekTo(context, TEST_SIZE + 10, SEEK_SET) == TEST_SIZE + 10);
+    CHECK(readAt(context, buf, 1) == AVERROR_EOF);
+    CHECK(seekTo(context, -10, SEEK_CUR) == TEST_SIZE);
+    CHECK(readAt(context, buf, 1) == AVERROR_EOF);
+    CHECK(seekTo(context, 0, SEEK_SET) == 0);
+    CHECK(readAt(context, buf, 1) == 1 && buf[0] == data[0]);
+    ByteSource::closeContext(&context);
+    CHECK(!context);
+
+    // nothing is relative to an unknown end
+    UnsizedSource unsized(data.data(), data.size());
+    context = ByteSource::openContext(&unsized, 4096);
+    CHECK(context);
+    CHECK(seekTo(context, 0, AVSEEK_SIZE) == AVERROR(ENOSYS));
+    CHECK(seekTo(context, -100, SEEK_END) == AVERROR(EINVAL));
+    CHECK(seekTo(context, 2000, SEEK_SET) == 2000);
+    CHECK(readAt(context, buf, 4) == 4 && !memcmp(buf, data.data() + 2000, 4));
+    ByteSource::closeContext(&context);
+}
+
+// the buffered reads of FFmpeg over the context
+static void testBufferedReads(const std::vector<uint8_t>& data) {
+    MemorySource source(data.data(), data.size());
+    AVIOContext* context = ByteSource::openContext(&source, 4096);
+    CHECK(context);
+    CHECK(avio_size(context) == TEST_SIZE);
+    std::vector<uint8_t> buf(TEST_SIZE);
+    CHECK(avio_seek(context, 5000, SEEK_SET) == 5000);
+    CHECK(avio_read(context, buf.data(), 3000) == 3000);
+    CHECK(!memcmp(buf.data(), data.data() + 5000, 3000));
+    CHECK(avio_seek(context, 100, SEEK_CUR) == 8100);
+    CHECK(avio_read(context, buf.data(), 10) == 10);
+    CHECK(!memcmp(buf.data(), data.data() + 8100, 10));
+    // large reads, straight into the buffer of the caller
+    CHECK(avio_seek(context, 0, SEEK_SET) == 0);
+    CHECK(avio_read(context, buf.data(), TEST_SIZE) == TEST_SIZE);
+    CHECK(buf == data);
+    CHECK(avio_read(context, buf.data(), 1) <= 0);
+    CHECK(avio_seek(context, TEST_SIZE - 4, SEEK_SET) == TEST_SIZE - 4);
+    CHECK(avio_read(context, buf.data(), 100) == 4);
+    CHECK(!memcmp(buf.data(), data.data() + TEST_SIZE - 4, 4));
+    ByteSource::closeContext(&context);
+}
+
+// an AVI demuxed from memory, its audio packets are the samples written
+static void testDemuxer() {
+    std::string path = "byte_source_test.avi";
+    AviLayout layout;
+    layout.sampleRate = TEST_SAMPLE_RATE;
+    layout.frames = TEST_SAMPLE_RATE/2;
+    std::vector<int16_t> samples = writeAvi(path, layout);
+    std::vector<uint8_t> file = readFile(path);
+    unlink(path.c_str());
+
+    av_register_all();
+    MemorySource source(file.data(), file.size());
+    AVIOContext* context = ByteSource::openContext(&source, 32*1024);
+    CHECK(context);
+    AVFormatContext* formatContext = avformat_alloc_context();
+    formatContext->pb = context;
+    // NOTES: the name only hints the format
+    CHECK(avformat_open_input(&formatContext, "memory.avi", nullptr, nullptr) == 0);
+    CHECK(avformat_find_stream_info(formatContext, nullptr) >= 0);
+    int audioIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    int videoIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    CHECK(audioIndex >= 0 && videoIndex >= 0);
+
+    std::vector<uint8_t> audio;
+    int videoPackets = 0;
+    AVPacket packet;
+    av_init_packet(&packet);
+    while (av_read_frame(formatContext, &packet) >= 0) {
+        if (packet.stream_index == audioIndex) {
+            audio.insert(audio.end(), packet.data, packet.data + packet.size);
+        } else if (packet.stream_index == videoIndex) {
+            videoPackets++;
+        }
+        av_packet_unref(&packet);
+    }
+    // a video frame before each chunk of samples
+    int chunkFrames = layout.sampleRate/layout.fps;
+    CHECK(videoPackets == (layout.frames + chunkFrames - 1)/chunkFrames);
+    CHECK(audio.size() == samples.size()*2);
+    CHECK(!memcmp(audio.data(), samples.data(), audio.size()));
+    avformat_close_input(&formatContext);
+    ByteSource::closeContext(&context);
+}
+
+// the AVIOContext of ByteSource::openContext() over a MemorySource: seeks from each origin, the size,
+// reads at and past the end, and a file demuxed from memory
+int main() {
+    std::vector<uint8_t> data(TEST_SIZE);
+    for (int i = 0; i < TEST_SIZE; i++) {
+        data[i] = uint8_t(i*7 + i/256);
+    }
+    testCallbacks(data);
+    testBufferedReads(data);
+    testDemuxer();
+    printf("byte_source_test: passed\n");
+    return 0;
+}
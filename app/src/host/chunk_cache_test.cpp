@@ -0,0 +1,246 @@
+#include <stdint.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "chunk_cache.h"
+#include "host_frame.h"
+
+#define TEST_SIZE       (5*CACHE_CHUNK_SIZE + 100000)
+#define TEST_READ_SIZE  (64*1024)
+
+//
+// A loopback http server of one resource, answering range requests with 206. Each connection is
+// served by its own thread, the client may open the next range before closing the last one.
+//
+class RangeServer {
+public:
+    RangeServer(const std::vector<uint8_t>& data) : data(data) {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        CHECK(bind(listener, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0);
+        socklen_t length = sizeof(address);
+        CHECK(getsockname(listener, reinterpret_cast<struct sockaddr*>(&address), &length) == 0);
+        port = ntohs(address.sin_port);
+        CHECK(listen(listener, 8) == 0);
+        acceptor = std::thread(&RangeServer::accepting, this);
+    }
+
+    ~RangeServer() {
+        // wakes up accept()
+        shutdown(listener, SHUT_RDWR);
+        acceptor.join();
+        close(listener);
+        std::lock_guard<std::mutex> lock(m);
+        for (std::thread& t : connections) {
+            t.join();
+        }
+    }
+
+    std::string url() {
+        return "http://127.0.0.1:" + std::to_string(port) + "/media.mp4";
+    }
+
+    int requests() {
+        return requestCount;
+    }
+
+private:
+    void accepting() {
+        for (;;) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0) {
+                break;
+            }
+            std::lock_guard<std::mutex> lock(m);
+            connections.push_back(std::thread(&RangeServer::serve, this, fd));
+        }
+    }
+
+    // NOTES: one request per connection, the headers end at an empty line
+    void serve(int fd) {
+        std::string request;
+        char c;
+        while (request.size() < 8192 && recv(fd, &c, 1, 0) == 1) {
+            request += c;
+            if (request.size() >= 4 && request.compare(request.size() - 4, 4, "\r\n\r\n") == 0) {
+                break;
+            }
+        }
+        if (request.compare(0, 4, "GET ") != 0) {
+            close(fd);
+            return;
+        }
+        requestCount++;
+        int64_t first = 0;
+        int64_t last = data.size() - 1;
+        size_t range = request.find("Range: bytes=");
+        bool partial = range != std::string::npos;
+        if (partial) {
+            long long a = 0;
+            long long b = -1;
+            if (sscanf(request.c_str() + range, "Range: bytes=%lld-%lld", &a, &b) < 1) {
+                close(fd);
+                return;
+            }
+            first = a;
+            if (b >= 0 && b < last) {
+                last = b;
+            }
+        }
+        char header[256];
+        if (first >= int64_t(data.size())) {
+            snprintf(header, sizeof(header), "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%lld\r\n"
+                "Content-Length: 0\r\nConnection: close\r\n\r\n", (long long)data.size());
+            send(fd, header, strlen(header), MSG_NOSIGNAL);
+            close(fd);
+            return;
+        }
+        if (partial) {
+            snprintf(header, sizeof(header), "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes %lld-%lld/%lld\r\n"
+                "Content-Length: %lld\r\nAccept-Ranges: bytes\r\nConnection: close\r\n\r\n", (long long)first,
+                (long long)last, (long long)data.size(), (long long)(last - first + 1));
+        } else {
+            snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Length: %lld\r\nAccept-Ranges: bytes\r\n"
+                "Connection: close\r\n\r\n", (long long)data.size());
+        }
+        send(fd, header, strlen(header), MSG_NOSIGNAL);
+        // the client goes away on seeks, sends fail then
+        for (int64_t at = first; at <= last; ) {
+            ssize_t n = send(fd, data.data() + at, std::min<int64_t>(last + 1 - at, 65536), MSG_NOSIGNAL);
+            if (n <= 0) {
+                break;
+            }
+            at += n;
+        }
+        close(fd);
+    }
+
+private:
+    const std::vector<uint8_t>& data;
+    int listener = -1;
+    int port = 0;
+    std::atomic<int> requestCount{0};
+    std::thread acceptor;
+    std::mutex m;
+    std::vector<std::thread> connections;
+};
+
+// NOTES: size bytes from offset, as the demuxer reads them
+static void checkRead(ByteSource* source, const std::vector<uint8_t>& data, int64_t offset, int64_t size) {
+    CHECK(source->seek(offset) == offset);
+    std::vector<uint8_t> buf(TEST_READ_SIZE);
+    for (int64_t done = 0; done < size; ) {
+        int n = source->read(buf.data(), int(std::min<int64_t>(TEST_READ_SIZE, size - done)));
+        CHECK(n > 0);
+        CHECK(!memcmp(buf.data(), data.data() + offset + done, n));
+        done += n;
+    }
+}
+
+static void removeDirectory(const std::string& path) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        return;
+    }
+    while (struct dirent* e = readdir(dir)) {
+        if (e->d_name[0] != '.') {
+            unlink((path + "/" + e->d_name).c_str());
+        }
+    }
+    closedir(dir);
+    rmdir(path.c_str());
+}
+
+// remote media played through UrlSource and CachedSource from a loopback server: what was fetched once
+// is played again without a request, also after the cache was closed and opened again, and chunks
+// evicted from a small cache are fetched again
+int main() {
+    std::vector<uint8_t> data(TEST_SIZE);
+    uint32_t seed = 1;
+    for (uint8_t& byte : data) {
+        seed = seed*1664525 + 1013904223;
+        byte = uint8_t(seed >> 24);
+    }
+    RangeServer server(data);
+    std::string url = server.url();
+    std::string directory = "chunk_cache_test_dir";
+    removeDirectory(directory);
+
+    ChunkCache cache;
+    CHECK(cache.open(directory, 64*CACHE_CHUNK_SIZE));
+    {
+        UrlSource upstream(url);
+        CachedSource source(&cache, url, &upstream);
+        CHECK(source.open());
+        CHECK(source.size() == TEST_SIZE);
+        checkRead(&source, data, 0, TEST_SIZE);
+        int fetched = server.requests();
+        CHECK(fetched > 0);
+        CHECK(cache.stats().misses == 6);
+        CHECK(cache.stats().fetchedBytes == TEST_SIZE);
+
+        // replays and seeks within the fetched ranges
+        checkRead(&source, data, 0, TEST_SIZE);
+        checkRead(&source, data, 3*CACHE_CHUNK_SIZE + 12345, 200000);
+        checkRead(&source, data, TEST_SIZE - 1000, 1000);
+        checkRead(&source, data, 100, CACHE_CHUNK_SIZE);
+        CHECK(server.requests() == fetched);
+        printf("chunk_cache_test: %d requests for the first play, none for replays\n", fetched);
+        source.close();
+        upstream.close();
+    }
+    int requests = server.requests();
+
+    // the maps are saved on close and loaded on open, nothing is asked upstream, not even the size
+    int64_t misses = cache.stats().misses;
+    cache.close();
+    CHECK(cache.open(directory, 64*CACHE_CHUNK_SIZE));
+    {
+        UrlSource upstream(url);
+        CachedSource source(&cache, url, &upstream);
+        CHECK(source.open());
+        CHECK(source.size() == TEST_SIZE);
+        checkRead(&source, data, 2*CACHE_CHUNK_SIZE - 10, 20);
+        checkRead(&source, data, 0, TEST_SIZE);
+        CHECK(server.requests() == requests);
+        CHECK(cache.stats().misses == misses);
+    }
+    cache.close();
+    removeDirectory(directory);
+
+    // room for two chunks, the rest is evicted and fetched again
+    CHECK(cache.open(directory, 2*CACHE_CHUNK_SIZE));
+    {
+        UrlSource upstream(url);
+        CachedSource source(&cache, url, &upstream);
+        CHECK(source.open());
+        int64_t evicted = cache.stats().evictedChunks;
+        checkRead(&source, data, 0, TEST_SIZE);
+        CHECK(cache.stats().evictedChunks - evicted >= 4);
+        requests = server.requests();
+        misses = cache.stats().misses;
+        checkRead(&source, data, 0, CACHE_CHUNK_SIZE);
+        CHECK(server.requests() > requests);
+        CHECK(cache.stats().misses == misses + 1);
+        // the last chunk was used just before, it's still cached
+        requests = server.requests();
+        checkRead(&source, data, TEST_SIZE - 1000, 1000);
+        CHECK(server.requests() == requests);
+        checkRead(&source, data, CACHE_CHUNK_SIZE, 2*CACHE_CHUNK_SIZE);
+        printf("chunk_cache_test: %lld chunks evicted, %lld fetched\n", (long long)cache.stats().evictedChunks,
+            (long long)cache.stats().misses);
+    }
+    cache.close();
+    removeDirectory(directory);
+    printf("chunk_cache_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <vector>
+#include "clock.h"
+#include "color_convert.h"
+#include "host_frame.h"
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+//
+// Time per frame of convertToRGBA() against sws_scale() into the same rect, and the largest
+// difference between their pixels, e.g.
+//   color_convert_bench [frames]
+//
+struct Case {
+    const char* name;
+    int width;
+    int height;
+    int format;
+    int dstWidth;
+    int dstHeight;
+};
+
+static const Case cases[] = {
+    {"1080p yuv420p -> 1920x1080",  1920, 1080, AV_PIX_FMT_YUV420P, 1920, 1080},
+    {"720p yuv420p -> 1920x1080",   1280,  720, AV_PIX_FMT_YUV420P, 1920, 1080},
+    {"1080p yuv420p -> 1440x810",   1920, 1080, AV_PIX_FMT_YUV420P, 1440,  810},
+    {"1080p nv12 -> 2560x1440",     1920, 1080, AV_PIX_FMT_NV12,    2560, 1440},
+    {"4k yuv420p -> 1920x1080",     3840, 2160, AV_PIX_FMT_YUV420P, 1920, 1080},
+    {"480p yuv420p -> 2400x1080",    854,  480, AV_PIX_FMT_YUV420P, 1920, 1080},
+};
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 50;
+    printf("%-30s %12s %12s %12s %8s\n", "case", "convert ms", "bilinear ms", "fast ms", "max diff");
+    for (const Case& c : cases) {
+        AVFrame* frame = makeFrame(c.width, c.height, c.format, 0, 0, 0);
+        // noise, so neither side gains from flat areas
+        srand(1);
+        for (int p = 0; p < 3 && frame->data[p]; p++) {
+            int rows = p == 0 ? c.height : (c.height + 1)/2;
+            for (int j = 0; j < rows; j++) {
+                for (int i = 0; i < frame->linesize[p]; i++) {
+                    frame->data[p][j*frame->linesize[p] + i] = 16 + rand() % 220;
+                }
+            }
+        }
+        int stride = c.dstWidth*4;
+        std::vector<uint8_t> a(stride*c.dstHeight);
+        std::vector<uint8_t> b(stride*c.dstHeight);
+
+        int64_t start = monotonicTime();
+        for (int i = 0; i < frames; i++) {
+            CHECK(convertToRGBA(frame, a.data(), stride, 0, 0, c.dstWidth, c.dstHeight));
+        }
+        double convertTime = (monotonicTime() - start)/1000.0/frames;
+
+        double swsTime[2];
+        const int flags[2] = {SWS_BILINEAR, SWS_FAST_BILINEAR};
+        for (int k = 0; k < 2; k++) {
+            SwsContext* context = sws_getContext(c.width, c.height, AVPixelFormat(c.format),
+                c.dstWidth, c.dstHeight, AV_PIX_FMT_RGBA, flags[k], nullptr, nullptr, nullptr);
+            CHECK(context);
+            uint8_t* dst[4] = {b.data()};
+            int linesize[4] = {stride};
+            start = monotonicTime();
+            for (int i = 0; i < frames; i++) {
+                sws_scale(context, frame->data, frame->linesize, 0, c.height, dst, linesize);
+            }
+            swsTime[k] = (monotonicTime() - start)/1000.0/frames;
+            sws_freeContext(context);
+        }
+        // against the SWS_FAST_BILINEAR output left in b
+        int maxDiff = 0;
+        for (size_t i = 0; i < a.size(); i++) {
+            maxDiff = std::max(maxDiff, abs(a[i] - b[i]));
+        }
+        printf("%-30s %12.3f %12.3f %12.3f %8d\n", c.name, convertTime, swsTime[0], swsTime[1], maxDiff);
+        av_frame_free(&frame);
+    }
+    return 0;
+}
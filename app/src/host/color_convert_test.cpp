@@ -0,0 +1,147 @@
+#include <math.h>
+#include <vector>
+#include "color_convert.h"
+#include "host_frame.h"
+
+static int clamp8(double v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : int(v));
+}
+
+// the RGBA of a YUV sample, in the 6 bits fixed point of the kernel
+static void reference(int y, int u, int v, uint8_t* rgba) {
+    int c = (y - 16)*74;
+    int d = u - 128;
+    int e = v - 128;
+    rgba[0] = clamp8((c + 102*e) >> 6);
+    rgba[1] = clamp8((c - 25*d - 52*e) >> 6);
+    rgba[2] = clamp8((c + 129*d) >> 6);
+    rgba[3] = 0xff;
+}
+
+// NOTES: ramps of luma and chroma, in opposite directions
+static AVFrame* makeRamp(int width, int height, int format) {
+    AVFrame* frame = makeFrame(width, height, format, 0, 0, 0);
+    for (int j = 0; j < height; j++) {
+        for (int i = 0; i < width; i++) {
+            frame->data[0][j*frame->linesize[0] + i] = 16 + (i + j)*200/(width + height);
+        }
+    }
+    for (int j = 0; j < (height + 1)/2; j++) {
+        for (int i = 0; i < (width + 1)/2; i++) {
+            int u = 64 + i*128/((width + 1)/2);
+            int v = 192 - j*128/((height + 1)/2);
+            if (format == AV_PIX_FMT_NV12) {
+                frame->data[1][j*frame->linesize[1] + 2*i] = u;
+                frame->data[1][j*frame->linesize[1] + 2*i + 1] = v;
+            } else {
+                frame->data[1][j*frame->linesize[1] + i] = u;
+                frame->data[2][j*frame->linesize[2] + i] = v;
+            }
+        }
+    }
+    return frame;
+}
+
+// the SIMD rows give the same pixels as the reference
+static void testUnscaled(int format) {
+    AVFrame* frame = makeRamp(333, 97, format);
+    std::vector<uint8_t> dst(400*100*4, 0x5a);
+    CHECK(convertToRGBA(frame, dst.data(), 400*4, 7, 2, frame->width, frame->height));
+    for (int j = 0; j < frame->height; j++) {
+        for (int i = 0; i < frame->width; i++) {
+            int y = frame->data[0][j*frame->linesize[0] + i];
+            int u, v;
+            if (format == AV_PIX_FMT_NV12) {
+                u = frame->data[1][(j/2)*frame->linesize[1] + (i/2)*2];
+                v = frame->data[1][(j/2)*frame->linesize[1] + (i/2)*2 + 1];
+            } else {
+                u = frame->data[1][(j/2)*frame->linesize[1] + i/2];
+                v = frame->data[2][(j/2)*frame->linesize[2] + i/2];
+            }
+            uint8_t expected[4];
+            reference(y, u, v, expected);
+            CHECK(!memcmp(&dst[((j + 2)*400 + i + 7)*4], expected, 4));
+        }
+    }
+    // outside the rect is untouched
+    CHECK(dst[(2*400 + 6)*4] == 0x5a && dst[(1*400 + 7)*4] == 0x5a);
+    av_frame_free(&frame);
+}
+
+// a flat picture stays flat at any scale, and the rect is filled exactly
+static void testScaledFlat() {
+    AVFrame* frame = makeFrame(640, 360, AV_PIX_FMT_YUV420P, 200, 90, 160);
+    uint8_t expected[4];
+    reference(200, 90, 160, expected);
+    const int sizes[][2] = {{1920, 1080}, {1001, 563}, {320, 180}, {641, 361}};
+    for (const auto& size : sizes) {
+        int w = size[0];
+        int h = size[1];
+        std::vector<uint8_t> dst((w + 2)*(h + 2)*4, 0x5a);
+        int stride = (w + 2)*4;
+        CHECK(convertToRGBA(frame, dst.data(), stride, 1, 1, w, h));
+        for (int j = 0; j < h + 2; j++) {
+            for (int i = 0; i < w + 2; i++) {
+                const uint8_t* p = &dst[j*stride + i*4];
+                bool inside = i >= 1 && i <= w && j >= 1 && j <= h;
+                CHECK(inside ? !memcmp(p, expected, 4) : p[0] == 0x5a);
+            }
+        }
+    }
+    av_frame_free(&frame);
+}
+
+// a scaled ramp is within rounding of a bilinear reference in floating point, for both layouts
+static void testScaledRamp() {
+    AVFrame* planar = makeRamp(320, 180, AV_PIX_FMT_YUV420P);
+    AVFrame* nv12 = makeRamp(320, 180, AV_PIX_FMT_NV12);
+    int w = 500;
+    int h = 281;
+    std::vector<uint8_t> a(w*h*4);
+    std::vector<uint8_t> b(w*h*4);
+    CHECK(convertToRGBA(planar, a.data(), w*4, 0, 0, w, h));
+    CHECK(convertToRGBA(nv12, b.data(), w*4, 0, 0, w, h));
+    CHECK(a == b);
+    auto sample = [](const uint8_t* plane, int linesize, int step, int sw, int sh, double x, double y) {
+        x = std::max(0.0, std::min(x, sw - 1.0));
+        y = std::max(0.0, std::min(y, sh - 1.0));
+        int x0 = int(x);
+        int y0 = int(y);
+        int x1 = std::min(x0 + 1, sw - 1);
+        int y1 = std::min(y0 + 1, sh - 1);
+        double fx = x - x0;
+        double fy = y - y0;
+        double top = plane[y0*linesize + x0*step]*(1 - fx) + plane[y0*linesize + x1*step]*fx;
+        double bottom = plane[y1*linesize + x0*step]*(1 - fx) + plane[y1*linesize + x1*step]*fx;
+        return top*(1 - fy) + bottom*fy;
+    };
+    int maxError = 0;
+    for (int j = 0; j < h; j++) {
+        for (int i = 0; i < w; i++) {
+            double sy = (j + 0.5)*180/h - 0.5;
+            double cy = (j + 0.5)*90/h - 0.5;
+            double cx = (i/2 + 0.5)*160/((w + 1)/2) - 0.5;
+            int y = lround(sample(planar->data[0], planar->linesize[0], 1, 320, 180, (i + 0.5)*320/w - 0.5, sy));
+            int u = lround(sample(planar->data[1], planar->linesize[1], 1, 160, 90, cx, cy));
+            int v = lround(sample(planar->data[2], planar->linesize[2], 1, 160, 90, cx, cy));
+            uint8_t expected[4];
+            reference(y, u, v, expected);
+            for (int c = 0; c < 3; c++) {
+                maxError = std::max(maxError, abs(a[(j*w + i)*4 + c] - expected[c]));
+            }
+        }
+    }
+    // two roundings of the 8 bits blends, times the largest coefficient
+    CHECK(maxError <= 6);
+    av_frame_free(&planar);
+    av_frame_free(&nv12);
+}
+
+int main() {
+    testUnscaled(AV_PIX_FMT_YUV420P);
+    testUnscaled(AV_PIX_FMT_NV12);
+    testScaledFlat();
+    testScaledRamp();
+    printf("color_convert_test: passed\n");
+    return 0;
+}
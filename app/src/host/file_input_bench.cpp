@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <string>
+#include "clock.h"
+#include "ffwrapper.h"
+#include "file_input.h"
+#include "host_frame.h"
+#include "host_avi.h"
+
+//
+// Packets demuxed per second from a local file by FFmpeg's own file reads, by FileInput over a
+// mapping and by FileInput reading ahead, e.g.
+//   file_input_bench [file] [runs]
+// Without a file it writes a 360p raw video AVI of 10s. The file is read from the page cache
+// after the first run, so the numbers are of the read path rather than of the storage.
+//
+struct Mode {
+    const char* name;
+    int mode;
+};
+
+static const Mode modes[] = {
+    {"default",     INPUT_MODE_DEFAULT},
+    {"mmap",        INPUT_MODE_MMAP},
+    {"read ahead",  INPUT_MODE_READ_AHEAD},
+};
+
+// NOTES: the read syscalls of the process so far, the read ahead thread included
+static long long readSyscalls() {
+    FILE* f = fopen("/proc/self/io", "r");
+    if (!f) {
+        return -1;
+    }
+    char line[128];
+    long long count = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "syscr: %lld", &count) == 1) {
+            break;
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+static long pageFaults() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt + usage.ru_majflt;
+}
+
+struct Result {
+    long long packets = 0;
+    long long bytes = 0;
+    int64_t time = 0;
+    long long syscalls = 0;
+    long faults = 0;
+    InputStats input;
+};
+
+static Result demux(const std::string& path, int mode) {
+    Result result;
+    InputConfig config;
+    config.mode = mode;
+    FFWrapper engine;
+    engine.setInputConfig(config);
+    long long syscalls = readSyscalls();
+    long faults = pageFaults();
+    int64_t start = monotonicTime();
+    CHECK(engine.open(path.c_str()));
+    for (;;) {
+        AVPacket packet;
+        bool isEOF = false;
+        if (!engine.readPacket(packet, &isEOF)) {
+            if (isEOF) {
+                break;
+            }
+            continue;
+        }
+        result.packets++;
+        result.bytes += packet.size;
+        engine.freePacket(packet);
+    }
+    result.time = monotonicTime() - start;
+    result.input = engine.inputStats();
+    engine.close();
+    result.syscalls = readSyscalls() - syscalls;
+    result.faults = pageFaults() - faults;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "file_input_bench.avi";
+    int runs = argc > 2 ? atoi(argv[2]) : 3;
+    if (argc <= 1) {
+        AviLayout layout;
+        layout.frames = layout.sampleRate*10;
+        layout.width = 640;
+        layout.height = 360;
+        writeAvi(path, layout);
+    }
+    // FileInput opens absolute paths only
+    char* absolute = realpath(path.c_str(), nullptr);
+    CHECK(absolute);
+    std::string input = absolute;
+    free(absolute);
+    // warms the page cache
+    demux(input, INPUT_MODE_DEFAULT);
+
+    printf("%-12s %10s %12s %10s %12s %12s %10s %8s\n", "mode", "packets", "packets/s", "MB/s",
+        "read calls", "input reads", "faults", "stalls");
+    for (const Mode& m : modes) {
+        Result best;
+        for (int i = 0; i < runs; i++) {
+            Result result = demux(input, m.mode);
+            if (i == 0 || result.time < best.time) {
+                best = result;
+            }
+        }
+        double seconds = best.time/1000000.0;
+        printf("%-12s %10lld %12.0f %10.1f %12lld %12lld %10ld %8lld\n", m.name, best.packets,
+            best.packets/seconds, best.bytes/seconds/(1024*1024), best.syscalls, (long long)best.input.reads,
+            best.faults, (long long)best.input.stalls);
+    }
+    if (argc <= 1) {
+        unlink(path.c_str());
+    }
+    return 0;
+}
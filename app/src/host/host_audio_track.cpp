@@ -0,0 +1,49 @@
+#include "audio_track.h"
+
+// the host has no android.media.AudioTrack, it plays through the WavAudioDevice. these only link
+// the AudioTrackDevice, which the audio render creates before its device is replaced
+
+bool initAudioTrackBindings(JNIEnv*) {
+    return false;
+}
+
+jobject newAudioTrack(int) {
+    return nullptr;
+}
+
+void deleteAudioTrack(jobject) {
+}
+
+void playAudioTrack(jobject) {
+}
+
+jobject newAudioTrackBuffer(void*, int) {
+    return nullptr;
+}
+
+void deleteAudioTrackBuffer(jobject) {
+}
+
+int writeAudioTrackBuffer(jobject, jobject, int) {
+    return 0;
+}
+
+int getAudioTrackPosition(jobject) {
+    return 0;
+}
+
+int getAudioTrackPlayState(jobject) {
+    return PLAYSTATE_STOPPED;
+}
+
+void stopAudioTrack(jobject) {
+}
+
+void pauseAudioTrack(jobject) {
+}
+
+void flushAudioTrack(jobject) {
+}
+
+void releaseAudioTrack(jobject) {
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "host_frame.h"
+
+// NOTES: the streams of an AVI written by writeAvi(), frames are audio sample frames
+struct AviLayout {
+    int sampleRate = 44100;
+    int frames = 44100;
+    int fps = 25;
+    int width = 32;
+    int height = 16;
+};
+
+static inline void putLE(std::vector<uint8_t>& v, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        v.push_back(uint8_t(value >> (8*i)));
+    }
+}
+
+static inline void putTag(std::vector<uint8_t>& v, const char* tag) {
+    v.insert(v.end(), tag, tag + 4);
+}
+
+// NOTES: a chunk or a list, its size is patched by endChunk()
+static inline size_t beginChunk(std::vector<uint8_t>& v, const char* tag, const char* type = nullptr) {
+    putTag(v, tag);
+    size_t at = v.size();
+    putLE(v, 0, 4);
+    if (type) {
+        putTag(v, type);
+    }
+    return at;
+}
+
+static inline void endChunk(std::vector<uint8_t>& v, size_t at) {
+    uint32_t size = v.size() - at - 4;
+    for (int i = 0; i < 4; i++) {
+        v[at + i] = uint8_t(size >> (8*i));
+    }
+    if (size & 1) {
+        v.push_back(0);
+    }
+}
+
+// NOTES: the player needs a video stream, so the samples come in an AVI with a raw BGR video, a
+//        video frame then the samples until the next one. 16 bits stereo PCM, a sample is its frame
+//        index on the left and its negation on the right
+static inline std::vector<int16_t> writeAvi(const std::string& path, const AviLayout& layout) {
+    std::vector<int16_t> samples(layout.frames*2);
+    for (int i = 0; i < layout.frames; i++) {
+        samples[2*i] = int16_t(i);
+        samples[2*i + 1] = int16_t(-i);
+    }
+    int videoFrames = layout.frames*layout.fps/layout.sampleRate;
+    int imageSize = layout.width*layout.height*3;
+    int chunkFrames = layout.sampleRate/layout.fps;
+    std::vector<uint8_t> v;
+    size_t riff = beginChunk(v, "RIFF", "AVI ");
+    size_t hdrl = beginChunk(v, "LIST", "hdrl");
+    size_t avih = beginChunk(v, "avih");
+    for (uint32_t value : {1000000/layout.fps, 0, 0, 0x10, videoFrames, 0, 2, 0, layout.width, layout.height, 0, 0, 0, 0}) {
+        putLE(v, value, 4);
+    }
+    endChunk(v, avih);
+
+    size_t strl = beginChunk(v, "LIST", "strl");
+    size_t strh = beginChunk(v, "strh");
+    putTag(v, "vids");
+    for (uint32_t value : {0, 0, 0, 0, 1, layout.fps, 0, videoFrames, imageSize, -1, 0}) {
+        putLE(v, value, 4);
+    }
+    putLE(v, 0, 4);
+    putLE(v, layout.width | (layout.height << 16), 4);
+    endChunk(v, strh);
+    size_t strf = beginChunk(v, "strf");
+    for (uint32_t value : {40, layout.width, layout.height}) {
+        putLE(v, value, 4);
+    }
+    putLE(v, 1, 2);
+    putLE(v, 24, 2);
+    for (uint32_t value : {0, imageSize, 0, 0, 0, 0}) {
+        putLE(v, value, 4);
+    }
+    endChunk(v, strf);
+    endChunk(v, strl);
+
+    strl = beginChunk(v, "LIST", "strl");
+    strh = beginChunk(v, "strh");
+    putTag(v, "auds");
+    for (uint32_t value : {0, 0, 0, 0, 4, layout.sampleRate*4, 0, layout.frames, chunkFrames*4, -1, 4}) {
+        putLE(v, value, 4);
+    }
+    putLE(v, 0, 4);
+    putLE(v, 0, 4);
+    endChunk(v, strh);
+    // WAVE_FORMAT_EXTENSIBLE, so the frames have a stereo channel layout
+    strf = beginChunk(v, "strf");
+    putLE(v, 0xfffe, 2);
+    putLE(v, 2, 2);
+    putLE(v, layout.sampleRate, 4);
+    putLE(v, layout.sampleRate*4, 4);
+    putLE(v, 4, 2);
+    putLE(v, 16, 2);
+    putLE(v, 22, 2);
+    putLE(v, 16, 2);
+    putLE(v, 3, 4);
+    const uint8_t pcm[16] = {1, 0, 0, 0, 0, 0, 0x10, 0, 0x80, 0, 0, 0xaa, 0, 0x38, 0x9b, 0x71};
+    v.insert(v.end(), pcm, pcm + sizeof(pcm));
+    endChunk(v, strf);
+    endChunk(v, strl);
+    endChunk(v, hdrl);
+
+    std::vector<uint8_t> index;
+    size_t movi = beginChunk(v, "LIST", "movi");
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(samples.data());
+    for (int i = 0, frames = 0; frames < layout.frames; i++) {
+        int n = std::min(chunkFrames, layout.frames - frames);
+        putTag(index, "00db");
+        putLE(index, 0x10, 4);
+        putLE(index, v.size() - movi - 4, 4);
+        putLE(index, imageSize, 4);
+        size_t chunk = beginChunk(v, "00db");
+        v.insert(v.end(), imageSize, uint8_t(i*8));
+        endChunk(v, chunk);
+        putTag(index, "01wb");
+        putLE(index, 0x10, 4);
+        putLE(index, v.size() - movi - 4, 4);
+        putLE(index, n*4, 4);
+        chunk = beginChunk(v, "01wb");
+        v.insert(v.end(), data + frames*4, data + (frames + n)*4);
+        endChunk(v, chunk);
+        frames += n;
+    }
+    endChunk(v, movi);
+    size_t idx1 = beginChunk(v, "idx1");
+    v.insert(v.end(), index.begin(), index.end());
+    endChunk(v, idx1);
+    endChunk(v, riff);
+
+    FILE* f = fopen(path.c_str(), "wb");
+    CHECK(f && fwrite(v.data(), 1, v.size(), f) == v.size());
+    fclose(f);
+    return samples;
+}
+
+static inline std::vector<uint8_t> readFile(const std::string& path) {
+    std::vector<uint8_t> data;
+    FILE* f = fopen(path.c_str(), "rb");
+    CHECK(f);
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    return data;
+}
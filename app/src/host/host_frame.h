@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frame_pool.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// NOTES: host tests are built without NDEBUG dependent asserts
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+// NOTES: a planar or NV12 4:2:0 frame of one color
+static inline AVFrame* makeFrame(int width, int height, int format, int y, int u, int v) {
+    AVFrame* frame = av_frame_alloc();
+    frame->width = width;
+    frame->height = height;
+    frame->format = format;
+    CHECK(av_frame_get_buffer(frame, 32) == 0);
+    for (int j = 0; j < height; j++) {
+        memset(frame->data[0] + j*frame->linesize[0], y, width);
+    }
+    for (int j = 0; j < (height + 1)/2; j++) {
+        if (format == AV_PIX_FMT_NV12) {
+            uint8_t* uv = frame->data[1] + j*frame->linesize[1];
+            for (int i = 0; i < (width + 1)/2; i++) {
+                uv[2*i] = u;
+                uv[2*i + 1] = v;
+            }
+        } else {
+            memset(frame->data[1] + j*frame->linesize[1], u, (width + 1)/2);
+            memset(frame->data[2] + j*frame->linesize[2], v, (width + 1)/2);
+        }
+    }
+    return frame;
+}
+
+// NOTES: devices free the frames written, like the renders do
+static inline AVFrame* refFrame(const AVFrame* frame) {
+    AVFrame* ref = FramePool::instance().alloc();
+    CHECK(ref && av_frame_ref(ref, frame) == 0);
+    return ref;
+}
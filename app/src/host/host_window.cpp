@@ -0,0 +1,110 @@
+#include <errno.h>
+#include <string.h>
+#include <android/native_window_jni.h>
+#include "host_window.h"
+
+static int align(int value, int alignment) {
+    return (value + alignment - 1)/alignment*alignment;
+}
+
+int hostBufferBytesPerPixel(int format) {
+    switch (format) {
+    case WINDOW_FORMAT_RGBA_8888:
+    case WINDOW_FORMAT_RGBX_8888:
+        return 4;
+    case WINDOW_FORMAT_RGB_565:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+// the JNI layer isn't built for the host, the sources asking for an env get none
+JNIEnv* getJNIEnv() {
+    return nullptr;
+}
+
+ANativeWindow* ANativeWindow_fromSurface(JNIEnv*, jobject surface) {
+    ANativeWindow* window = reinterpret_cast<ANativeWindow*>(surface);
+    if (window) {
+        ANativeWindow_acquire(window);
+    }
+    return window;
+}
+
+void ANativeWindow_acquire(ANativeWindow* window) {
+    window->refs++;
+}
+
+void ANativeWindow_release(ANativeWindow* window) {
+    // NOTES: the test owns the window, it isn't deleted here
+    window->refs--;
+}
+
+int32_t ANativeWindow_getWidth(ANativeWindow* window) {
+    return window->geometryWidth ? window->geometryWidth : window->width;
+}
+
+int32_t ANativeWindow_getHeight(ANativeWindow* window) {
+    return window->geometryHeight ? window->geometryHeight : window->height;
+}
+
+int32_t ANativeWindow_getFormat(ANativeWindow* window) {
+    return window->geometryFormat ? window->geometryFormat : window->format;
+}
+
+int32_t ANativeWindow_setBuffersGeometry(ANativeWindow* window, int32_t width, int32_t height, int32_t format) {
+    if ((width == 0) != (height == 0) || width < 0 || height < 0) {
+        return -EINVAL;
+    }
+    if (format == HOST_FORMAT_YV12 && !window->yv12Supported) {
+        return -EINVAL;
+    }
+    window->geometryWidth = width;
+    window->geometryHeight = height;
+    window->geometryFormat = format;
+    return 0;
+}
+
+int32_t ANativeWindow_lock(ANativeWindow* window, ANativeWindow_Buffer* outBuffer, ARect*) {
+    if (window->locked) {
+        return -EINVAL;
+    }
+    ANativeWindow_Buffer buffer = {};
+    buffer.width = ANativeWindow_getWidth(window);
+    buffer.height = ANativeWindow_getHeight(window);
+    buffer.format = ANativeWindow_getFormat(window);
+    if (buffer.format == HOST_FORMAT_YV12 && window->yv12LockFormat) {
+        buffer.format = window->yv12LockFormat;
+    }
+    size_t size = 0;
+    if (buffer.format == HOST_FORMAT_YV12) {
+        buffer.stride = align(buffer.width, 16);
+        size = buffer.stride*buffer.height + 2*align(buffer.stride/2, 16)*(buffer.height/2);
+    } else {
+        // wider than the buffer, writers must use the stride
+        buffer.stride = align(buffer.width, 32);
+        size = buffer.stride*buffer.height*hostBufferBytesPerPixel(buffer.format);
+    }
+    std::vector<uint8_t>& bits = window->buffers[window->next];
+    window->next = (window->next + 1) % 3;
+    if (bits.size() != size) {
+        // undefined contents, like a newly allocated graphic buffer
+        bits.assign(size, 0xa5);
+    }
+    buffer.bits = bits.data();
+    window->lockedBuffer = buffer;
+    window->locked = true;
+    *outBuffer = buffer;
+    return 0;
+}
+
+int32_t ANativeWindow_unlockAndPost(ANativeWindow* window) {
+    if (!window->locked) {
+        return -EINVAL;
+    }
+    window->locked = false;
+    window->posted = window->lockedBuffer;
+    window->posts++;
+    return 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <jni.h>
+#include <android/native_window.h>
+
+// NOTES: android/hardware/graphics/common HAL format, planes are Y, Cr, Cb with 16 bytes aligned strides
+#define HOST_FORMAT_YV12    0x32315659
+
+//
+// Host stand-in of the window of a SurfaceView, for running SurfaceDevice without a device. Its
+// base geometry is the surface size and format, setBuffersGeometry() changes the size and format
+// of the buffers locked next, like a Surface the compositor scales to the view. Buffers are
+// locked round robin out of three, with stale contents, and the last posted one can be read back.
+//
+struct ANativeWindow {
+    ANativeWindow(int width, int height, int format) : width(width), height(height), format(format) {}
+
+    jobject surface() {
+        return reinterpret_cast<jobject>(this);
+    }
+
+    // the base geometry
+    int width;
+    int height;
+    int format;
+    // HOST_FORMAT_YV12 geometries are accepted
+    bool yv12Supported = true;
+    // if not 0, the format of the buffers locked with a YV12 geometry, like a window accepting the
+    // geometry but not the format
+    int yv12LockFormat = 0;
+
+    // set by setBuffersGeometry(), 0 for the base geometry
+    int geometryWidth = 0;
+    int geometryHeight = 0;
+    int geometryFormat = 0;
+
+    std::vector<uint8_t> buffers[3];
+    int next = 0;
+    bool locked = false;
+    ANativeWindow_Buffer lockedBuffer = {};
+    // the last buffer posted
+    ANativeWindow_Buffer posted = {};
+    int posts = 0;
+    int refs = 1;
+};
+
+// NOTES: the bytes of a buffer, of the Y plane for YV12
+int hostBufferBytesPerPixel(int format);
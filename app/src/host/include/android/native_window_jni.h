@@ -0,0 +1,7 @@
+#pragma once
+
+#include <jni.h>
+#include <android/native_window.h>
+
+// NOTES: on the host the surface is the window, a reference is acquired
+ANativeWindow* ANativeWindow_fromSurface(JNIEnv* env, jobject surface);
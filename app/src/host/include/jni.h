@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+//
+// Host stand-in of the JNI types the native sources use outside the JNI layer, a surface is
+// the ANativeWindow itself, see host_window.h
+//
+typedef uint8_t jboolean;
+typedef int32_t jint;
+typedef int64_t jlong;
+
+class _jobject {};
+typedef _jobject* jobject;
+
+struct _JNIEnv;
+typedef _JNIEnv JNIEnv;
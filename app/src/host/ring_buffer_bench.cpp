@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include "utils.h"
+#include "host_frame.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+//
+// Packet handoff between a producer and a consumer thread through RingBuffer and through Queue,
+// the way the demuxer hands packets to a decoder: the consumer pops until the link is empty and
+// then sleeps on its notifier, the producer sleeps on its own one while the link is full. e.g.
+//   ring_buffer_bench [seconds] [packets]
+// The paced case pushes the packets of a 4K60 stream, 60 video and 47 audio packets a second,
+// so its latency is the one of waking up the consumer. The saturated case pushes packets as
+// fast as the link takes them, its latency includes the time spent queued behind the others.
+//
+#define LINK_CAPACITY       256
+#define VIDEO_RATE          60
+// AAC at 48kHz, 1024 samples a packet
+#define AUDIO_RATE          (48000.0/1024)
+
+// NOTES: in nanoseconds, finer than monotonicTime() as a handoff may take less than a microsecond
+static int64_t nanoTime() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Result {
+    int64_t packets = 0;
+    int64_t time = 0;
+    int64_t producerWaits = 0;
+    int64_t consumerWaits = 0;
+    // NOTES: in nanoseconds, from the push to the pop of each packet
+    std::vector<int64_t> latencies;
+};
+
+// NOTES: due holds the time to push each packet at, relative to the start, empty to push them
+//        as fast as possible
+template <typename Link>
+static Result run(int64_t packets, const std::vector<int64_t>& due) {
+    Link link(LINK_CAPACITY);
+    Notifier consumerNotifier;
+    Notifier producerNotifier;
+    link.setNotifiers(&consumerNotifier, &producerNotifier);
+    Result result;
+    result.latencies.reserve(packets);
+    int64_t start = nanoTime();
+
+    std::thread producer([&] {
+        for (int64_t i = 0; i < packets; i++) {
+            if (!due.empty()) {
+                std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+                    std::chrono::nanoseconds(start + due[i])));
+            }
+            AVPacket packet;
+            av_init_packet(&packet);
+            packet.data = nullptr;
+            packet.size = 0;
+            packet.pos = i;
+            packet.pts = nanoTime();
+            while (!link.push(packet)) {
+                result.producerWaits++;
+                producerNotifier.wait();
+            }
+        }
+    });
+
+    for (int64_t popped = 0; popped < packets; ) {
+        AVPacket packet;
+        if (!link.pop(packet)) {
+            result.consumerWaits++;
+            consumerNotifier.wait();
+            continue;
+        }
+        result.latencies.push_back(nanoTime() - packet.pts);
+        CHECK(packet.pos == popped);
+        popped++;
+    }
+    producer.join();
+    result.time = nanoTime() - start;
+    result.packets = packets;
+    std::sort(result.latencies.begin(), result.latencies.end());
+    return result;
+}
+
+static double percentile(const std::vector<int64_t>& sorted, double p) {
+    size_t index = std::min(sorted.size() - 1, size_t(sorted.size()*p));
+    return sorted[index]/1000.0;
+}
+
+static void print(const char* name, const Result& result) {
+    printf("%-24s %10lld %12.0f %10.1f %10.1f %10.1f %10lld %10lld\n", name, (long long)result.packets,
+        result.packets*1e9/result.time, percentile(result.latencies, 0.5), percentile(result.latencies, 0.99),
+        percentile(result.latencies, 0.999), (long long)result.producerWaits, (long long)result.consumerWaits);
+}
+
+int main(int argc, char** argv) {
+    int seconds = argc > 1 ? atoi(argv[1]) : 10;
+    int64_t saturated = argc > 2 ? atoll(argv[2]) : 5000000;
+    CHECK(seconds > 0 && saturated > 0);
+
+    // the video and audio packets of the stream in the order the demuxer reads them
+    std::vector<int64_t> due;
+    int64_t video = 0;
+    int64_t audio = 0;
+    int64_t end = int64_t(seconds)*1000000000;
+    for (;;) {
+        int64_t videoTime = video*1000000000/VIDEO_RATE;
+        int64_t audioTime = int64_t(audio*1e9/AUDIO_RATE);
+        int64_t next = std::min(videoTime, audioTime);
+        if (next >= end) {
+            break;
+        }
+        due.push_back(next);
+        if (videoTime <= audioTime) {
+            video++;
+        } else {
+            audio++;
+        }
+    }
+
+    printf("%-24s %10s %12s %10s %10s %10s %10s %10s\n", "case", "packets", "ops/s", "p50 us", "p99 us",
+        "p999 us", "full", "empty");
+    print("4k60 paced, RingBuffer", run<RingBuffer<AVPacket>>(due.size(), due));
+    print("4k60 paced, Queue", run<Queue<AVPacket>>(due.size(), due));
+    print("saturated, RingBuffer", run<RingBuffer<AVPacket>>(saturated, std::vector<int64_t>()));
+    print("saturated, Queue", run<Queue<AVPacket>>(saturated, std::vector<int64_t>()));
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include "thumbnail_engine.h"
+#include "host_frame.h"
+#include "host_avi.h"
+
+//
+// Thumbnails per second of a seek bar sprite against the number of workers, e.g.
+//   thumbnail_engine_bench [file] [tiles]
+// Without a file it writes a 360p raw video AVI of 30s at 5fps. The first sprite of an engine
+// opens its worker sessions, the second one reuses them.
+//
+#define TILE_WIDTH      160
+#define TILE_HEIGHT     90
+#define TILE_COLUMNS    10
+
+static const int workerCounts[] = {1, 2, 4, 8};
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "thumbnail_engine_bench.avi";
+    int tiles = argc > 2 ? atoi(argv[2]) : 60;
+    if (argc <= 1) {
+        AviLayout layout;
+        layout.frames = layout.sampleRate*30;
+        layout.fps = 5;
+        layout.width = 640;
+        layout.height = 360;
+        writeAvi(path, layout);
+    }
+
+    printf("%-8s %8s %8s %12s %12s %12s %12s\n", "workers", "thumbs", "decoded", "first ms", "thumbs/s",
+        "reused ms", "thumbs/s");
+    for (int workers : workerCounts) {
+        ThumbnailEngine engine(workers);
+        CHECK(engine.open(path));
+        Sprite sprite;
+        CHECK(engine.generate(tiles, TILE_WIDTH, TILE_HEIGHT, TILE_COLUMNS, &sprite));
+        ThumbnailStats first = engine.stats();
+        CHECK(engine.generate(tiles, TILE_WIDTH, TILE_HEIGHT, TILE_COLUMNS, &sprite));
+        ThumbnailStats reused = engine.stats();
+        printf("%-8d %8d %8d %12.1f %12.1f %12.1f %12.1f\n", reused.workers, reused.thumbnails, reused.decoded,
+            first.totalTime/1000.0, first.thumbnails*1000000.0/first.totalTime,
+            reused.totalTime/1000.0, reused.thumbnails*1000000.0/reused.totalTime);
+        engine.close();
+    }
+    if (argc <= 1) {
+        unlink(path.c_str());
+    }
+    return 0;
+}
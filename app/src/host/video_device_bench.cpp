@@ -0,0 +1,54 @@
+#include <stdlib.h>
+#include "clock.h"
+#include "ffwrapper.h"
+#include "video_device.h"
+#include "host_window.h"
+#include "host_frame.h"
+
+//
+// Time per frame written by SurfaceDevice into the host window, e.g.
+//   video_device_bench [frames]
+//
+struct Case {
+    const char* name;
+    int width;
+    int height;
+    int format;
+    int windowWidth;
+    int windowHeight;
+    bool yv12;
+};
+
+static const Case cases[] = {
+    {"1080p yuv420p, yv12 window 1920x1080",     1920, 1080, AV_PIX_FMT_YUV420P, 1920, 1080, true},
+    {"1080p yuv420p, rgba window 1920x1080",     1920, 1080, AV_PIX_FMT_YUV420P, 1920, 1080, false},
+    {"1080p nv12, rgba window 1920x1080",        1920, 1080, AV_PIX_FMT_NV12,    1920, 1080, false},
+    {"720p yuv420p, yv12 window 2400x1080",      1280,  720, AV_PIX_FMT_YUV420P, 2400, 1080, true},
+    {"720p yuv420p, rgba window 2400x1080",      1280,  720, AV_PIX_FMT_YUV420P, 2400, 1080, false},
+    {"4k yuv420p, rgba window 1920x1080",        3840, 2160, AV_PIX_FMT_YUV420P, 1920, 1080, false},
+};
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 100;
+    printf("%-40s %10s\n", "case", "ms/frame");
+    for (const Case& c : cases) {
+        ANativeWindow window(c.windowWidth, c.windowHeight, WINDOW_FORMAT_RGBA_8888);
+        window.yv12Supported = c.yv12;
+        FFWrapper ffWrapper;
+        VideoDevice* device = VideoDevice::create("SurfaceDevice");
+        device->setProperty(VIDEO_ENGIN, &ffWrapper);
+        device->setProperty(VIDEO_SURFACE, window.surface());
+        AVFrame* frame = makeFrame(c.width, c.height, c.format, 120, 100, 150);
+        // the first frame negotiates the window and sets up the scaler
+        CHECK(device->write(refFrame(frame), sizeof(AVFrame)) > 0);
+        int64_t start = monotonicTime();
+        for (int i = 0; i < frames; i++) {
+            CHECK(device->write(refFrame(frame), sizeof(AVFrame)) > 0);
+        }
+        int64_t elapsed = monotonicTime() - start;
+        printf("%-40s %10.3f\n", c.name, elapsed/1000.0/frames);
+        av_frame_free(&frame);
+        VideoDevice::release(device);
+    }
+    return 0;
+}
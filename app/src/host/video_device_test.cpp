@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include "ffwrapper.h"
+#include "video_device.h"
+#include "host_window.h"
+#include "host_frame.h"
+
+// the RGBA of Y=200 U=90 V=160 in BT.601 limited range
+#define GRAY_R  255
+#define GRAY_G  201
+#define GRAY_B  136
+
+static int yv12Y(const ANativeWindow_Buffer& b, int x, int y) {
+    return static_cast<uint8_t*>(b.bits)[y*b.stride + x];
+}
+
+static int yv12V(const ANativeWindow_Buffer& b, int x, int y) {
+    int cStride = FFALIGN(b.stride/2, 16);
+    return static_cast<uint8_t*>(b.bits)[b.stride*b.height + y*cStride + x];
+}
+
+static int yv12U(const ANativeWindow_Buffer& b, int x, int y) {
+    int cStride = FFALIGN(b.stride/2, 16);
+    return static_cast<uint8_t*>(b.bits)[b.stride*b.height + cStride*(b.height/2) + y*cStride + x];
+}
+
+static const uint8_t* rgba(const ANativeWindow_Buffer& b, int x, int y) {
+    return static_cast<uint8_t*>(b.bits) + (y*b.stride + x)*4;
+}
+
+static bool isGray(const uint8_t* p) {
+    return abs(p[0] - GRAY_R) <= 3 && abs(p[1] - GRAY_G) <= 3 && abs(p[2] - GRAY_B) <= 3;
+}
+
+static bool isBlack(const uint8_t* p) {
+    return p[0] == 0 && p[1] == 0 && p[2] == 0;
+}
+
+struct Fixture {
+    Fixture(int width, int height) : window(width, height, WINDOW_FORMAT_RGBA_8888) {
+        device = VideoDevice::create("SurfaceDevice");
+        device->setProperty(VIDEO_ENGIN, &ffWrapper);
+    }
+    ~Fixture() {
+        VideoDevice::release(device);
+    }
+    int write(const AVFrame* frame) {
+        if (!attached) {
+            // after the test has changed the window's capabilities
+            device->setProperty(VIDEO_SURFACE, window.surface());
+            attached = true;
+        }
+        return device->write(refFrame(frame), sizeof(AVFrame));
+    }
+
+    ANativeWindow window;
+    FFWrapper ffWrapper;
+    VideoDevice* device = nullptr;
+    bool attached = false;
+};
+
+// a 4:3 video in a 16:9 window keeps its aspect ratio in the YV12 buffers
+static void testYV12Pillarbox() {
+    Fixture f(1280, 720);
+    AVFrame* frame = makeFrame(640, 480, AV_PIX_FMT_YUV420P, 200, 90, 160);
+    // all three buffers of the window, which start with stale contents
+    for (int i = 0; i < 3; i++) {
+        CHECK(f.write(frame) > 0);
+        const ANativeWindow_Buffer& b = f.window.posted;
+        CHECK(b.format == HOST_FORMAT_YV12);
+        CHECK(b.width == 854 && b.height == 480);
+        CHECK(yv12Y(b, 0, 0) == 16 && yv12Y(b, 105, 240) == 16);
+        CHECK(yv12Y(b, 106, 240) == 200 && yv12Y(b, 745, 240) == 200);
+        CHECK(yv12Y(b, 746, 240) == 16 && yv12Y(b, 853, 479) == 16);
+        CHECK(yv12V(b, 52, 120) == 128 && yv12V(b, 53, 120) == 160 && yv12V(b, 373, 120) == 128);
+        CHECK(yv12U(b, 52, 120) == 128 && yv12U(b, 53, 120) == 90 && yv12U(b, 372, 120) == 90);
+    }
+    CHECK(f.window.posts == 3);
+    av_frame_free(&frame);
+}
+
+// a 16:9 video in a portrait window is letterboxed
+static void testYV12Letterbox() {
+    Fixture f(720, 1280);
+    AVFrame* frame = makeFrame(1280, 720, AV_PIX_FMT_YUV420P, 200, 90, 160);
+    CHECK(f.write(frame) > 0);
+    const ANativeWindow_Buffer& b = f.window.posted;
+    CHECK(b.format == HOST_FORMAT_YV12);
+    CHECK(b.width == 1280 && b.height == 2276);
+    int top = (2276 - 720)/2 & ~1;
+    CHECK(yv12Y(b, 640, top - 1) == 16 && yv12Y(b, 640, top) == 200);
+    CHECK(yv12Y(b, 640, top + 719) == 200 && yv12Y(b, 640, top + 720) == 16);
+    av_frame_free(&frame);
+}
+
+// a window taking the YV12 geometry but locking RGBA buffers shows the same frame converted
+static void testYV12LockedAsRGBA() {
+    Fixture f(1280, 720);
+    f.window.yv12LockFormat = WINDOW_FORMAT_RGBA_8888;
+    AVFrame* frame = makeFrame(640, 480, AV_PIX_FMT_YUV420P, 200, 90, 160);
+    CHECK(f.write(frame) > 0);
+    const ANativeWindow_Buffer& b = f.window.posted;
+    CHECK(b.format == WINDOW_FORMAT_RGBA_8888 && b.width == 854 && b.height == 480);
+    CHECK(isBlack(rgba(b, 106, 240)) && isGray(rgba(b, 107, 240)) && isGray(rgba(b, 746, 240)));
+    CHECK(isBlack(rgba(b, 747, 240)));
+    // the next frames are converted into the base geometry
+    CHECK(f.write(frame) > 0);
+    CHECK(f.window.posted.format == WINDOW_FORMAT_RGBA_8888);
+    CHECK(f.window.posted.width == 1280 && f.window.posted.height == 720);
+    CHECK(isBlack(rgba(f.window.posted, 159, 360)) && isGray(rgba(f.window.posted, 160, 360)));
+    CHECK(isGray(rgba(f.window.posted, 1119, 360)) && isBlack(rgba(f.window.posted, 1120, 360)));
+    av_frame_free(&frame);
+}
+
+// a frame locked in a format neither YV12 nor RGBA is dropped, the next ones are converted
+static void testYV12LockedAsRGB565() {
+    Fixture f(1280, 720);
+    f.window.yv12LockFormat = WINDOW_FORMAT_RGB_565;
+    AVFrame* frame = makeFrame(640, 480, AV_PIX_FMT_YUV420P, 200, 90, 160);
+    CHECK(f.write(frame) == 0);
+    CHECK(f.write(frame) > 0);
+    CHECK(f.window.posted.format == WINDOW_FORMAT_RGBA_8888 && f.window.posted.width == 1280);
+    av_frame_free(&frame);
+}
+
+// without YV12 the RGBA path letterboxes in the base geometry
+static void testRGBA() {
+    Fixture f(1280, 720);
+    f.window.yv12Supported = false;
+    AVFrame* frame = makeFrame(640, 480, AV_PIX_FMT_YUV420P, 200, 90, 160);
+    CHECK(f.write(frame) > 0);
+    const ANativeWindow_Buffer& b = f.window.posted;
+    CHECK(b.format == WINDOW_FORMAT_RGBA_8888 && b.width == 1280 && b.height == 720);
+    CHECK(isBlack(rgba(b, 159, 360)) && isGray(rgba(b, 160, 360)) && isGray(rgba(b, 640, 0)));
+    CHECK(isGray(rgba(b, 1119, 719)) && isBlack(rgba(b, 1120, 360)));
+    av_frame_free(&frame);
+}
+
+int main() {
+    testYV12Pillarbox();
+    testYV12Letterbox();
+    testYV12LockedAsRGBA();
+    testYV12LockedAsRGB565();
+    testRGBA();
+    printf("video_device_test: passed\n");
+    return 0;
+}
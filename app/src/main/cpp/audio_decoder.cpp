@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "log.h"
 #include "ffwrapper.h"
 #include "audio_decoder.h"
@@ -10,69 +11,174 @@ void AudioDecoder::decoding() {
     LOGD("decoding: thread stated");
     AVFrame* pendingFrame = nullptr;
     bool pendingEOS = false;
+    bool draining = false;
+    bool flushing = false;
+    // frames ending before it are discarded after an accurate seek, in microseconds
+    int64_t seekTarget = -1;
+    // the next source of the playlist, and the frames decoded by its preroll
+    Preroll* nextSource = nullptr;
+    std::deque<AVFrame*> prerolledFrames;
+    // the render still has frames of the previous source, see EVENT_SWITCH_SOURCE
+    bool waitingSink = false;
     for (;;) {
         // Handle events
         Event ev;
         if (eventQueue.pop(ev)) {
-            if (ev.id == EVENT_STOP_THREAD) {
+            if (ev.id == EVENT_STOP_THREAD || ev.id == EVENT_FLUSH_START) {
+                if (ev.id == EVENT_FLUSH_START && nextSource) {
+                    // what the switch waits for is dropped anyway, the render switches on its flush
+                    audioSink->onEvent(Event(EVENT_SWITCH_SOURCE, nextSource));
+                    switchSource(nextSource, prerolledFrames);
+                    nextSource = nullptr;
+                }
                 if (pendingFrame) {
                     ffWrapper->freeFrame(pendingFrame);
+                    pendingFrame = nullptr;
+                }
+                for (AVFrame* f : prerolledFrames) {
+                    ffWrapper->freeFrame(f);
                 }
+                prerolledFrames.clear();
                 while (!bufferQueue.empty()) {
                     AVPacket p;
                     bufferQueue.pop(p);
                     ffWrapper->freePacket(p);
                 }
+                // reset the decoder, it may be in draining mode
+                ffWrapper->flushAudioDecoder();
+                if (ev.id == EVENT_FLUSH_START) {
+                    pendingEOS = false;
+                    draining = false;
+                    waitingSink = false;
+                    flushing = true;
+                    static_cast<Notifier*>(ev.data)->notify();
+                    continue;
+                }
                 LOGD("demuxing: thread exited");
                 break;
             };
             if (ev.id == EVENT_EOS) {
                 pendingEOS = true;
-                audioSink->onEvent(Event(EVENT_EOS));
                 continue;
             }
+            if (ev.id == EVENT_SWITCH_SOURCE) {
+                nextSource = static_cast<Preroll*>(ev.data);
+                continue;
+            }
+            if (ev.id == EVENT_SOURCE_SWITCHED) {
+                // from the render, the demuxer recycles the previous engine once all switched
+                waitingSink = false;
+                demuxer->onEvent(ev);
+                continue;
+            }
+            if (ev.id == EVENT_FLUSH_STOP) {
+                flushing = false;
+                seekTarget = ev.value;
+                static_cast<Notifier*>(ev.data)->notify();
+                continue;
+            }
+            continue;
+        }
+
+        // Flushing
+        if (flushing) {
+            notifier.wait();
             continue;
         }
 
-        // Handle buffers
+        // Switching, the render plays the last frames of the previous source first
+        if (waitingSink) {
+            notifier.wait();
+            continue;
+        }
+
+        // Handle buffers, drain all decoded frames before sending next packet
         AVFrame* frame = nullptr;
         if (pendingFrame) {
             frame = pendingFrame;
             pendingFrame = nullptr;
+        } else if (!prerolledFrames.empty()) {
+            frame = prerolledFrames.front();
+            prerolledFrames.pop_front();
         } else {
-            AVPacket packet;
-            if (!bufferQueue.pop(packet)) {
-                if (pendingEOS) {
-                    LOGD("decoding: end of stream, will sleep 10ms");
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            bool isEOF = false;
+            if (!ffWrapper->receiveAudioFrame(&frame, &isEOF)) {
+                if (isEOF) {
+                    if (draining && nextSource) {
+                        // all tail frames have been pushed, the render switches after them
+                        draining = false;
+                        audioSink->onEvent(Event(EVENT_SWITCH_SOURCE, nextSource));
+                        switchSource(nextSource, prerolledFrames);
+                        nextSource = nullptr;
+                        waitingSink = true;
+                        continue;
+                    }
+                    if (draining) {
+                        // all tail frames have been pushed
+                        draining = false;
+                        audioSink->onEvent(Event(EVENT_EOS));
+                    }
+                    LOGD("decoding: end of stream, wait for events");
+                    notifier.wait();
+                    continue;
+                }
+                AVPacket packet;
+                if (bufferQueue.pop(packet)) {
+                    if (!ffWrapper->sendAudioPacket(&packet)) {
+                        LOGE("decoding: decode audio error");
+                        bus->sendMessage(Message(MESSAGE_ERROR_DECODE, this));
+                    }
+                    ffWrapper->freePacket(packet);
+                    continue;
+                }
+                if ((pendingEOS || nextSource) && !draining) {
+                    // no more packets, flush the decoder to get the delayed frames
+                    LOGD("decoding: end of %s, drain the decoder", nextSource ? "source" : "stream");
+                    ffWrapper->sendAudioPacket(nullptr);
+                    draining = true;
                     continue;
                 }
                 if (states.getCurrent() == STATE_PAUSED) {
-                    LOGD("decoding: current state is STATE_PAUSED, will sleep 10ms");
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                    continue;     
+                    LOGD("decoding: current state is STATE_PAUSED, wait for buffers");
                 }
+                notifier.wait();
                 continue;
             }
-            // Should loop decoding audio
-            if (!ffWrapper->decodeAudio(packet, &frame, nullptr)) {
-                LOGE("decoding: decode audio error");
-                bus->sendMessage(Message(MESSAGE_ERROR_DECODE, this));
-                ffWrapper->freePacket(packet); 
-                continue;
+            // decode from the keyframe, but only play what ends after the seek target
+            if (seekTarget >= 0) {
+                int64_t pts = frame->pts * ffWrapper->audioTimeBase() * 1000000;
+                int64_t duration = frame->sample_rate > 0 ? int64_t(frame->nb_samples)*1000000/frame->sample_rate : 0;
+                if (frame->pts != AV_NOPTS_VALUE && pts + std::max<int64_t>(duration, 1) <= seekTarget) {
+                    ffWrapper->freeFrame(frame);
+                    continue;
+                }
+                seekTarget = -1;
             }
-            ffWrapper->freePacket(packet);
         }
         // push buffer to audio render
         Buffer buf(BUFFER_AVFRAME, frame);
         if (audioSink->onBuffer(buf) == STATUS_FAILED) {
-            LOGW("decoding: push buffer to audio render failed");
+            LOGW("decoding: push buffer to audio render failed, wait for it to be consumed");
             pendingFrame = frame;
+            notifier.wait();
         }
     }
 }
 
-AudioDecoder::AudioDecoder() {   
+void AudioDecoder::switchSource(Preroll* preroll, std::deque<AVFrame*>& frames) {
+    ffWrapper = preroll->getEngine();
+    preroll->takeAudioFrames(frames);
+    bufferQueue.setTimeBase(ffWrapper->audioTimeBase());
+    LOGD("switchSource: %s, %d frames prerolled", preroll->getUrl().c_str(), (int)frames.size());
+    // the demuxer goes on with the packets of the next source
+    Event switched(EVENT_SOURCE_SWITCHED);
+    switched.value = SWITCHED_AUDIO_DECODER;
+    demuxer->onEvent(switched);
+}
+
+AudioDecoder::AudioDecoder() {
+    eventQueue.setNotifiers(&notifier);
+    bufferQueue.setNotifiers(&notifier);
 }
 
 AudioDecoder::~AudioDecoder() {    
@@ -95,6 +201,7 @@ int AudioDecoder::toReady() {
         return STATUS_FAILED;
     }
     if (current == STATE_NULL) {
+        bufferQueue.setTimeBase(ffWrapper->audioTimeBase());
         states.setCurrent(STATE_READY);
         return STATUS_SUCCESS;
     }
@@ -118,6 +225,7 @@ int AudioDecoder::toPaused() {
     }
     // current == STATE_PLAYING)
     states.setCurrent(STATE_PAUSED);
+    notifier.notify();
     return STATUS_SUCCESS;
 }
 
@@ -128,6 +236,7 @@ int AudioDecoder::toPlaying() {
         return STATUS_FAILED;
     }
     states.setCurrent(STATE_PLAYING);
+    notifier.notify();
     return STATUS_SUCCESS;
 }
 
@@ -170,7 +279,3 @@ int AudioDecoder::onBuffer(const Buffer& buffer) {
     return STATUS_SUCCESS;
 }
 
-
-bool AudioDecoder::BufferCompare::operator()(const AVPacket& lPacket, const AVPacket& rPacket) {
-    return lPacket.dts >= rPacket.dts;
-};
\ No newline at end of file
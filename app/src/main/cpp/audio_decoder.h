@@ -1,9 +1,11 @@
 #pragma once
 
-
+#include <deque>
 #include "element.h"
 #include "ffwrapper.h"
 #include "utils.h"
+#include "packet_queue.h"
+#include "preroll.h"
 
 class AudioDecoder: public Element {
 
@@ -29,6 +31,9 @@ public:
     
     int onEvent(const Event& event) override;
     int onBuffer(const Buffer& buffer) override;
+    Notifier* getNotifier() override {
+        return &notifier;
+    }
 
 public:
     void setEngine(FFWrapper* ffWrapper) {
@@ -36,10 +41,15 @@ public:
     }
     void setSource(Element* demuxer) {
         this->demuxer = demuxer;
+        bufferQueue.setNotifiers(&notifier, demuxer->getNotifier());
     }
     void setAudioSink(Element* audioSink) {
         this->audioSink = audioSink;
     }
+    // NOTES: limits of the packets buffered from demuxer, should be set in STATE_NULL
+    void setBufferLimits(const BufferLimits& limits) {
+        bufferQueue.setLimits(limits);
+    }
 
 private:
     int toNull();
@@ -47,6 +57,8 @@ private:
     int toPaused();
     int toPlaying();
     void decoding();
+    // NOTES: continues with the engine and the prerolled frames of the next source
+    void switchSource(Preroll* preroll, std::deque<AVFrame*>& frames);
 
 private:
     Clock* clock = nullptr;
@@ -57,10 +69,6 @@ private:
     States states;
     std::thread decodingThread;
     Queue<Event> eventQueue;
-
-private:
-    struct BufferCompare {
-        bool operator()(const AVPacket& lPacket, const AVPacket& rPacket);
-    };
-    PriorityQueue<AVPacket, BufferCompare> bufferQueue;
+    Notifier notifier;
+    PacketQueue bufferQueue;
 };
\ No newline at end of file
@@ -2,10 +2,14 @@
 #include "ffwrapper.h"
 #include "audio_track.h"
 #include "audio_device.h"
+#include "wav_audio_device.h"
 
 #undef  LOG_TAG
 #define LOG_TAG "AudioTrackDevice"
 
+// NOTES: room for the samples a resampler delayed from the previous frames
+#define RESAMPLE_EXTRA_SAMPLES  256
+
 class AudioTrackDevice: public AudioDevice {
 public:
 
@@ -14,23 +18,27 @@ public:
     }
 
     ~AudioTrackDevice() {
-        delete sampleBuffer;
-        if (audioTrack) {
-            releaseAudioTrack(audioTrack);
-            deleteAudioTrack(audioTrack);
+        releaseTrack();
+        if (byteBuffer) {
+            deleteAudioTrackBuffer(byteBuffer);
         }
+        delete[] sampleBuffer;
     }
 
     bool setProperty(int key, void* value) override {
         switch(key) {
         case AUDIO_ENGIN:
+            // the resampler of the new engine is set up by the next write
             ffWrapper = static_cast<FFWrapper*>(value);
+            frameFormat = AV_SAMPLE_FMT_NONE;
             break;
         case AUDIO_SAMPLE_BUFFER_SIZE:
-            sampleBufferSize = *static_cast<int*>(value);
+            reserveSampleBuffer(*static_cast<int*>(value));
             break;
         case AUDIO_SAMPLE_RATE:
             sampleRate = *static_cast<int*>(value);
+            frameFormat = AV_SAMPLE_FMT_NONE;
+            releaseTrack();
             audioTrack = newAudioTrack(sampleRate);
             break;
         case AUDIO_SAMPLE_FORMAT:
@@ -62,22 +70,27 @@ public:
 
     int write(void* buf, int buflen) override {
         AVFrame* frame = static_cast<AVFrame*>(buf);
-        if (sampleRate != frame->sample_rate || sampleForamt != frame->format) {
-            ffWrapper->setAudioResample(frame, AV_CH_LAYOUT_STEREO, frame->sample_rate, AV_SAMPLE_FMT_S16);
-            sampleRate = frame->sample_rate;
-            sampleForamt = frame->format;
+        if (frameRate != frame->sample_rate || frameFormat != frame->format) {
+            // the track keeps its rate, frames of other rates (e.g. of the next source of a
+            // playlist) are resampled to it
+            ffWrapper->setAudioResample(frame, AV_CH_LAYOUT_STEREO, sampleRate, AV_SAMPLE_FMT_S16);
+            frameRate = frame->sample_rate;
+            frameFormat = frame->format;
         }
 
-        int sampleSize = 2 * 2 * frame->nb_samples;
-        if (sampleBufferSize < sampleSize) {
-            delete sampleBuffer;
-            sampleBuffer = new uint8_t[sampleSize];
-            sampleBufferSize = sampleSize;
+        int maxSamples = av_rescale_rnd(frame->nb_samples, sampleRate, frame->sample_rate, AV_ROUND_UP) + RESAMPLE_EXTRA_SAMPLES;
+        reserveSampleBuffer(2 * 2 * maxSamples);
+        if (!byteBuffer) {
+            // the java side reads the samples in place, no array is allocated per write
+            byteBuffer = newAudioTrackBuffer(sampleBuffer, sampleBufferSize);
         }
 
-        ffWrapper->resampleAudio(frame, &sampleBuffer, frame->nb_samples);
+        int sampleSize = 2 * 2 * ffWrapper->resampleAudio(frame, &sampleBuffer, maxSamples);
         ffWrapper->freeFrame(frame);
-        return writeAudioTrack(audioTrack, sampleBuffer, sampleSize);
+        if (!byteBuffer || sampleSize == 0) {
+            return 0;
+        }
+        return writeAudioTrackBuffer(audioTrack, byteBuffer, sampleSize);
     }
 
     void play() override {
@@ -99,20 +112,52 @@ public:
     void stop() override {
         stopAudioTrack(audioTrack);
     }
+
+private:
+    void reserveSampleBuffer(int size) {
+        if (sampleBuffer && sampleBufferSize >= size) {
+            return;
+        }
+        // the direct buffer wraps the old memory, it is recreated on next write
+        if (byteBuffer) {
+            deleteAudioTrackBuffer(byteBuffer);
+            byteBuffer = nullptr;
+        }
+        delete[] sampleBuffer;
+        sampleBuffer = new uint8_t[size];
+        sampleBufferSize = size;
+    }
+
+    void releaseTrack() {
+        if (audioTrack) {
+            releaseAudioTrack(audioTrack);
+            deleteAudioTrack(audioTrack);
+            audioTrack = nullptr;
+        }
+    }
+
 private:
+    // of the track
     int sampleRate = 0;
-    int sampleForamt = AV_SAMPLE_FMT_NONE;
+    // of the frames the resampler is set up for
+    int frameRate = 0;
+    int frameFormat = AV_SAMPLE_FMT_NONE;
     uint8_t* sampleBuffer = nullptr;
     int sampleBufferSize = 256*1024;
     FFWrapper* ffWrapper = nullptr;
     jobject audioTrack = nullptr;
+    jobject byteBuffer = nullptr;
 };
 
 AudioDevice* AudioDevice::create(const std::string& name) {
-    if (name != "AudioTrackDevice") {
-        return nullptr;
+    if (name == "AudioTrackDevice") {
+        return new AudioTrackDevice;
+    }
+    if (name == "WavAudioDevice") {
+        return new WavAudioDevice;
     }
-    return new AudioTrackDevice;
+    LOGE("create: unknown audio device %s", name.c_str());
+    return nullptr;
 }
 
 void AudioDevice::release(AudioDevice* device) {
@@ -1,14 +1,21 @@
 #pragma once
 
 #include <string>
-#include <chrono>
 #include <atomic>
+#include <mutex>
+#include <algorithm>
 #include "clock.h"
+#include "utils.h"
 
 #define AUDIO_ENGIN                 0x01
 #define AUDIO_SAMPLE_RATE           0x02
 #define AUDIO_SAMPLE_FORMAT         0x04
 #define AUDIO_SAMPLE_BUFFER_SIZE    0x08
+#define AUDIO_FILE_PATH             0x10
+
+
+// NOTES: devices are created by name, "AudioTrackDevice" plays through android.media.AudioTrack,
+//        "WavAudioDevice" is a host stand-in which consumes samples in real time and may save them
 
 
 struct AudioDevice {
@@ -27,6 +34,16 @@ struct AudioDevice {
     virtual void stop() = 0;
 };
 
+// NOTES: in microseconds
+#define AUDIO_CLOCK_SAMPLE_INTERVAL     50000   // readers query the device at most this often
+#define AUDIO_CLOCK_STALL_TIME          100000  // an unchanged position for this long means not playing
+#define AUDIO_CLOCK_MAX_DRIFT           40000   // larger errors are corrected at once, smaller ones slewed
+
+//
+// The master clock. The device playback position is sampled on a bounded cadence (and after each
+// write by the audio render), readings in between are interpolated with the monotonic time, so most
+// reads don't query the device. Readings are monotonic until the offset is set again.
+//
 struct AudioDeviceClock: public Clock {
 
     AudioDeviceClock(AudioDevice* audioDevice) {
@@ -34,32 +51,144 @@ struct AudioDeviceClock: public Clock {
     }
 
     int64_t runningTime() override {
-        int64_t sampleRate = audioDevice->getSampleRate();
-        int64_t sampleFrames = audioDevice->getPlaybackPosition();
-        int64_t running = 0;
-        if (sampleRate != 0) {
-            running = 1000000L*sampleFrames/sampleRate;
-        }
+        std::unique_lock<std::mutex> lock(m);
+        // NOTES: advance() switches the offset at the start of the next segment
+        int64_t running = advance(monotonicTime());
         return offset.load() + running;
     }
 
+    // NOTES: samples the device position now, called on the audio render thread after writes
+    void update() {
+        std::unique_lock<std::mutex> lock(m);
+        sample(monotonicTime());
+    }
+
     int64_t baseTime() override {
         return absoluteTime() - runningTime();
     }
 
-    int64_t absoluteTime() override {
-        using namespace std::chrono;
-        system_clock::time_point tp = system_clock::now();
-        system_clock::duration d = tp.time_since_epoch();
-        return duration_cast<microseconds>(d).count();
+    void setDevice(AudioDevice* audioDevice) {
+        std::unique_lock<std::mutex> lock(m);
+        this->audioDevice = audioDevice;
+        reset();
     }
 
+    // NOTES: restarts the interpolation, the device position is expected to restart as well
     void setOffset(uint64_t offsetTime) {
+        std::unique_lock<std::mutex> lock(m);
         offset.store(offsetTime);
+        nextPosition = -1;
+        reset();
+    }
+
+    // NOTES: for a gapless switch, the device position goes on but from position (in microseconds)
+    //        on the samples are of the next source, whose running time continues from offsetTime
+    void setNextOffset(int64_t position, int64_t offsetTime) {
+        std::unique_lock<std::mutex> lock(m);
+        nextPosition = position;
+        nextOffset = offsetTime;
+        if (segmentNotifier) {
+            segmentNotifier->notify();
+        }
+    }
+
+    // NOTES: in microseconds of playback until the pending switch of setNextOffset, so the segment
+    //        changes on the first reading after it. -1 if no switch is pending
+    int64_t untilNextSegment() override {
+        std::unique_lock<std::mutex> lock(m);
+        int64_t running = advance(monotonicTime());
+        return nextPosition >= 0 ? nextPosition - running : -1;
+    }
+
+    void setSegmentNotifier(Notifier* notifier) override {
+        std::unique_lock<std::mutex> lock(m);
+        segmentNotifier = notifier;
+    }
+
+    // NOTES: counts the sources switched to by setNextOffset
+    int getSegment() override {
+        return segment.load();
     }
 
 private:
-    std::atomic<int64_t> offset;
+    // NOTES: the running time of the device position now, without the offset
+    int64_t advance(int64_t now) {
+        if (sampledTime < 0 || now - sampledTime >= AUDIO_CLOCK_SAMPLE_INTERVAL) {
+            sample(now);
+        }
+        int64_t running = anchorRunning;
+        if (advancing) {
+            running += now - anchorTime;
+        }
+        running = std::max(running, lastRunning);
+        lastRunning = running;
+        if (nextPosition >= 0 && running >= nextPosition) {
+            // the first sample of the next source is playing
+            offset.store(nextOffset - nextPosition);
+            nextPosition = -1;
+            segment.fetch_add(1);
+        }
+        return running;
+    }
+
+    int64_t devicePosition() {
+        int64_t sampleRate = audioDevice->getSampleRate();
+        int64_t sampleFrames = audioDevice->getPlaybackPosition();
+        if (sampleRate == 0) {
+            return 0;
+        }
+        return 1000000L*sampleFrames/sampleRate;
+    }
+
+    void sample(int64_t now) {
+        int64_t position = devicePosition();
+        if (sampledPosition < 0) {
+            // the first sample after reset, the device may not be playing yet
+            sampledPosition = position;
+        } else if (position != sampledPosition) {
+            sampledPosition = position;
+            changedTime = now;
+        }
+        bool wasAdvancing = advancing;
+        // the position is updated in steps of a device period, so a short pause in its changes is normal
+        advancing = now - changedTime < AUDIO_CLOCK_STALL_TIME;
+        int64_t predicted = anchorRunning + (wasAdvancing ? now - anchorTime : 0);
+        int64_t error = position - predicted;
+        if (!wasAdvancing || !advancing || error > AUDIO_CLOCK_MAX_DRIFT || error < -AUDIO_CLOCK_MAX_DRIFT) {
+            anchorRunning = position;
+        } else {
+            anchorRunning = predicted + error/8;
+        }
+        anchorTime = now;
+        sampledTime = now;
+    }
+
+    void reset() {
+        sampledTime = -1;
+        sampledPosition = -1;
+        changedTime = INT64_MIN/2;
+        anchorRunning = 0;
+        anchorTime = 0;
+        lastRunning = 0;
+        advancing = false;
+    }
+
+private:
+    std::mutex m;
+    std::atomic<int64_t> offset{0};
     AudioDevice* audioDevice = nullptr;
+    // in microseconds of the monotonic time
+    int64_t sampledTime = -1;
+    int64_t changedTime = INT64_MIN/2;
+    int64_t anchorTime = 0;
+    // in microseconds of the device position
+    int64_t sampledPosition = -1;
+    int64_t anchorRunning = 0;
+    int64_t lastRunning = 0;
+    bool advancing = false;
+    // the pending switch of setNextOffset, nextPosition is negative if none
+    int64_t nextPosition = -1;
+    int64_t nextOffset = 0;
+    std::atomic<int> segment{0};
+    Notifier* segmentNotifier = nullptr;
 };
-
@@ -9,18 +9,47 @@ void AudioRender::rendering() {
     LOGD("rendering: thread stated");
     bool pendingEOS = false;
     bool firstFrame = true;
+    bool flushing = false;
+    // the next source of the playlist, see EVENT_SWITCH_SOURCE
+    Preroll* nextSource = nullptr;
+    // the next frame is the first one of the source switched to
+    bool sourceStart = false;
+    // the samples written since the device position was 0, in writtenRate, and in microseconds before
+    int64_t writtenSamples = 0;
+    int writtenRate = 0;
+    int64_t writtenTime = 0;
     for (;;) {
         // Handle events
         Event ev;
         if (eventQueue.pop(ev)) {
-            if (ev.id == EVENT_STOP_THREAD) {
-                audioDevice->flush();
-                audioDevice->stop();
+            if (ev.id == EVENT_STOP_THREAD || ev.id == EVENT_FLUSH_START) {
+                if (ev.id == EVENT_FLUSH_START && nextSource) {
+                    // the samples of the previous source are dropped anyway
+                    switchSource(nextSource);
+                    nextSource = nullptr;
+                }
+                sourceStart = false;
+                writtenSamples = 0;
+                writtenTime = 0;
+                if (ev.id == EVENT_FLUSH_START) {
+                    // drops the samples not played yet, the playback position restarts from 0
+                    audioDevice->pause();
+                    audioDevice->flush();
+                } else {
+                    audioDevice->flush();
+                    audioDevice->stop();
+                }
                 while (!bufferQueue.empty()) {
                     AVFrame* f = nullptr;
                     bufferQueue.pop(f);
                     ffWrapper->freeFrame(f);
                 }
+                if (ev.id == EVENT_FLUSH_START) {
+                    pendingEOS = false;
+                    flushing = true;
+                    static_cast<Notifier*>(ev.data)->notify();
+                    continue;
+                }
                 LOGD("rendering: thread exited");
                 break;
             };
@@ -28,45 +57,99 @@ void AudioRender::rendering() {
                 pendingEOS = true;
                 continue;
             }
+            if (ev.id == EVENT_SWITCH_SOURCE) {
+                nextSource = static_cast<Preroll*>(ev.data);
+                continue;
+            }
+            if (ev.id == EVENT_FLUSH_STOP) {
+                // the first frame at the new position sets the clock again
+                flushing = false;
+                firstFrame = true;
+                static_cast<Notifier*>(ev.data)->notify();
+                continue;
+            }
+            continue;
+        }
+
+        // Flushing
+        if (flushing) {
+            notifier.wait();
             continue;
         }
 
         // Current is STATE_PAUSED
         if (!firstFrame && states.getCurrent() == STATE_PAUSED) {
             audioDevice->pause();
-            LOGD("rendering: current state is STATE_PAUSED, will sleep 10ms");
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            LOGD("rendering: current state is STATE_PAUSED, wait for state change");
+            notifier.wait();
             continue;
         }
 
         // Current is STATE_PLAYING
         AVFrame* frame = nullptr;
         if (!bufferQueue.pop(frame)) {
+            if (nextSource) {
+                // all samples of the previous source are written, the decoder pushes the next ones
+                switchSource(nextSource);
+                nextSource = nullptr;
+                sourceStart = true;
+                continue;
+            }
             if (pendingEOS) {
-                LOGD("rendering: end of stream, will sleep 10ms");
+                LOGD("rendering: end of stream, wait for events");
                 bus->sendMessage(Message(MESSAGE_EOS));
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                notifier.wait();
                 continue;
             }
-            LOGW("rendering, buffer queue is empty");
+            LOGW("rendering, buffer queue is empty, wait for buffers");
+            notifier.wait();
             continue;
         }
         // Output the audio stream
         if (firstFrame) {
             firstFrame = false;
-            static_cast<AudioDeviceClock*>(clock)->setOffset(frame->pts * ffWrapper->audioTimeBase() * 1000000);
+            clock->setOffset(frame->pts * ffWrapper->audioTimeBase() * 1000000);
             ffWrapper->freeFrame(frame);
         } else {
+            if (sourceStart) {
+                // the running time goes on from this frame once the device plays it
+                sourceStart = false;
+                int64_t pts = frame->pts != AV_NOPTS_VALUE ? frame->pts * ffWrapper->audioTimeBase() * 1000000 : 0;
+                int64_t position = writtenTime + (writtenRate > 0 ? writtenSamples*1000000/writtenRate : 0);
+                clock->setNextOffset(position, pts);
+                LOGD("rendering: next source starts at %lldms of the device, pts=%lldms",
+                     (long long)position/1000, (long long)pts/1000);
+            }
+            // at the device rate, which the samples of all sources are converted to
+            if (frame->sample_rate != writtenRate) {
+                writtenTime += writtenRate > 0 ? writtenSamples*1000000/writtenRate : 0;
+                writtenSamples = 0;
+                writtenRate = frame->sample_rate;
+            }
+            writtenSamples += frame->nb_samples;
             audioDevice->play();
             audioDevice->write(frame, sizeof(AVFrame));
+            // the position is fresh after a blocking write, readers of the clock needn't query it
+            clock->update();
             LOGD("rendering: clock running time is %lld", clock->runningTime()/1000);
         }
     }
 }
 
+void AudioRender::switchSource(Preroll* preroll) {
+    ffWrapper = preroll->getEngine();
+    audioDevice->setProperty(AUDIO_ENGIN, ffWrapper);
+    LOGD("switchSource: %s", preroll->getUrl().c_str());
+    Event switched(EVENT_SOURCE_SWITCHED);
+    switched.value = SWITCHED_AUDIO_RENDER;
+    audioDecoder->onEvent(switched);
+}
+
 AudioRender::AudioRender() {
     audioDevice = AudioDevice::create("AudioTrackDevice");
     clock = new AudioDeviceClock(audioDevice); 
+    eventQueue.setNotifiers(&notifier);
+    bufferQueue.setNotifiers(&notifier);
 }
 
 AudioRender::~AudioRender() {
@@ -74,6 +157,24 @@ AudioRender::~AudioRender() {
     delete audioDevice;
 }
 
+bool AudioRender::setDevice(const std::string& name) {
+    if (states.getCurrent() != STATE_NULL) {
+        LOGE("setDevice failed: current state is %s", cstr(states.getCurrent()));
+        return false;
+    }
+    AudioDevice* device = AudioDevice::create(name);
+    if (!device) {
+        return false;
+    }
+    if (ffWrapper) {
+        device->setProperty(AUDIO_ENGIN, ffWrapper);
+    }
+    clock->setDevice(device);
+    AudioDevice::release(audioDevice);
+    audioDevice = device;
+    return true;
+}
+
 int AudioRender::toNull() {
     State current = states.getCurrent();
     if (!checkState(current, STATE_NULL)) {
@@ -116,6 +217,7 @@ int AudioRender::toPaused() {
     }
     // current == STATE_PLAYING
     states.setCurrent(STATE_PAUSED);
+    notifier.notify();
     return STATUS_SUCCESS;
 }
 
@@ -126,6 +228,7 @@ int AudioRender::toPlaying() {
         return STATUS_FAILED;
     }
     states.setCurrent(STATE_PLAYING);
+    notifier.notify();
     return STATUS_SUCCESS;
 }
 
@@ -166,7 +269,3 @@ int AudioRender::onBuffer(const Buffer& buffer) {
     }
     return STATUS_SUCCESS;
 }
-
-bool AudioRender::BufferCompare::operator()(const AVFrame* lFrame, const AVFrame* rFrame) {
-    return lFrame->pts >= rFrame->pts;
-};
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "ffwrapper.h"
 #include "utils.h"
 #include "audio_device.h"
+#include "preroll.h"
 
 class AudioRender: public Element {
 public:   
@@ -15,10 +16,10 @@ public:
         this->bus = bus;
     }
     
+    // NOTES: the render provides the clock of the pipeline, the clock of its device
     void setClock(Clock* clock) override {
-        this->clock = clock;
     }
-    Clock* getClock() override {
+    AudioDeviceClock* getClock() override {
         return clock;
     }
 
@@ -29,14 +30,24 @@ public:
     
     int onEvent(const Event& event) override;
     int onBuffer(const Buffer& buffer) override;
+    Notifier* getNotifier() override {
+        return &notifier;
+    }
 
 public:
     void setEngine(FFWrapper* ffWrapper) {
         this->ffWrapper = ffWrapper;
         audioDevice->setProperty(AUDIO_ENGIN, ffWrapper);
     }
+    // NOTES: replaces the default AudioTrackDevice, should be called in STATE_NULL
+    bool setDevice(const std::string& name);
+    // NOTES: AUDIO_XXX of the device, e.g. AUDIO_FILE_PATH of the WavAudioDevice
+    bool setDeviceProperty(int key, void* value) {
+        return audioDevice->setProperty(key, value);
+    }
     void setSource(Element* audioDecoder) {
         this->audioDecoder = audioDecoder;
+        bufferQueue.setNotifiers(&notifier, audioDecoder->getNotifier());
     }
 
 private:
@@ -45,9 +56,11 @@ private:
     int toPaused();
     int toPlaying();
     void rendering();
+    // NOTES: continues with the engine of the next source
+    void switchSource(Preroll* preroll);
 
 private:
-    Clock* clock = nullptr;
+    AudioDeviceClock* clock = nullptr;
     Bus* bus = nullptr;
     FFWrapper* ffWrapper = nullptr;
     Element* audioDecoder = nullptr;
@@ -56,10 +69,6 @@ private:
     AudioDevice* audioDevice = nullptr;
     std::thread renderingThread;
     Queue<Event> eventQueue;
-
-private:
-    struct BufferCompare {
-        bool operator()(const AVFrame* lFrame, const AVFrame* rFrame);
-    };
-    PriorityQueue<AVFrame*, BufferCompare> bufferQueue;
+    Notifier notifier;
+    RingBuffer<AVFrame*> bufferQueue;
 };
\ No newline at end of file
@@ -10,74 +10,88 @@
 //
 extern JNIEnv* getJNIEnv(void);
 
-static void callVoidMethod(jobject obj, const char* name, const char* sig, ...) {
-	JNIEnv* env = getJNIEnv();
-	jclass cls = env->GetObjectClass(obj);
-	if (!cls) {
-		LOGE("callVoidMethod: GetObjectClass failed");
-		return;
-	}
-	jmethodID mID = env->GetMethodID(cls, name, sig);
+//
+// Class and method IDs, resolved once by initAudioTrackBindings()
+//
+struct AudioTrackBindings {
+	bool initialized = false;
+	jclass audioTrackClass = nullptr;
+	jmethodID constructor = nullptr;
+	jmethodID getMinBufferSize = nullptr;
+	jmethodID play = nullptr;
+	jmethodID pause = nullptr;
+	jmethodID stop = nullptr;
+	jmethodID flush = nullptr;
+	jmethodID release = nullptr;
+	jmethodID write = nullptr;
+	jmethodID getPlaybackHeadPosition = nullptr;
+	jmethodID getPlayState = nullptr;
+	jmethodID clearBuffer = nullptr;
+};
+
+static AudioTrackBindings gBindings;
+
+static jmethodID getMethodID(JNIEnv* env, jclass cls, const char* name, const char* sig, bool isStatic = false) {
+	jmethodID mID = isStatic ? env->GetStaticMethodID(cls, name, sig) : env->GetMethodID(cls, name, sig);
 	if (!mID) {
-		LOGE("callVoidMethod: GetMethodID: name=%s, sig=%s failed", name, sig);
-		return;
+		LOGE("initAudioTrackBindings: GetMethodID: name=%s, sig=%s failed", name, sig);
 	}
-
-    va_list args;
-    va_start(args, sig);
-    env->CallVoidMethodV(obj, mID, args);
-	va_end(args);
+	return mID;
 }
 
-#define CALL_OBJECT_METHOD_IMPLEMENT(jtype, type)										\
-static jtype call##type##Method(jobject obj, const char* name, const char* sig, ...) {			\
-	jtype result;																			\
-	JNIEnv* env = getJNIEnv();																\
-	if (!env) {																				\
-		LOGE("call"#type"Method: JNIEnv pointer is null");								\
-		return result;																		\
-	}																						\
-	jclass cls = env->GetObjectClass(obj);													\
-	if (!cls) {																				\
-		LOGE("call"#type"Method: GetObjectClass failed");								\
-		return result;																		\
-	}																						\
-	jmethodID mID = env->GetMethodID(cls, name, sig);										\
-	if (!mID) {																				\
-		LOGE("call"#type"Method: GetMethodID: name=%s, sig=%s failed", name, sig);	\
-		return result;																		\
-	}																						\
-    va_list args;																			\
-    va_start(args, sig);																	\
-    result = env->Call##type##MethodV(obj, mID, args);										\
-	va_end(args);																			\
-    env->DeleteLocalRef(cls);																\
-	return result;																			\
-}
+bool initAudioTrackBindings(JNIEnv* env) {
+	if (gBindings.initialized) {
+		return true;
+	}
+	jclass audioTrackClass = env->FindClass("android/media/AudioTrack");
+	if (!audioTrackClass) {
+		LOGE("initAudioTrackBindings: FindClass: android/media/AudioTrack failed");
+		return false;
+	}
+	AudioTrackBindings b;
+	b.audioTrackClass = static_cast<jclass>(env->NewGlobalRef(audioTrackClass));
+	env->DeleteLocalRef(audioTrackClass);
+	//
+	// AudioTrack(int streamType, int sampleRateInHz, int channelConfig,
+	//			  int audioFormat, int bufferSizeInBytes, int mode)
+	//
+	b.constructor = getMethodID(env, b.audioTrackClass, "<init>", "(IIIIII)V");
+	// static int getMinBufferSize (int sampleRateInHz, int channelConfig, int audioFormat)
+	b.getMinBufferSize = getMethodID(env, b.audioTrackClass, "getMinBufferSize", "(III)I", true);
+	b.play = getMethodID(env, b.audioTrackClass, "play", "()V");
+	b.pause = getMethodID(env, b.audioTrackClass, "pause", "()V");
+	b.stop = getMethodID(env, b.audioTrackClass, "stop", "()V");
+	b.flush = getMethodID(env, b.audioTrackClass, "flush", "()V");
+	b.release = getMethodID(env, b.audioTrackClass, "release", "()V");
+	// int write(ByteBuffer audioData, int sizeInBytes, int writeMode), since API 21
+	b.write = getMethodID(env, b.audioTrackClass, "write", "(Ljava/nio/ByteBuffer;II)I");
+	b.getPlaybackHeadPosition = getMethodID(env, b.audioTrackClass, "getPlaybackHeadPosition", "()I");
+	b.getPlayState = getMethodID(env, b.audioTrackClass, "getPlayState", "()I");
+
+	jclass bufferClass = env->FindClass("java/nio/Buffer");
+	if (bufferClass) {
+		// Buffer clear()
+		b.clearBuffer = getMethodID(env, bufferClass, "clear", "()Ljava/nio/Buffer;");
+		env->DeleteLocalRef(bufferClass);
+	}
 
-CALL_OBJECT_METHOD_IMPLEMENT(jobject, Object)
-CALL_OBJECT_METHOD_IMPLEMENT(jboolean, Boolean)
-CALL_OBJECT_METHOD_IMPLEMENT(jbyte, Byte)
-CALL_OBJECT_METHOD_IMPLEMENT(jchar, Char)
-CALL_OBJECT_METHOD_IMPLEMENT(jshort, Short)
-CALL_OBJECT_METHOD_IMPLEMENT(jint, Int)
-CALL_OBJECT_METHOD_IMPLEMENT(jlong, Long)
-CALL_OBJECT_METHOD_IMPLEMENT(jfloat, Float)
-CALL_OBJECT_METHOD_IMPLEMENT(jdouble, Double)
+	if (!b.constructor || !b.getMinBufferSize || !b.play || !b.pause || !b.stop || !b.flush ||
+		!b.release || !b.write || !b.getPlaybackHeadPosition || !b.getPlayState || !b.clearBuffer) {
+		env->DeleteGlobalRef(b.audioTrackClass);
+		return false;
+	}
+	b.initialized = true;
+	gBindings = b;
+	LOGI("initAudioTrackBindings succeed");
+	return true;
+}
 
 jobject newAudioTrack(int sampleRateInHZ)
 {
 	jobject audioTrackObject = 0;
 	JNIEnv* env = getJNIEnv();
-	jclass audioTrackClass = env->FindClass("android/media/AudioTrack");
-	if (!audioTrackClass) {
-		LOGE("newAudioTrack: FindClass: android/media/AudioTrack failed");
-		return audioTrackObject;
-	}
-
-	jmethodID constructor = env->GetMethodID(audioTrackClass, "<init>", "(IIIIII)V");
-	if (!constructor) {
-		LOGE("newAudioTrack: GetMethodID: <init>, (IIIIII)V failed");
+	if (!initAudioTrackBindings(env)) {
+		LOGE("newAudioTrack: AudioTrack bindings are not available");
 		return audioTrackObject;
 	}
 
@@ -87,22 +101,18 @@ jobject newAudioTrack(int sampleRateInHZ)
 	const int STREAM_MUSIC = 0x3;
 	const int MODE_STREAM = 0x1;
 
-	// int getMinBufferSize (int sampleRateInHz, int channelConfig, int audioFormat)
-	jmethodID getMinBufferSize = env->GetStaticMethodID(audioTrackClass, "getMinBufferSize", "(III)I");
-	const int bufferSize = env->CallStaticIntMethod(audioTrackClass, getMinBufferSize, sampleRateInHZ,
-													CHANNEL_OUT_STEREO, ENCODING_PCM_16BIT);
-	//
-	// AudioTrack(int streamType, int sampleRateInHz, int channelConfig,
-	//			  int audioFormat, int bufferSizeInBytes, int mode)
-	//
-	audioTrackObject = env->NewObject(audioTrackClass, constructor, STREAM_MUSIC, sampleRateInHZ,
+	const int bufferSize = env->CallStaticIntMethod(gBindings.audioTrackClass, gBindings.getMinBufferSize,
+		sampleRateInHZ, CHANNEL_OUT_STEREO, ENCODING_PCM_16BIT);
+	audioTrackObject = env->NewObject(gBindings.audioTrackClass, gBindings.constructor, STREAM_MUSIC, sampleRateInHZ,
 									  CHANNEL_OUT_STEREO, ENCODING_PCM_16BIT, bufferSize, MODE_STREAM);
 	if (!audioTrackObject) {
 		LOGE("newAudioTrack: NewObject failed");
 		return audioTrackObject;
 	}
 
-	audioTrackObject = env->NewGlobalRef(audioTrackObject);
+	jobject localObject = audioTrackObject;
+	audioTrackObject = env->NewGlobalRef(localObject);
+	env->DeleteLocalRef(localObject);
 	if (!audioTrackObject) {
 		LOGE("newAudioTrack: NewGlobalRef failed");
 		return audioTrackObject;
@@ -120,59 +130,75 @@ void playAudioTrack(jobject audioTrack) {
     //
     // void play()
     //
-	callVoidMethod(audioTrack, "play", "()V");
+	getJNIEnv()->CallVoidMethod(audioTrack, gBindings.play);
 }
 
-int writeAudioTrack(jobject audioTrack, void* buffer, int len) {
+jobject newAudioTrackBuffer(void* buffer, int capacity) {
 	JNIEnv* env = getJNIEnv();
-	jbyteArray array = env->NewByteArray(len);
-	env->SetByteArrayRegion(array, 0, len, (const jbyte*)buffer);
+	jobject byteBuffer = env->NewDirectByteBuffer(buffer, capacity);
+	if (!byteBuffer) {
+		LOGE("newAudioTrackBuffer: NewDirectByteBuffer failed");
+		return nullptr;
+	}
+	jobject globalBuffer = env->NewGlobalRef(byteBuffer);
+	env->DeleteLocalRef(byteBuffer);
+	return globalBuffer;
+}
+
+void deleteAudioTrackBuffer(jobject byteBuffer) {
+	JNIEnv* env = getJNIEnv();
+	env->DeleteGlobalRef(byteBuffer);
+}
+
+int writeAudioTrackBuffer(jobject audioTrack, jobject byteBuffer, int len) {
+	JNIEnv* env = getJNIEnv();
+	// AudioTrack advances the buffer position by the written bytes, rewind it first
+	jobject self = env->CallObjectMethod(byteBuffer, gBindings.clearBuffer);
+	env->DeleteLocalRef(self);
 	//
-	// int write(byte[] buffer, int offset, int size);
+	// int write(ByteBuffer audioData, int sizeInBytes, int writeMode)
 	//
-	int count = callIntMethod(audioTrack, "write", "([BII)I", array, 0, len);
-	env->DeleteLocalRef(array);
-	return count;
+	return env->CallIntMethod(audioTrack, gBindings.write, byteBuffer, len, WRITE_BLOCKING);
 }
 
 int getAudioTrackPosition(jobject audioTrack) {
     //
     // int getPlaybackHeadPosition();
     //
-    return callIntMethod(audioTrack, "getPlaybackHeadPosition", "()I");
+    return getJNIEnv()->CallIntMethod(audioTrack, gBindings.getPlaybackHeadPosition);
 }
 
 int getAudioTrackPlayState(jobject audioTrack) {
     //
     // int getPlayState();
     //
-    return callIntMethod(audioTrack, "getPlayState", "()I");
+    return getJNIEnv()->CallIntMethod(audioTrack, gBindings.getPlayState);
 }
 
 void stopAudioTrack(jobject audioTrack) {
     //
     // void stop()
     //
-    callVoidMethod(audioTrack, "stop", "()V");
+    getJNIEnv()->CallVoidMethod(audioTrack, gBindings.stop);
 }
 
 void pauseAudioTrack(jobject audioTrack) {
     //
     // void pause()
     //
-    callVoidMethod(audioTrack, "pause", "()V");
+    getJNIEnv()->CallVoidMethod(audioTrack, gBindings.pause);
 }
 
 void flushAudioTrack(jobject audioTrack) {
     //
     // void flush()
     //
-    callVoidMethod(audioTrack, "flush", "()V");
+    getJNIEnv()->CallVoidMethod(audioTrack, gBindings.flush);
 }
 
 void releaseAudioTrack(jobject audioTrack) {
     //
     // void release()
     //
-    callVoidMethod(audioTrack, "release", "()V");
-}
\ No newline at end of file
+    getJNIEnv()->CallVoidMethod(audioTrack, gBindings.release);
+}
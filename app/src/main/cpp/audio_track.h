@@ -7,10 +7,20 @@
 #define PLAYSTATE_PAUSED    (0x00000002)
 #define PLAYSTATE_PLAYING   (0x00000003)
 
+// The writeMode of AudioTrack.write()
+#define WRITE_BLOCKING      (0x00000000)
+
+// NOTES: resolves the AudioTrack class and method IDs once, should be called from a java thread
+//        (e.g. Player.nativeInit), the other functions don't look up anything by name
+bool initAudioTrackBindings(JNIEnv* env);
 jobject newAudioTrack(int sampleRateInHZ);
 void deleteAudioTrack(jobject audioTrack);
 void playAudioTrack(jobject audioTrack);
-int writeAudioTrack(jobject audioTrack, void* buffer, int len);
+// NOTES: a direct ByteBuffer over native memory, audio is written from it without copies into java arrays
+jobject newAudioTrackBuffer(void* buffer, int capacity);
+void deleteAudioTrackBuffer(jobject byteBuffer);
+// NOTES: writes the first len bytes of byteBuffer
+int writeAudioTrackBuffer(jobject audioTrack, jobject byteBuffer, int len);
 int getAudioTrackPosition(jobject audioTrack);
 int getAudioTrackPlayState(jobject audioTrack);
 void stopAudioTrack(jobject audioTrack);
@@ -0,0 +1,161 @@
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <algorithm>
+#include <mutex>
+#include "log.h"
+#include "byte_source.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/mem.h>
+#include <libavutil/error.h>
+}
+
+#undef  LOG_TAG
+#define LOG_TAG "ByteSource"
+
+#define MIN_IO_BUFFER_SIZE  4096
+
+// the opaque of the AVIOContext
+struct SourceIO {
+    ByteSource* source;
+    int64_t position;
+};
+
+static int readPacket(void* opaque, uint8_t* buf, int size) {
+    SourceIO* io = static_cast<SourceIO*>(opaque);
+    int n = io->source->read(buf, size);
+    if (n > 0) {
+        io->position += n;
+    }
+    // NOTES: 0 would make the demuxer retry forever on some FFmpeg versions
+    return n == 0 ? AVERROR_EOF : n;
+}
+
+static int64_t seekPacket(void* opaque, int64_t offset, int whence) {
+    SourceIO* io = static_cast<SourceIO*>(opaque);
+    int64_t size = io->source->size();
+    if (whence & AVSEEK_SIZE) {
+        return size >= 0 ? size : AVERROR(ENOSYS);
+    }
+    int64_t target = -1;
+    switch (whence & ~AVSEEK_FORCE) {
+    case SEEK_SET:
+        target = offset;
+        break;
+    case SEEK_CUR:
+        target = io->position + offset;
+        break;
+    case SEEK_END:
+        target = size >= 0 ? size + offset : -1;
+        break;
+    }
+    if (target < 0) {
+        return AVERROR(EINVAL);
+    }
+    int64_t position = io->source->seek(target);
+    if (position >= 0) {
+        io->position = position;
+    }
+    return position;
+}
+
+AVIOContext* ByteSource::openContext(ByteSource* source, int bufferSize) {
+    bufferSize = std::max(bufferSize, MIN_IO_BUFFER_SIZE);
+    SourceIO* io = new SourceIO{source, 0};
+    uint8_t* buffer = static_cast<uint8_t*>(av_malloc(bufferSize));
+    AVIOContext* context = buffer ? avio_alloc_context(buffer, bufferSize, 0, io, readPacket, nullptr, seekPacket) : nullptr;
+    if (!context) {
+        LOGE("openContext: avio_alloc_context failed");
+        av_free(buffer);
+        delete io;
+        return nullptr;
+    }
+    // the demuxer starts probing from here
+    if (source->seek(0) < 0) {
+        LOGW("openContext: the source can't seek to its start");
+    }
+    context->direct = source->direct();
+    return context;
+}
+
+void ByteSource::closeContext(AVIOContext** context) {
+    if (!*context) {
+        return;
+    }
+    delete static_cast<SourceIO*>((*context)->opaque);
+    av_freep(&(*context)->buffer);
+    avio_context_free(context);
+}
+
+
+int MemorySource::read(uint8_t* buf, int size) {
+    if (position >= dataSize) {
+        return AVERROR_EOF;
+    }
+    int n = int(std::min(int64_t(size), dataSize - position));
+    memcpy(buf, data + position, n);
+    position += n;
+    return n;
+}
+
+int64_t MemorySource::seek(int64_t offset) {
+    if (offset < 0) {
+        return AVERROR(EINVAL);
+    }
+    // NOTES: past the end is allowed, reads return AVERROR_EOF there
+    position = offset;
+    return position;
+}
+
+
+UrlSource::~UrlSource() {
+    close();
+}
+
+void UrlSource::close() {
+    if (context) {
+        avio_closep(&context);
+    }
+}
+
+bool UrlSource::connect() {
+    if (context || error) {
+        return context != nullptr;
+    }
+    static std::once_flag networkInit;
+    std::call_once(networkInit, [] {
+        avformat_network_init();
+    });
+    error = avio_open2(&context, url.c_str(), AVIO_FLAG_READ, nullptr, nullptr);
+    if (error < 0) {
+        LOGE("connect: avio_open2(%s) failed, error=%d", url.c_str(), error);
+        context = nullptr;
+        return false;
+    }
+    error = 0;
+    return true;
+}
+
+int UrlSource::read(uint8_t* buf, int size) {
+    if (!connect()) {
+        return error;
+    }
+    return avio_read(context, buf, size);
+}
+
+int64_t UrlSource::seek(int64_t offset) {
+    if (!connect()) {
+        return error;
+    }
+    return avio_seek(context, offset, SEEK_SET);
+}
+
+int64_t UrlSource::size() {
+    if (!connect()) {
+        return -1;
+    }
+    int64_t size = avio_size(context);
+    return size >= 0 ? size : -1;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+extern "C" {
+#include <libavformat/avio.h>
+}
+
+//
+// Where the demuxer reads its bytes from when it isn't given a url: a memory buffer, a local file
+// read by FileInput, or anything else like a decrypting reader over a cache. An AVIOContext made
+// by openContext() calls it from the demuxing thread only.
+//
+class ByteSource {
+public:
+    virtual ~ByteSource() {}
+
+    // NOTES: returns the bytes read, at most size, AVERROR_EOF at the end or another AVERROR
+    virtual int read(uint8_t* buf, int size) = 0;
+    // NOTES: offset from the start, returns it or a negative AVERROR if it can't seek
+    virtual int64_t seek(int64_t offset) = 0;
+    // NOTES: in bytes, -1 if unknown
+    virtual int64_t size() = 0;
+    // NOTES: large reads of the demuxer go straight into its packets, skipping the AVIOContext
+    //        buffer. for sources whose reads are cheap at any size
+    virtual bool direct() {
+        return false;
+    }
+
+    // NOTES: the context keeps the read position, the source must outlive it
+    static AVIOContext* openContext(ByteSource* source, int bufferSize);
+    static void closeContext(AVIOContext** context);
+};
+
+//
+// A ByteSource over a buffer owned by the caller, which must outlive it. Nothing is copied
+// except into the demuxer's packets.
+//
+class MemorySource: public ByteSource {
+public:
+    MemorySource(const uint8_t* data, int64_t size) : data(data), dataSize(size) {}
+
+    int read(uint8_t* buf, int size) override;
+    int64_t seek(int64_t offset) override;
+    int64_t size() override {
+        return dataSize;
+    }
+    bool direct() override {
+        return true;
+    }
+
+private:
+    const uint8_t* data;
+    int64_t dataSize;
+    int64_t position = 0;
+};
+
+//
+// A ByteSource over a url read by FFmpeg's protocols, e.g. http with range requests on seeks. The
+// connection is made by the first call, so a source which ends up unused costs nothing.
+//
+class UrlSource: public ByteSource {
+public:
+    UrlSource(const std::string& url) : url(url) {}
+    ~UrlSource();
+
+    void close();
+
+    int read(uint8_t* buf, int size) override;
+    int64_t seek(int64_t offset) override;
+    int64_t size() override;
+
+private:
+    bool connect();
+
+private:
+    std::string url;
+    AVIOContext* context = nullptr;
+    // of the connection, it isn't retried
+    int error = 0;
+};
@@ -0,0 +1,563 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <linux/falloc.h>
+#include <algorithm>
+#include "log.h"
+#include "chunk_cache.h"
+
+extern "C" {
+#include <libavutil/error.h>
+}
+
+#undef  LOG_TAG
+#define LOG_TAG "ChunkCache"
+
+#define MAP_MAGIC       0x4d43424b  // "KBCM"
+#define MAP_VERSION     1
+
+// a map file is the header, the url, then a byte per chunk, set if it is in the data file
+struct MapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t chunkSize;
+    uint32_t urlSize;
+    int64_t contentLength;
+};
+
+static uint64_t fnv1a(const std::string& s) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : s) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static int64_t chunkCount(int64_t contentLength) {
+    return (contentLength + CACHE_CHUNK_SIZE - 1)/CACHE_CHUNK_SIZE;
+}
+
+
+ChunkCache::~ChunkCache() {
+    close();
+}
+
+bool ChunkCache::open(const std::string& directory, int64_t capacity) {
+    if (directory.empty()) {
+        close();
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(m);
+    if (directory == this->directory) {
+        this->capacity = capacity;
+        evict();
+        return true;
+    }
+    for (auto& it : entries) {
+        if (it.second.users > 0) {
+            LOGE("open: %s is in use, can't move to %s", this->directory.c_str(), directory.c_str());
+            return false;
+        }
+    }
+    lock.unlock();
+    close();
+    if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) {
+        LOGE("open: can't create %s, errno=%d", directory.c_str(), errno);
+        return false;
+    }
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        LOGE("open: can't open %s, errno=%d", directory.c_str(), errno);
+        return false;
+    }
+    lock.lock();
+    this->directory = directory;
+    this->capacity = capacity;
+
+    // the chunks of the urls used last go to the front of the LRU last
+    std::vector<std::pair<time_t, std::string>> maps;
+    std::vector<std::string> orphans;
+    while (struct dirent* e = readdir(dir)) {
+        std::string name = e->d_name;
+        std::string path = directory + "/" + name;
+        size_t dot = name.rfind('.');
+        std::string ext = dot == std::string::npos ? "" : name.substr(dot);
+        struct stat st;
+        if (ext == ".map" && stat(path.c_str(), &st) == 0) {
+            maps.emplace_back(st.st_mtime, path.substr(0, path.size() - ext.size()));
+        } else if (ext == ".chunks" || ext == ".tmp") {
+            orphans.push_back(path);
+        }
+    }
+    closedir(dir);
+    std::sort(maps.begin(), maps.end());
+    for (auto& map : maps) {
+        Entry entry;
+        if (!loadMap(map.second, &entry)) {
+            LOGW("open: %s is stale or corrupted", map.second.c_str());
+            unlink((map.second + ".map").c_str());
+            unlink((map.second + ".chunks").c_str());
+            continue;
+        }
+        std::string data = map.second + ".chunks";
+        orphans.erase(std::remove(orphans.begin(), orphans.end(), data), orphans.end());
+        Entry* e = &(entries[entry.url] = std::move(entry));
+        for (int64_t chunk = 0; chunk < (int64_t)e->present.size(); chunk++) {
+            if (e->present[chunk]) {
+                lru.push_front({e, chunk});
+                e->used[chunk] = lru.begin();
+                cachedBytes += chunkSize(e, chunk);
+            }
+        }
+    }
+    for (const std::string& orphan : orphans) {
+        // a data file without a map, or a map not renamed into place
+        unlink(orphan.c_str());
+    }
+    LOGI("open: %s, %d urls, %lld of %lld bytes", directory.c_str(), (int)entries.size(),
+        (long long)cachedBytes, (long long)capacity);
+    evict();
+    return true;
+}
+
+void ChunkCache::close() {
+    std::unique_lock<std::mutex> lock(m);
+    if (directory.empty()) {
+        return;
+    }
+    // reads in flight use the data files
+    unpinned.wait(lock, [this] { return pinnedChunks == 0; });
+    for (auto& it : entries) {
+        if (it.second.dirty) {
+            saveMap(&it.second);
+        }
+        closeData(&it.second);
+    }
+    LOGI("close: %s, hits=%lld, misses=%lld, fetched=%lld, evicted=%lld", directory.c_str(),
+        (long long)cacheStats.hits, (long long)cacheStats.misses, (long long)cacheStats.fetchedBytes,
+        (long long)cacheStats.evictedChunks);
+    entries.clear();
+    lru.clear();
+    cachedBytes = 0;
+    directory.clear();
+}
+
+bool ChunkCache::isOpen() {
+    std::unique_lock<std::mutex> lock(m);
+    return !directory.empty();
+}
+
+int64_t ChunkCache::contentLength(const std::string& url) {
+    std::unique_lock<std::mutex> lock(m);
+    Entry* entry = find(url);
+    return entry ? entry->contentLength : -1;
+}
+
+bool ChunkCache::acquire(const std::string& url, int64_t contentLength) {
+    std::unique_lock<std::mutex> lock(m);
+    if (directory.empty() || contentLength <= 0) {
+        return false;
+    }
+    Entry* entry = find(url);
+    if (entry && entry->contentLength != contentLength) {
+        LOGW("acquire: %s changed, %lld bytes now, was %lld", url.c_str(), (long long)contentLength,
+            (long long)entry->contentLength);
+        if (entry->users > 0) {
+            return false;
+        }
+        removeEntry(entry);
+        entry = nullptr;
+    }
+    if (!entry) {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx", (unsigned long long)fnv1a(url));
+        entry = &entries[url];
+        entry->url = url;
+        entry->path = directory + name;
+        entry->contentLength = contentLength;
+        entry->present.assign(chunkCount(contentLength), 0);
+        // an old data file of the same name would have holes where its chunks are missing
+        unlink((entry->path + ".chunks").c_str());
+        entry->dirty = true;
+    }
+    entry->users++;
+    return true;
+}
+
+void ChunkCache::release(const std::string& url) {
+    std::unique_lock<std::mutex> lock(m);
+    Entry* entry = find(url);
+    if (!entry || --entry->users > 0) {
+        return;
+    }
+    if (entry->dirty) {
+        saveMap(entry);
+    }
+    closeData(entry);
+}
+
+bool ChunkCache::read(const std::string& url, int64_t chunk, int offset, uint8_t* buf, int size) {
+    std::unique_lock<std::mutex> lock(m);
+    Entry* entry = find(url);
+    if (!entry || chunk >= (int64_t)entry->present.size() || !entry->present[chunk] || !openData(entry)) {
+        return false;
+    }
+    // NOTES: the chunk is pinned rather than read under the lock, other sources hit or fetch
+    //        meanwhile. the entry stays too, its source holds it and close() waits for the pins
+    entry->pinned[chunk]++;
+    pinnedChunks++;
+    int fd = entry->fd;
+    lock.unlock();
+
+    int64_t at = chunk*CACHE_CHUNK_SIZE + offset;
+    int done = 0;
+    int error = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, buf + done, size - done, at + done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            error = n < 0 ? errno : 0;
+            break;
+        }
+        done += n;
+    }
+
+    lock.lock();
+    unpin(entry, chunk);
+    if (done < size) {
+        // e.g. the data file was truncated, the chunk is fetched again
+        LOGE("read: pread(%s) at %lld failed, errno=%d", entry->path.c_str(), (long long)(at + done), error);
+        dropChunk(entry, chunk);
+        entry->dirty = true;
+        return false;
+    }
+    auto it = entry->used.find(chunk);
+    if (it != entry->used.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+    }
+    cacheStats.hits++;
+    return true;
+}
+
+bool ChunkCache::write(const std::string& url, int64_t chunk, const uint8_t* data, int size) {
+    std::unique_lock<std::mutex> lock(m);
+    Entry* entry = find(url);
+    if (!entry || chunk >= (int64_t)entry->present.size() || size != chunkSize(entry, chunk) ||
+        CACHE_CHUNK_SIZE > capacity || !openData(entry)) {
+        return false;
+    }
+    if (entry->present[chunk]) {
+        return true;
+    }
+    int64_t at = chunk*CACHE_CHUNK_SIZE;
+    int done = 0;
+    while (done < size) {
+        ssize_t n = pwrite(entry->fd, data + done, size - done, at + done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            // e.g. the storage is full, the chunk stays uncached
+            LOGE("write: pwrite(%s) at %lld failed, errno=%d", entry->path.c_str(), (long long)(at + done), errno);
+            return false;
+        }
+        done += n;
+    }
+    entry->present[chunk] = 1;
+    entry->dirty = true;
+    lru.push_front({entry, chunk});
+    entry->used[chunk] = lru.begin();
+    cachedBytes += size;
+    evict();
+    return true;
+}
+
+void ChunkCache::addFetched(int64_t bytes) {
+    std::unique_lock<std::mutex> lock(m);
+    cacheStats.misses++;
+    cacheStats.fetchedBytes += bytes;
+}
+
+CacheStats ChunkCache::stats() {
+    std::unique_lock<std::mutex> lock(m);
+    return cacheStats;
+}
+
+ChunkCache::Entry* ChunkCache::find(const std::string& url) {
+    auto it = entries.find(url);
+    return it != entries.end() ? &it->second : nullptr;
+}
+
+bool ChunkCache::openData(Entry* entry) {
+    if (entry->fd >= 0) {
+        return true;
+    }
+    std::string path = entry->path + ".chunks";
+    entry->fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (entry->fd < 0) {
+        LOGE("openData: can't open %s, errno=%d", path.c_str(), errno);
+        return false;
+    }
+    return true;
+}
+
+void ChunkCache::closeData(Entry* entry) {
+    if (entry->fd >= 0) {
+        ::close(entry->fd);
+        entry->fd = -1;
+    }
+}
+
+void ChunkCache::dropChunk(Entry* entry, int64_t chunk) {
+    auto it = entry->used.find(chunk);
+    if (it != entry->used.end()) {
+        lru.erase(it->second);
+        entry->used.erase(it);
+        entry->present[chunk] = 0;
+        cachedBytes -= chunkSize(entry, chunk);
+    }
+}
+
+void ChunkCache::unpin(Entry* entry, int64_t chunk) {
+    auto it = entry->pinned.find(chunk);
+    if (--it->second == 0) {
+        entry->pinned.erase(it);
+    }
+    if (--pinnedChunks == 0) {
+        unpinned.notify_all();
+    }
+}
+
+int ChunkCache::chunkSize(Entry* entry, int64_t chunk) {
+    return int(std::min(int64_t(CACHE_CHUNK_SIZE), entry->contentLength - chunk*CACHE_CHUNK_SIZE));
+}
+
+void ChunkCache::evict() {
+    // the chunk just written at the front stays, and so do the chunks being read, the cache is
+    // over capacity until they are unpinned
+    std::vector<ChunkRef> evicted;
+    auto it = lru.end();
+    while (cachedBytes > capacity && it != lru.begin() && --it != lru.begin()) {
+        ChunkRef ref = *it;
+        if (ref.entry->pinned.count(ref.chunk)) {
+            continue;
+        }
+        ++it;
+        dropChunk(ref.entry, ref.chunk);
+        cacheStats.evictedChunks++;
+        evicted.push_back(ref);
+    }
+    if (evicted.empty()) {
+        return;
+    }
+    // the maps no longer claim the chunks before their holes are punched, a crash in between
+    // leaves unused data rather than chunks read back as zeros
+    std::sort(evicted.begin(), evicted.end(), [](const ChunkRef& a, const ChunkRef& b) {
+        return a.entry != b.entry ? a.entry < b.entry : a.chunk < b.chunk;
+    });
+    for (size_t i = 0; i < evicted.size(); i++) {
+        Entry* entry = evicted[i].entry;
+        if (i == 0 || evicted[i - 1].entry != entry) {
+            saveMap(entry);
+        }
+    }
+    for (const ChunkRef& ref : evicted) {
+        Entry* entry = ref.entry;
+        bool opened = entry->fd >= 0;
+        if (!openData(entry)) {
+            continue;
+        }
+        int64_t at = ref.chunk*CACHE_CHUNK_SIZE;
+        if (fallocate(entry->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, at, chunkSize(entry, ref.chunk)) != 0) {
+            // e.g. a filesystem without holes, the space is reclaimed once the url is dropped
+            LOGW("evict: can't punch %s at %lld, errno=%d", entry->path.c_str(), (long long)at, errno);
+        }
+        if (!opened && entry->users == 0) {
+            closeData(entry);
+        }
+    }
+    for (auto it = entries.begin(); it != entries.end();) {
+        Entry& entry = it->second;
+        ++it;
+        if (entry.users == 0 && entry.used.empty()) {
+            removeEntry(&entry);
+        }
+    }
+    LOGD("evict: %d chunks, %lld bytes cached", (int)evicted.size(), (long long)cachedBytes);
+}
+
+bool ChunkCache::loadMap(const std::string& path, Entry* entry) {
+    FILE* file = fopen((path + ".map").c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    MapHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == MAP_MAGIC &&
+        header.version == MAP_VERSION && header.chunkSize == CACHE_CHUNK_SIZE && header.contentLength > 0 &&
+        header.urlSize > 0 && header.urlSize < 64*1024;
+    if (valid) {
+        entry->url.resize(header.urlSize);
+        entry->present.resize(chunkCount(header.contentLength));
+        valid = fread(&entry->url[0], 1, header.urlSize, file) == header.urlSize &&
+            fread(entry->present.data(), 1, entry->present.size(), file) == entry->present.size() &&
+            fgetc(file) == EOF;
+    }
+    fclose(file);
+    if (!valid) {
+        return false;
+    }
+    entry->path = path;
+    entry->contentLength = header.contentLength;
+    entry->dirty = false;
+    return true;
+}
+
+bool ChunkCache::saveMap(Entry* entry) {
+    // the old map stays intact until the new one is fully written
+    std::string path = entry->path + ".map";
+    std::string temp = path + ".tmp";
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (!file) {
+        LOGE("saveMap: fopen(%s) failed", temp.c_str());
+        return false;
+    }
+    MapHeader header = {MAP_MAGIC, MAP_VERSION, CACHE_CHUNK_SIZE, uint32_t(entry->url.size()), entry->contentLength};
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(entry->url.data(), 1, entry->url.size(), file) == entry->url.size() &&
+        fwrite(entry->present.data(), 1, entry->present.size(), file) == entry->present.size();
+    written = fclose(file) == 0 && written;
+    if (!written || rename(temp.c_str(), path.c_str()) != 0) {
+        LOGE("saveMap: write %s failed", path.c_str());
+        unlink(temp.c_str());
+        return false;
+    }
+    entry->dirty = false;
+    return true;
+}
+
+void ChunkCache::removeEntry(Entry* entry) {
+    for (auto& it : entry->used) {
+        cachedBytes -= chunkSize(entry, it.first);
+        lru.erase(it.second);
+    }
+    closeData(entry);
+    unlink((entry->path + ".map").c_str());
+    unlink((entry->path + ".chunks").c_str());
+    entries.erase(entry->url);
+}
+
+
+CachedSource::CachedSource(ChunkCache* cache, const std::string& url, ByteSource* upstream) :
+    cache(cache), url(url), upstream(upstream) {
+}
+
+CachedSource::~CachedSource() {
+    close();
+}
+
+bool CachedSource::open() {
+    close();
+    // a cached url is played without asking upstream anything
+    contentLength = cache->contentLength(url);
+    if (contentLength <= 0) {
+        contentLength = upstream->size();
+        upstreamPosition = 0;
+    }
+    if (contentLength <= 0 || !cache->acquire(url, contentLength)) {
+        LOGW("open: %s can't be cached, size=%lld", url.c_str(), (long long)contentLength);
+        contentLength = -1;
+        return false;
+    }
+    opened = true;
+    position = 0;
+    chunkBuffer.resize(CACHE_CHUNK_SIZE);
+    bufferedChunk = -1;
+    LOGI("open: %s, size=%lld", url.c_str(), (long long)contentLength);
+    return true;
+}
+
+void CachedSource::close() {
+    if (opened) {
+        cache->release(url);
+        opened = false;
+    }
+}
+
+int64_t CachedSource::seek(int64_t offset) {
+    if (offset < 0) {
+        return AVERROR(EINVAL);
+    }
+    // NOTES: upstream only seeks once a chunk there is missing
+    position = offset;
+    return position;
+}
+
+int CachedSource::read(uint8_t* buf, int size) {
+    if (!opened || position >= contentLength) {
+        return AVERROR_EOF;
+    }
+    int64_t chunk = position/CACHE_CHUNK_SIZE;
+    int within = int(position - chunk*CACHE_CHUNK_SIZE);
+    int n = int(std::min({int64_t(size), int64_t(CACHE_CHUNK_SIZE - within), contentLength - position}));
+    if (chunk != bufferedChunk && !cache->read(url, chunk, within, buf, n)) {
+        int error = fetch(chunk);
+        if (error < 0) {
+            return error;
+        }
+    }
+    if (chunk == bufferedChunk) {
+        n = std::min(n, bufferedSize - within);
+        if (n <= 0) {
+            return AVERROR_EOF;
+        }
+        memcpy(buf, chunkBuffer.data() + within, n);
+    }
+    position += n;
+    return n;
+}
+
+int CachedSource::fetch(int64_t chunk) {
+    int64_t offset = chunk*CACHE_CHUNK_SIZE;
+    int size = int(std::min(int64_t(CACHE_CHUNK_SIZE), contentLength - offset));
+    if (upstreamPosition != offset) {
+        // e.g. a new range request over http
+        int64_t position = upstream->seek(offset);
+        if (position != offset) {
+            LOGE("fetch: %s can't seek to %lld", url.c_str(), (long long)offset);
+            upstreamPosition = -1;
+            return position < 0 ? int(position) : AVERROR(EIO);
+        }
+    }
+    bufferedChunk = -1;
+    int done = 0;
+    int error = 0;
+    while (done < size) {
+        int n = upstream->read(chunkBuffer.data() + done, size - done);
+        if (n <= 0) {
+            error = n < 0 ? n : AVERROR_EOF;
+            break;
+        }
+        done += n;
+    }
+    upstreamPosition = offset + done;
+    cache->addFetched(done);
+    if (done == 0) {
+        LOGE("fetch: %s at %lld failed, error=%d", url.c_str(), (long long)offset, error);
+        upstreamPosition = -1;
+        return error;
+    }
+    bufferedChunk = chunk;
+    bufferedSize = done;
+    // NOTES: a short chunk, cut by an error or a server going away, is played but not cached
+    if (done == size) {
+        cache->write(url, chunk, chunkBuffer.data(), done);
+    }
+    return 0;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include "byte_source.h"
+
+// NOTES: in bytes, the unit remote media is fetched, cached and evicted in
+#define CACHE_CHUNK_SIZE    (256*1024)
+
+struct CacheStats {
+    // reads served from disk
+    int64_t hits = 0;
+    // chunks fetched from upstream
+    int64_t misses = 0;
+    int64_t fetchedBytes = 0;
+    int64_t evictedChunks = 0;
+};
+
+//
+// A read-through cache of remote media on disk, shared by all players. Each url has a sparse data
+// file, where chunk i is at offset i*CACHE_CHUNK_SIZE, and a map file telling which chunks are
+// fetched. The least recently used chunks of all urls are evicted once the cache is over capacity,
+// their holes are punched into the data files. A url is known again by its content length only,
+// media changed on the server keeping the length is not noticed.
+//
+class ChunkCache {
+public:
+    static ChunkCache& instance() {
+        static ChunkCache cache;
+        return cache;
+    }
+
+    ~ChunkCache();
+
+    // NOTES: loads the maps found in directory, capacity is in bytes. an empty directory closes
+    //        the cache, it can't change while sources use the cache
+    bool open(const std::string& directory, int64_t capacity);
+    void close();
+    bool isOpen();
+    // NOTES: -1 if url isn't cached
+    int64_t contentLength(const std::string& url);
+    // NOTES: a source starts using url, what is cached of it is dropped if contentLength differs
+    bool acquire(const std::string& url, int64_t contentLength);
+    // NOTES: the map of url is saved once no source uses it anymore
+    void release(const std::string& url);
+    // NOTES: size bytes from offset within chunk, returns false if the chunk isn't cached
+    bool read(const std::string& url, int64_t chunk, int offset, uint8_t* buf, int size);
+    // NOTES: data is the whole chunk, only the last one of a url may be shorter
+    bool write(const std::string& url, int64_t chunk, const uint8_t* data, int size);
+    // NOTES: a chunk was fetched from upstream, cached or not
+    void addFetched(int64_t bytes);
+    CacheStats stats();
+
+private:
+    struct Entry;
+    struct ChunkRef {
+        Entry* entry;
+        int64_t chunk;
+    };
+    struct Entry {
+        std::string url;
+        // of the data and the map file, without extension
+        std::string path;
+        int fd = -1;
+        int64_t contentLength = -1;
+        std::vector<uint8_t> present;
+        std::map<int64_t, std::list<ChunkRef>::iterator> used;
+        // chunks being read outside the lock, by count of reads, they aren't evicted
+        std::map<int64_t, int> pinned;
+        int users = 0;
+        bool dirty = false;
+    };
+
+private:
+    Entry* find(const std::string& url);
+    bool openData(Entry* entry);
+    void closeData(Entry* entry);
+    void dropChunk(Entry* entry, int64_t chunk);
+    void unpin(Entry* entry, int64_t chunk);
+    int chunkSize(Entry* entry, int64_t chunk);
+    void evict();
+    bool loadMap(const std::string& path, Entry* entry);
+    bool saveMap(Entry* entry);
+    void removeEntry(Entry* entry);
+
+private:
+    std::mutex m;
+    // signaled when the last pinned chunk is unpinned
+    std::condition_variable unpinned;
+    int pinnedChunks = 0;
+    std::string directory;
+    int64_t capacity = 0;
+    int64_t cachedBytes = 0;
+    std::map<std::string, Entry> entries;
+    // most recently used first
+    std::list<ChunkRef> lru;
+    CacheStats cacheStats;
+};
+
+//
+// A ByteSource over remote media which reads the chunks in the ChunkCache from disk, and fetches
+// the others from upstream, which is read sequentially as long as the demuxer reads on. Replays
+// and seeks within the fetched ranges don't touch upstream, not even to learn the size.
+//
+class CachedSource: public ByteSource {
+public:
+    // NOTES: upstream is only read on cache misses, the cache and upstream must outlive the source
+    CachedSource(ChunkCache* cache, const std::string& url, ByteSource* upstream);
+    ~CachedSource();
+
+    // NOTES: returns false if the size of the media is unknown, it can't be cached then
+    bool open();
+    void close();
+
+    int read(uint8_t* buf, int size) override;
+    int64_t seek(int64_t offset) override;
+    int64_t size() override {
+        return contentLength;
+    }
+
+private:
+    int fetch(int64_t chunk);
+
+private:
+    ChunkCache* cache;
+    std::string url;
+    ByteSource* upstream;
+    bool opened = false;
+    int64_t contentLength = -1;
+    int64_t position = 0;
+    // where upstream would read next, -1 if unknown
+    int64_t upstreamPosition = -1;
+    // the chunk fetched last, served from memory even if it couldn't be cached
+    std::vector<uint8_t> chunkBuffer;
+    int64_t bufferedChunk = -1;
+    int bufferedSize = 0;
+};
@@ -1,10 +1,148 @@
 #pragma once
 
 #include <stdint.h>
+#include <time.h>
 #include <chrono>
 #include <atomic>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+// NOTES: sleeps shorter than this are spun, the os may wake a sleeping thread up to this late
+#define SPIN_SLEEP_MARGIN   1000
+
+class Notifier;
+
+//
+// The monotonic timebase of all clocks and timing measurements, in microseconds. It never jumps
+// with wall clock (NTP or user) changes. Tests may install a FakeTimeSource to drive it.
+//
+struct TimeSource {
+    virtual ~TimeSource() {}
+    virtual int64_t now() = 0;
+    virtual void sleepFor(int64_t duration) = 0;
+    // NOTES: returns at the deadline as exactly as possible
+    virtual void sleepUntil(int64_t deadline) = 0;
+    // NOTES: waits on condition, whose mutex lock holds, until ready() or the deadline. returns ready()
+    virtual bool waitUntil(std::condition_variable& condition, std::unique_lock<std::mutex>& lock,
+        int64_t deadline, const std::function<bool()>& ready) = 0;
+
+    // NOTES: nullptr restores the monotonic time source
+    static void install(TimeSource* source);
+    static TimeSource* current();
+};
+
+struct MonotonicTimeSource: public TimeSource {
+    int64_t now() override {
+#ifdef CLOCK_MONOTONIC_RAW
+        // not slewed by NTP either
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return int64_t(ts.tv_sec)*1000000 + ts.tv_nsec/1000;
+#else
+        using namespace std::chrono;
+        return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    void sleepFor(int64_t duration) override {
+        if (duration > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(duration));
+        }
+    }
+
+    void sleepUntil(int64_t deadline) override {
+        // sleep for the bulk, spin for the last part
+        int64_t remaining = deadline - now();
+        if (remaining > SPIN_SLEEP_MARGIN) {
+            std::this_thread::sleep_for(std::chrono::microseconds(remaining - SPIN_SLEEP_MARGIN));
+        }
+        while (now() < deadline) {
+            std::this_thread::yield();
+        }
+    }
+
+    bool waitUntil(std::condition_variable& condition, std::unique_lock<std::mutex>& lock,
+        int64_t deadline, const std::function<bool()>& ready) override {
+        while (!ready()) {
+            int64_t remaining = deadline - now();
+            if (remaining <= 0) {
+                return false;
+            }
+            condition.wait_for(lock, std::chrono::microseconds(remaining));
+        }
+        return true;
+    }
+};
+
+//
+// Time only moves when told to, the sleeps advance it at once instead of blocking
+//
+struct FakeTimeSource: public TimeSource {
+    FakeTimeSource(int64_t start = 0) : time(start) {}
+
+    int64_t now() override {
+        return time.load();
+    }
+
+    void sleepFor(int64_t duration) override {
+        if (duration > 0) {
+            time.fetch_add(duration);
+        }
+    }
+
+    void sleepUntil(int64_t deadline) override {
+        int64_t t = time.load();
+        while (t < deadline && !time.compare_exchange_weak(t, deadline)) {
+        }
+    }
+
+    // NOTES: doesn't block either, unless ready() already it is at the deadline at once
+    bool waitUntil(std::condition_variable& condition, std::unique_lock<std::mutex>& lock,
+        int64_t deadline, const std::function<bool()>& ready) override {
+        if (!ready()) {
+            sleepUntil(deadline);
+        }
+        return ready();
+    }
+
+    void set(int64_t t) {
+        time.store(t);
+    }
+
+    void advance(int64_t duration) {
+        time.fetch_add(duration);
+    }
+
+private:
+    std::atomic<int64_t> time;
+};
+
+inline std::atomic<TimeSource*>& installedTimeSource() {
+    static std::atomic<TimeSource*> source{nullptr};
+    return source;
+}
+
+inline void TimeSource::install(TimeSource* source) {
+    installedTimeSource().store(source);
+}
+
+inline TimeSource* TimeSource::current() {
+    static MonotonicTimeSource monotonic;
+    TimeSource* source = installedTimeSource().load(std::memory_order_acquire);
+    return source ? source : &monotonic;
+}
+
+// NOTES: in microseconds of the current time source
+inline int64_t monotonicTime() {
+    return TimeSource::current()->now();
+}
+
 
 struct Clock {
+    virtual ~Clock() {}
+
     virtual int64_t runningTime() {
         return absoluteTime() - base.load();
     }
@@ -13,11 +151,9 @@ struct Clock {
         return base.load();
     }
 
+    // NOTES: monotonic, see TimeSource
     virtual int64_t absoluteTime() {
-        using namespace std::chrono;
-        system_clock::time_point tp = system_clock::now();
-        system_clock::duration d = tp.time_since_epoch();
-        return duration_cast<microseconds>(d).count();
+        return monotonicTime();
     }
 
     // NOTES: base unit is microseconds
@@ -25,6 +161,22 @@ struct Clock {
         base.store(baseTime);
     }
 
+    // NOTES: a clock playing a playlist gaplessly counts the sources switched to, the timestamps of
+    //        a source are only comparable with the running time in its segment. one segment here
+    virtual int getSegment() {
+        return 0;
+    }
+
+    // NOTES: in microseconds of running time until the pending switch to the next segment, -1 if
+    //        no switch is pending
+    virtual int64_t untilNextSegment() {
+        return -1;
+    }
+
+    // NOTES: notified when a switch is pending, for the elements waiting for the next segment
+    virtual void setSegmentNotifier(Notifier* notifier) {
+    }
+
 protected:
-    std::atomic<int64_t> base;
-};
\ No newline at end of file
+    std::atomic<int64_t> base{0};
+};
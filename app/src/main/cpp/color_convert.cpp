@@ -0,0 +1,280 @@
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "color_convert.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+//
+// BT.601 limited range coefficients in 6 bits fixed point:
+//  R = 1.164(Y-16) + 1.596(V-128)
+//  G = 1.164(Y-16) - 0.391(U-128) - 0.813(V-128)
+//  B = 1.164(Y-16) + 2.018(U-128)
+//
+#define YG  74
+#define VR  102
+#define UG  25
+#define VG  52
+#define UB  129
+
+static inline uint8_t clamp(int v) {
+    v >>= 6;
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+//
+// Converts one row, u/v are read with the given step (1 for planar, 2 for interleaved chroma)
+//
+static void convertRowC(const uint8_t* y, const uint8_t* u, const uint8_t* v, int step,
+    uint8_t* dst, int width) {
+    for (int i = 0; i < width; i++) {
+        int c = (y[i] - 16)*YG;
+        int d = u[(i/2)*step] - 128;
+        int e = v[(i/2)*step] - 128;
+        dst[4*i + 0] = clamp(c + VR*e);
+        dst[4*i + 1] = clamp(c - UG*d - VG*e);
+        dst[4*i + 2] = clamp(c + UB*d);
+        dst[4*i + 3] = 0xff;
+    }
+}
+
+#if defined(USE_NEON)
+
+static inline uint8x16x4_t yuvToRGBA16(uint8x16_t y, int16x8_t u, int16x8_t v) {
+    // duplicate each chroma sample for two pixels
+    int16x8x2_t uu = vzipq_s16(u, u);
+    int16x8x2_t vv = vzipq_s16(v, v);
+    int16x8_t y16 = vdupq_n_s16(16);
+    int16x8_t ylo = vmulq_n_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(y))), y16), YG);
+    int16x8_t yhi = vmulq_n_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(y))), y16), YG);
+    uint8x16x4_t rgba;
+    rgba.val[0] = vcombine_u8(
+        vqshrun_n_s16(vqaddq_s16(ylo, vmulq_n_s16(vv.val[0], VR)), 6),
+        vqshrun_n_s16(vqaddq_s16(yhi, vmulq_n_s16(vv.val[1], VR)), 6));
+    rgba.val[1] = vcombine_u8(
+        vqshrun_n_s16(vqsubq_s16(vqsubq_s16(ylo, vmulq_n_s16(uu.val[0], UG)), vmulq_n_s16(vv.val[0], VG)), 6),
+        vqshrun_n_s16(vqsubq_s16(vqsubq_s16(yhi, vmulq_n_s16(uu.val[1], UG)), vmulq_n_s16(vv.val[1], VG)), 6));
+    rgba.val[2] = vcombine_u8(
+        vqshrun_n_s16(vqaddq_s16(ylo, vmulq_n_s16(uu.val[0], UB)), 6),
+        vqshrun_n_s16(vqaddq_s16(yhi, vmulq_n_s16(uu.val[1], UB)), 6));
+    rgba.val[3] = vdupq_n_u8(0xff);
+    return rgba;
+}
+
+static void convertRow(const uint8_t* y, const uint8_t* u, const uint8_t* v, int step,
+    uint8_t* dst, int width) {
+    int i = 0;
+    uint8x8_t c128 = vdup_n_u8(128);
+    for (; i + 16 <= width; i += 16) {
+        uint8x8_t u8;
+        uint8x8_t v8;
+        if (step == 2) {
+            uint8x8x2_t uv = vld2_u8(u + i);
+            u8 = uv.val[0];
+            v8 = uv.val[1];
+        } else {
+            u8 = vld1_u8(u + i/2);
+            v8 = vld1_u8(v + i/2);
+        }
+        // NOTES: the unsigned difference reinterpreted as signed is u-128
+        int16x8_t u16 = vreinterpretq_s16_u16(vsubl_u8(u8, c128));
+        int16x8_t v16 = vreinterpretq_s16_u16(vsubl_u8(v8, c128));
+        vst4q_u8(dst + 4*i, yuvToRGBA16(vld1q_u8(y + i), u16, v16));
+    }
+    convertRowC(y + i, u + (i/2)*step, v + (i/2)*step, step, dst + 4*i, width - i);
+}
+
+#elif defined(USE_SSE2)
+
+static inline void yuvToRGBA8(__m128i y, __m128i u, __m128i v, uint8_t* dst) {
+    __m128i yy = _mm_mullo_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)), _mm_set1_epi16(YG));
+    __m128i r = _mm_srai_epi16(_mm_adds_epi16(yy, _mm_mullo_epi16(v, _mm_set1_epi16(VR))), 6);
+    __m128i g = _mm_srai_epi16(_mm_subs_epi16(_mm_subs_epi16(yy,
+        _mm_mullo_epi16(u, _mm_set1_epi16(UG))), _mm_mullo_epi16(v, _mm_set1_epi16(VG))), 6);
+    __m128i b = _mm_srai_epi16(_mm_adds_epi16(yy, _mm_mullo_epi16(u, _mm_set1_epi16(UB))), 6);
+    // saturate to 8 bits, then interleave as RGBA
+    __m128i rb = _mm_packus_epi16(r, b);
+    __m128i ga = _mm_packus_epi16(g, _mm_set1_epi16(0xff));
+    __m128i rg = _mm_unpacklo_epi8(rb, ga);
+    __m128i ba = _mm_unpackhi_epi8(rb, ga);
+    _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(rg, ba));
+}
+
+static void convertRow(const uint8_t* y, const uint8_t* u, const uint8_t* v, int step,
+    uint8_t* dst, int width) {
+    int i = 0;
+    __m128i zero = _mm_setzero_si128();
+    __m128i c128 = _mm_set1_epi16(128);
+    for (; i + 16 <= width; i += 16) {
+        __m128i u16;
+        __m128i v16;
+        if (step == 2) {
+            __m128i uv = _mm_loadu_si128((const __m128i*)(u + i));
+            u16 = _mm_and_si128(uv, _mm_set1_epi16(0xff));
+            v16 = _mm_srli_epi16(uv, 8);
+        } else {
+            u16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(u + i/2)), zero);
+            v16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(v + i/2)), zero);
+        }
+        u16 = _mm_sub_epi16(u16, c128);
+        v16 = _mm_sub_epi16(v16, c128);
+        __m128i y8 = _mm_loadu_si128((const __m128i*)(y + i));
+        // duplicate each chroma sample for two pixels
+        yuvToRGBA8(_mm_unpacklo_epi8(y8, zero), _mm_unpacklo_epi16(u16, u16),
+            _mm_unpacklo_epi16(v16, v16), dst + 4*i);
+        yuvToRGBA8(_mm_unpackhi_epi8(y8, zero), _mm_unpackhi_epi16(u16, u16),
+            _mm_unpackhi_epi16(v16, v16), dst + 4*i + 32);
+    }
+    convertRowC(y + i, u + (i/2)*step, v + (i/2)*step, step, dst + 4*i, width - i);
+}
+
+#else
+
+static void convertRow(const uint8_t* y, const uint8_t* u, const uint8_t* v, int step,
+    uint8_t* dst, int width) {
+    convertRowC(y, u, v, step, dst, width);
+}
+
+#endif
+
+// NOTES: in 16.16 fixed point, the source position of each destination sample, centers aligned
+static void scalePositions(int src, int dst, std::vector<int>& index, std::vector<uint8_t>& frac) {
+    index.resize(dst);
+    frac.resize(dst);
+    for (int i = 0; i < dst; i++) {
+        int64_t pos = ((2*i + 1)*int64_t(src) << 16)/(2*dst) - 0x8000;
+        pos = std::max(pos, int64_t(0));
+        index[i] = std::min(int(pos >> 16), src - 1);
+        frac[i] = index[i] < src - 1 ? (pos >> 8) & 0xff : 0;
+    }
+}
+
+// NOTES: rows a and b blended by frac/256 of b, samples are read with step
+static void blendRows(const uint8_t* a, const uint8_t* b, int step, int frac, uint8_t* dst, int width) {
+    for (int i = 0; i < width; i++) {
+        dst[i] = (a[i*step]*(256 - frac) + b[i*step]*frac + 128) >> 8;
+    }
+}
+
+static void scaleRow(const uint8_t* src, const int* index, const uint8_t* frac, int srcWidth,
+    uint8_t* dst, int width) {
+    for (int i = 0; i < width; i++) {
+        int k = index[i];
+        int next = std::min(k + 1, srcWidth - 1);
+        dst[i] = (src[k]*(256 - frac[i]) + src[next]*frac[i] + 128) >> 8;
+    }
+}
+
+//
+// A plane scaled a row at a time, the source rows blended vertically are cached while
+// destination rows map to the same source position, e.g. chroma rows or when upscaling
+//
+struct PlaneScaler {
+    PlaneScaler(const uint8_t* data, int linesize, int step, int srcW, int srcH, int dstW, int dstH) :
+        data(data), linesize(linesize), step(step), srcW(srcW) {
+        scalePositions(srcW, dstW, xIndex, xFrac);
+        scalePositions(srcH, dstH, yIndex, yFrac);
+        blended.resize(srcW);
+        row.resize(dstW);
+    }
+
+    const uint8_t* scale(int j) {
+        if (yIndex[j] == lastIndex && yFrac[j] == lastFrac) {
+            return row.data();
+        }
+        lastIndex = yIndex[j];
+        lastFrac = yFrac[j];
+        const uint8_t* a = data + lastIndex*linesize;
+        blendRows(a, lastFrac ? a + linesize : a, step, lastFrac, blended.data(), srcW);
+        scaleRow(blended.data(), xIndex.data(), xFrac.data(), srcW, row.data(), int(row.size()));
+        return row.data();
+    }
+
+    const uint8_t* data;
+    int linesize;
+    int step;
+    int srcW;
+    std::vector<int> xIndex;
+    std::vector<uint8_t> xFrac;
+    std::vector<int> yIndex;
+    std::vector<uint8_t> yFrac;
+    std::vector<uint8_t> blended;
+    std::vector<uint8_t> row;
+    int lastIndex = -1;
+    int lastFrac = -1;
+};
+
+bool convertToRGBA(const AVFrame* frame, uint8_t* dst, int dst_stride, int x, int y, int w, int h) {
+    int step = 0;
+    switch (frame->format) {
+    case AV_PIX_FMT_YUV420P:
+        step = 1;
+        break;
+    case AV_PIX_FMT_NV12:
+        step = 2;
+        break;
+    default:
+        return false;
+    }
+    dst += y*dst_stride + x*4;
+    if (w == frame->width && h == frame->height) {
+        for (int j = 0; j < frame->height; j++) {
+            const uint8_t* py = frame->data[0] + j*frame->linesize[0];
+            const uint8_t* pu = frame->data[1] + (j/2)*frame->linesize[1];
+            const uint8_t* pv = step == 2 ? pu + 1 : frame->data[2] + (j/2)*frame->linesize[2];
+            convertRow(py, pu, pv, step, dst + j*dst_stride, frame->width);
+        }
+        return true;
+    }
+    // the scaled chroma rows are planar, half the width of the rect, each for a row of the rect
+    int cw = (frame->width + 1)/2;
+    int ch = (frame->height + 1)/2;
+    const uint8_t* v = step == 2 ? frame->data[1] + 1 : frame->data[2];
+    int vLinesize = step == 2 ? frame->linesize[1] : frame->linesize[2];
+    PlaneScaler luma(frame->data[0], frame->linesize[0], 1, frame->width, frame->height, w, h);
+    PlaneScaler cb(frame->data[1], frame->linesize[1], step, cw, ch, (w + 1)/2, h);
+    PlaneScaler cr(v, vLinesize, step, cw, ch, (w + 1)/2, h);
+    for (int j = 0; j < h; j++) {
+        convertRow(luma.scale(j), cb.scale(j), cr.scale(j), 1, dst + j*dst_stride, w);
+    }
+    return true;
+}
+
+void fillRGBABorders(uint8_t* dst, int dst_stride, int dst_w, int dst_h, int x, int y, int w, int h) {
+    for (int j = 0; j < dst_h; j++) {
+        uint8_t* row = dst + j*dst_stride;
+        if (j < y || j >= y + h) {
+            memset(row, 0, dst_w*4);
+            continue;
+        }
+        if (x > 0) {
+            memset(row, 0, x*4);
+        }
+        if (x + w < dst_w) {
+            memset(row + (x + w)*4, 0, (dst_w - x - w)*4);
+        }
+    }
+}
+
+void fillPlaneBorders(uint8_t* dst, int dst_stride, int dst_w, int dst_h, int x, int y, int w, int h, int value) {
+    for (int j = 0; j < dst_h; j++) {
+        uint8_t* row = dst + j*dst_stride;
+        if (j < y || j >= y + h) {
+            memset(row, value, dst_w);
+            continue;
+        }
+        if (x > 0) {
+            memset(row, value, x);
+        }
+        if (x + w < dst_w) {
+            memset(row + x + w, value, dst_w - x - w);
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+// NOTES: the smallest scale convertToRGBA() is used for, sws_scale() filters smaller pictures
+#define CONVERT_MIN_SCALE   0.5
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+//
+// Converts a YUV420P or NV12 frame (BT.601, limited range) into RGBA pixels, the picture is
+// scaled into the rect (x, y, w, h) of the destination buffer. The planes are scaled bilinearly,
+// a row at a time ahead of the color conversion, which is skipped if the rect has the frame size.
+// Bilinear scaling aliases below half the frame size, see CONVERT_MIN_SCALE.
+// Returns false if the frame format isn't supported.
+//
+bool convertToRGBA(const AVFrame* frame, uint8_t* dst, int dst_stride, int x, int y, int w, int h);
+
+//
+// Fills the area outside the rect (x, y, w, h) of a RGBA buffer with black, one memset per row.
+//
+void fillRGBABorders(uint8_t* dst, int dst_stride, int dst_w, int dst_h, int x, int y, int w, int h);
+
+//
+// Same as fillRGBABorders() for a plane of 8 bits samples, e.g. Y, U or V, filled with value.
+//
+void fillPlaneBorders(uint8_t* dst, int dst_stride, int dst_w, int dst_h, int x, int y, int w, int h, int value);
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "log.h"
 #include "ffwrapper.h"
 #include "demuxer.h"
@@ -5,7 +6,8 @@
 #undef  LOG_TAG 
 #define LOG_TAG "Demuxer"
 
-Demuxer::Demuxer() {   
+Demuxer::Demuxer() {
+    eventQueue.setNotifiers(&notifier);
 }
 
 Demuxer::~Demuxer() {    
@@ -15,6 +17,9 @@ void Demuxer::demuxing() {
     LOGD("demuxing: thread started");
     std::vector<AVPacket> pendingPackets;
     bool isEOS = false;
+    bool flushing = false;
+    // at the end of this source, and a next one is in the playlist
+    bool ending = false;
     for (;;) {
         // Handle events
         Event ev;
@@ -27,31 +32,100 @@ void Demuxer::demuxing() {
                 LOGD("demuxing: thread exited");
                 break;
             };
+            if (ev.id == EVENT_FLUSH_START) {
+                if (!pendingPackets.empty()) {
+                    ffWrapper->freePacket(pendingPackets.front());
+                    pendingPackets.clear();
+                }
+                // the engine is seeking, don't read until the flush stops. a seek after the end
+                // was reached stays in this source, the next one is switched to at its end again
+                flushing = true;
+                ending = false;
+                static_cast<Notifier*>(ev.data)->notify();
+                continue;
+            }
+            if (ev.id == EVENT_FLUSH_STOP) {
+                flushing = false;
+                isEOS = false;
+                static_cast<Notifier*>(ev.data)->notify();
+                continue;
+            }
+            if (ev.id == EVENT_SOURCE_SWITCHED) {
+                switchedFlags |= ev.value;
+                continue;
+            }
+            continue;
+        }
+
+        // Flushing
+        if (flushing) {
+            notifier.wait();
+            continue;
+        }
+
+        // Preroll the next source of the playlist while this one plays
+        updatePreroll();
+
+        // End of this source, the decoders switch to the next one instead of draining
+        if (ending) {
+            if (preroll.isDone() && !preroll.isReady()) {
+                LOGW("demuxing: skip %s, it can't be played", preroll.getUrl().c_str());
+                preroll.cancel();
+                continue;
+            }
+            if (hasNextSource() && !preroll.isDone()) {
+                // notified by the preroll, or by the renders still using the other engine
+                notifier.wait();
+                continue;
+            }
+            ending = false;
+            if (preroll.isReady()) {
+                switchSource();
+                isEOS = false;
+            } else {
+                videoSink->onEvent(Event(EVENT_EOS));
+                audioSink->onEvent(Event(EVENT_EOS));
+            }
             continue;
         }
 
         // End of stream
         if (isEOS) {
-            LOGD("demuxing: end of stream, will sleep 10ms");
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            LOGD("demuxing: end of stream, wait for events");
+            notifier.wait();
+            continue;
+        }
+
+        // The decoders take packets of the next source only once they drained the previous one
+        if (switching && (switchedFlags & SWITCHED_DECODERS) != SWITCHED_DECODERS) {
+            notifier.wait();
             continue;
         }
 
         // Read a packet from container, or use the pending packet
         AVPacket packet;
         if (!pendingPackets.empty()) {
-            if (states.getCurrent() == STATE_PAUSED) {
-                LOGD("demuxing: current state is STATE_PAUSED, will sleep 10ms");
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            }
             packet = pendingPackets.front();
             pendingPackets.clear();
         } else {
             if (!ffWrapper->readPacket(packet, &isEOS)) {
+                if (isEOS && hasNextSource()) {
+                    ending = true;
+                    continue;
+                }
                 videoSink->onEvent(Event(EVENT_EOS));
                 audioSink->onEvent(Event(EVENT_EOS));
                 continue;
             }
+            if (startupTimer) {
+                startupTimer->mark(STARTUP_FIRST_PACKET);
+            }
+            // index the keyframes seen on the way, for later seeks
+            int64_t ts = packet.pts != AV_NOPTS_VALUE ? packet.pts : packet.dts;
+            if (ffWrapper->isVideo(packet) && (packet.flags & AV_PKT_FLAG_KEY) &&
+                packet.pos >= 0 && ts != AV_NOPTS_VALUE) {
+                keyframeIndex.add(ts * ffWrapper->videoTimeBase() * AV_TIME_BASE, packet.pos);
+            }
         }
 
         // Push video/audio packets to corresponding sinks
@@ -59,15 +133,17 @@ void Demuxer::demuxing() {
             // got video packet
             Buffer buf(BUFFER_AVPACKET, &packet);
             if (videoSink->onBuffer(buf) == STATUS_FAILED) {
-                LOGW("demuxing: push buffer to video decoder failed");
+                LOGW("demuxing: push buffer to video decoder failed, wait for it to be consumed");
                 pendingPackets.push_back(packet);
+                notifier.wait();
             }
         } else if (ffWrapper->isAudio(packet)) {
             // got audio packet
             Buffer buf(BUFFER_AVPACKET, &packet);
             if (audioSink->onBuffer(buf) == STATUS_FAILED) {
-                LOGW("demuxing: push buffer to audio decoder failed");
+                LOGW("demuxing: push buffer to audio decoder failed, wait for it to be consumed");
                 pendingPackets.push_back(packet);
+                notifier.wait();
             }
         } else {
             ffWrapper->freePacket(packet);
@@ -81,7 +157,15 @@ int Demuxer::toNull() {
         LOGE("%s failed: current state is %s", __func__, cstr(current));
         return STATUS_FAILED;
     }
+    closeIndex();
+    // a switch may have been stopped halfway, the player sets the engine of all elements again
+    preroll.cancel();
+    if (nextWrapper) {
+        nextWrapper->close();
+    }
     ffWrapper->close();
+    switching = false;
+    switchedFlags = 0;
     states.setCurrent(STATE_NULL);
     return STATUS_SUCCESS;
 }
@@ -93,12 +177,21 @@ int Demuxer::toReady() {
         return STATUS_FAILED;
     }
     if (current == STATE_NULL) {
-        if (!ffWrapper->open(url.c_str())) {
+        int64_t start = monotonicTime();
+        bool opened = byteSource ? ffWrapper->open(byteSource, url.c_str()) : ffWrapper->open(url.c_str());
+        if (!opened) {
             LOGE("toReady failed: can't open %s", url.c_str());
             bus->sendMessage(Message(MESSAGE_ERROR_SOURCE, this));
             ffWrapper->close();
             return STATUS_FAILED;
         }
+        if (startupTimer) {
+            OpenStats stats = ffWrapper->openStats();
+            startupTimer->mark(STARTUP_OPENED, start + stats.openTime);
+            startupTimer->mark(STARTUP_PROBED, start + stats.openTime + stats.probeTime);
+            startupTimer->mark(STARTUP_CODECS_OPENED, start + stats.openTime + stats.probeTime + stats.codecTime);
+        }
+        openIndex();
         states.setCurrent(STATE_READY);
         return STATUS_SUCCESS;
     }
@@ -122,6 +215,7 @@ int Demuxer::toPaused() {
     }
     // current == STATE_PLAYING)
     states.setCurrent(STATE_PAUSED);
+    notifier.notify();
     return STATUS_SUCCESS;
 }
 
@@ -132,6 +226,7 @@ int Demuxer::toPlaying() {
         return STATUS_FAILED;
     }
     states.setCurrent(STATE_PLAYING);
+    notifier.notify();
     return STATUS_SUCCESS;
 }
 
@@ -160,6 +255,140 @@ int Demuxer::onEvent(const Event& event) {
 }
 
 
+bool Demuxer::seek(int position) {
+    int64_t timestamp = int64_t(position)*AV_TIME_BASE/1000;
+    KeyframeEntry entry;
+    if (useIndex() && keyframeIndex.find(timestamp, &entry) && ffWrapper->seekPosition(entry.position)) {
+        LOGD("seek: %dms from the keyframe at %lldms, byte %lld", position,
+            (long long)entry.timestamp*1000/AV_TIME_BASE, (long long)entry.position);
+        return true;
+    }
+    return ffWrapper->seek(timestamp);
+}
+
+int Demuxer::getKeyframePosition(int position) {
+    int64_t timestamp = int64_t(position)*AV_TIME_BASE/1000;
+    KeyframeEntry entry;
+    if (useIndex() && keyframeIndex.find(timestamp, &entry)) {
+        return entry.timestamp*1000/AV_TIME_BASE;
+    }
+    return ffWrapper->keyframeTime(timestamp)*1000/AV_TIME_BASE;
+}
+
+void Demuxer::openIndex() {
+    // the keyframes of a byte source are only known by its name, which may be reused
+    keyframeIndex.reset(byteSource ? 0 : KeyframeIndex::fileKey(url));
+    // NOTES: remote media isn't scanned, that would download all of it past the cache, its
+    //        index grows with the packets demuxed instead and lasts as long as the source
+    if (!savesIndex()) {
+        return;
+    }
+    if (keyframeIndex.load(indexPath()) && keyframeIndex.isComplete()) {
+        return;
+    }
+    if (indexScan) {
+        scanCancelled.store(false);
+        scanThread = std::thread([this] {
+            if (keyframeIndex.scan(url, scanCancelled)) {
+                keyframeIndex.save(indexPath());
+            }
+        });
+    }
+}
+
+void Demuxer::closeIndex() {
+    if (scanThread.joinable()) {
+        scanCancelled.store(true);
+        scanThread.join();
+    }
+    if (savesIndex()) {
+        keyframeIndex.save(indexPath());
+    }
+}
+
+bool Demuxer::savesIndex() {
+    return !indexDirectory.empty() && keyframeIndex.getKey() != 0;
+}
+
+std::string Demuxer::indexPath() {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.kfi", (unsigned long long)keyframeIndex.getKey());
+    return indexDirectory + name;
+}
+
+bool Demuxer::useIndex() {
+    // NOTES: the container index is preferred as long as it knows more keyframes
+    return ffWrapper->canSeekPosition() && keyframeIndex.size() > ffWrapper->videoIndexEntries();
+}
+
+void Demuxer::appendSource(const std::string& url) {
+    std::unique_lock<std::mutex> lock(m);
+    nextSources.push_back(url);
+    lock.unlock();
+    notifier.notify();
+}
+
+void Demuxer::clearSources() {
+    std::unique_lock<std::mutex> lock(m);
+    nextSources.clear();
+    sourcesCleared = true;
+    lock.unlock();
+    notifier.notify();
+}
+
+bool Demuxer::hasNextSource() {
+    if (!nextWrapper) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(m);
+    return preroll.isStarted() || !nextSources.empty();
+}
+
+void Demuxer::updatePreroll() {
+    if (!nextWrapper) {
+        return;
+    }
+    if (switching) {
+        if (switchedFlags != SWITCHED_ALL) {
+            return;
+        }
+        // no element uses the engine of the previous source anymore
+        preroll.reset();
+        nextWrapper->close();
+        switching = false;
+        LOGD("updatePreroll: all elements switched to %s", url.c_str());
+    }
+    std::unique_lock<std::mutex> lock(m);
+    if (sourcesCleared) {
+        sourcesCleared = false;
+        lock.unlock();
+        preroll.cancel();
+        lock.lock();
+    }
+    if (preroll.isStarted() || nextSources.empty()) {
+        return;
+    }
+    std::string next = nextSources.front();
+    nextSources.pop_front();
+    lock.unlock();
+    preroll.start(nextWrapper, next, &notifier);
+}
+
+void Demuxer::switchSource() {
+    // the sinks get the event after the last packets of this source
+    Event ev(EVENT_SWITCH_SOURCE, &preroll);
+    videoSink->onEvent(ev);
+    audioSink->onEvent(ev);
+    closeIndex();
+    std::swap(ffWrapper, nextWrapper);
+    url = preroll.getUrl();
+    byteSource = nullptr;
+    openIndex();
+    switching = true;
+    switchedFlags = 0;
+    LOGI("switchSource: %s", url.c_str());
+}
+
 int Demuxer::onBuffer(const Buffer& buffer) {
     LOGE("onBuffer failed: not supported");
     return STATUS_FAILED; 
@@ -2,9 +2,14 @@
 
 #include <string>
 #include <thread>
+#include <deque>
+#include <mutex>
 #include "element.h"
 #include "ffwrapper.h"
 #include "utils.h"
+#include "keyframe_index.h"
+#include "preroll.h"
+#include "startup_timer.h"
 
 class Demuxer: public Element {
 
@@ -30,14 +35,39 @@ public:
     
     int onEvent(const Event& event) override;
     int onBuffer(const Buffer& buffer) override;
+    Notifier* getNotifier() override {
+        return &notifier;
+    }
 
 public:
     void setEngine(FFWrapper* ffWrapper) {
         this->ffWrapper = ffWrapper;
     }
+    // NOTES: the engine the next source of the playlist is prerolled in, the two engines swap
+    //        roles at each switch, should be called in STATE_NULL
+    void setNextEngine(FFWrapper* nextWrapper) {
+        this->nextWrapper = nextWrapper;
+    }
+    // NOTES: the engine of the source being read
+    FFWrapper* getEngine() {
+        return ffWrapper;
+    }
     void setSource(const std::string url) {
         this->url = url;
+        byteSource = nullptr;
     }
+    // NOTES: source must outlive STATE_NULL, name keys the stream parameters cached by a fast start.
+    //        keyframe indexes of byte sources aren't saved
+    void setSource(ByteSource* source, const std::string& name) {
+        url = name;
+        byteSource = source;
+    }
+    // NOTES: can be called in any state, the sources are played after the current one without
+    //        a gap, each is prerolled while the one before it plays. sources appended after the
+    //        end of the last one was reached are not played
+    void appendSource(const std::string& url);
+    // NOTES: drops the appended sources which aren't switched to yet
+    void clearSources();
     void setAudioSink(Element* audioSink) {
         this->audioSink = audioSink;
     }
@@ -47,9 +77,20 @@ public:
     int getDuration() {
         return ffWrapper->duration()*1000/AV_TIME_BASE;
     }
-    void seek(int position) {
-        ffWrapper->seek(int64_t(position)*AV_TIME_BASE/1000);
+    // NOTES: keyframe indexes of local files are saved in directory, and built by a background
+    //        scan of the whole file if scan is true. should be called in STATE_NULL
+    void setIndexDirectory(const std::string& directory, bool scan = true) {
+        indexDirectory = directory;
+        indexScan = scan;
+    }
+    // NOTES: marks the open, probe, codec init and first packet phases
+    void setStartupTimer(StartupTimer* startupTimer) {
+        this->startupTimer = startupTimer;
     }
+    // NOTES: in milliseconds
+    bool seek(int position);
+    // NOTES: in milliseconds, where playback resumes after seek(position)
+    int getKeyframePosition(int position);
 
 private:
     int toNull();
@@ -57,17 +98,44 @@ private:
     int toPaused();
     int toPlaying();
     void demuxing();
+    void openIndex();
+    void closeIndex();
+    // NOTES: the index is of a local file, and there is a directory to keep it
+    bool savesIndex();
+    std::string indexPath();
+    bool useIndex();
+    bool hasNextSource();
+    void updatePreroll();
+    void switchSource();
 
 private:
 
     Clock* clock = nullptr;
     Bus* bus = nullptr;
     FFWrapper* ffWrapper = nullptr;
+    StartupTimer* startupTimer = nullptr;
     Element* audioSink = nullptr;
     Element* videoSink = nullptr;
     std::string url;
+    ByteSource* byteSource = nullptr;
     States states;
     std::thread demuxingThread;
     Queue<Event> eventQueue;
+    Notifier notifier;
+    KeyframeIndex keyframeIndex;
+    std::string indexDirectory;
+    bool indexScan = true;
+    std::thread scanThread;
+    std::atomic<bool> scanCancelled{false};
+    // the playlist, nextSources and sourcesCleared are guarded by m
+    std::mutex m;
+    std::deque<std::string> nextSources;
+    bool sourcesCleared = false;
+    FFWrapper* nextWrapper = nullptr;
+    Preroll preroll;
+    // the elements are switching to the source of preroll, see EVENT_SWITCH_SOURCE
+    bool switching = false;
+    // SWITCHED_XXX of the elements which switched
+    int switchedFlags = 0;
 
 };
\ No newline at end of file
@@ -3,9 +3,15 @@
 #include "state.h"
 #include "clock.h"
 #include "bus.h"
+#include "utils.h"
 
 #define EVENT_STOP_THREAD   0x01
 #define EVENT_EOS           0x02
+#define EVENT_QOS           0x03    // sent upstream by renders, value is the lateness in microseconds
+#define EVENT_FLUSH_START   0x04    // drop all buffered data and hold the data flow, value is when the seek was requested
+#define EVENT_FLUSH_STOP    0x05    // resume the data flow, value is the seek target in microseconds, negative for none
+#define EVENT_SWITCH_SOURCE 0x06    // sent downstream after the last data of a source, data is the Preroll of the next one
+#define EVENT_SOURCE_SWITCHED 0x07  // sent upstream once an element uses the next source, value is its SWITCHED_XXX flag
 
 #define BUFFER_AVPACKET     0x01
 #define BUFFER_AVFRAME      0x02
@@ -13,12 +19,19 @@
 #define STATUS_FAILED       -1
 #define STATUS_SUCCESS      0
 
+//
+//  NOTES: the data of EVENT_FLUSH_START/EVENT_FLUSH_STOP is a Notifier, it is notified once the
+//         element's thread has handled the event
+//  NOTES: an element which got EVENT_SWITCH_SOURCE switches once it has passed on all data of the
+//         current source, or at once on EVENT_FLUSH_START, see preroll.h
+//
 struct Event {
     Event(int id, void* data) : id(id), data(data) {}
     Event(int id) : id(id) {}
     Event() {}
     int id = -1;
     void* data = nullptr;
+    int64_t value = 0;
 };
 
 struct Buffer {
@@ -48,5 +61,11 @@ struct Element {
     
     virtual int onEvent(const Event& event) = 0;
     virtual int onBuffer(const Buffer& buffer) = 0;
+
+    //
+    //  The notifier which wakes up the element's thread, upstream elements
+    //  get notified through it when their pushed buffers are consumed
+    //
+    virtual Notifier* getNotifier() = 0;
 };
 
@@ -1,9 +1,21 @@
+#include <string.h>
+#include <thread>
+#include <algorithm>
 #include "log.h"
+#include "clock.h"
 #include "ffwrapper.h"
+#include "stream_cache.h"
 
 #undef  LOG_TAG 
 #define LOG_TAG "FFWrapper"
 
+// NOTES: in bytes and microseconds, enough for the headers of common containers and the
+//        first frames of their streams
+#define FAST_START_PROBESIZE        (128*1024)
+#define FAST_START_ANALYZE_DURATION 500000
+// same as libavformat's
+#define DEFAULT_PROBESIZE           5000000
+
 //
 // class utils
 //
@@ -13,7 +25,7 @@ void FFWrapper::freePacket(AVPacket& packet) {
 }
 
 void FFWrapper::freeFrame(AVFrame* frame) {
-    av_frame_free(&frame);
+    FramePool::instance().free(frame);
     LOGD("freeFrame ok");
 }
 
@@ -82,6 +94,50 @@ void FFWrapper::resampleAudio(SwrContext* audioResampleContext, const AVFrame* f
 }
 
 
+//
+// Video decoding threads policy
+//
+static int autoVideoThreadCount(const AVCodecContext* codecContext) {
+    int cores = std::thread::hardware_concurrency();
+    if (cores <= 0) {
+        cores = 1;
+    }
+    // more threads than rows of macroblocks or frames in flight don't help small videos
+    int64_t pixels = int64_t(codecContext->width)*codecContext->height;
+    int count = cores;
+    if (pixels <= 720*576) {
+        count = std::min(cores, 2);
+    } else if (pixels <= 1920*1080) {
+        count = std::min(cores, 4);
+    }
+    return std::min(count, 16);
+}
+
+static int autoVideoThreadType(const AVCodec* codec) {
+    int type = 0;
+    if (codec->capabilities & AV_CODEC_CAP_FRAME_THREADS) {
+        type |= FF_THREAD_FRAME;
+    }
+    if (codec->capabilities & AV_CODEC_CAP_SLICE_THREADS) {
+        type |= FF_THREAD_SLICE;
+    }
+    switch (codec->id) {
+    case AV_CODEC_ID_H264:
+    case AV_CODEC_ID_HEVC:
+    case AV_CODEC_ID_VP9:
+        // frame threading scales best, slices are rarely used in these streams
+        break;
+    default:
+        // frame threading adds one frame of latency per thread for little gain
+        if (type & FF_THREAD_SLICE) {
+            type = FF_THREAD_SLICE;
+        }
+        break;
+    }
+    return type;
+}
+
+
 //
 // FFWrapper implementation
 //
@@ -97,9 +153,7 @@ FFWrapper::FFWrapper() {
 FFWrapper::~FFWrapper() {
     av_frame_free(&videoFrame);
     av_frame_free(&audioFrame);
-    if (videoScaleContext) {
-        sws_freeContext(videoScaleContext);
-    }
+    videoScalers.clear();
     if (audioResampleContext) {
         swr_free(&audioResampleContext);
     }
@@ -112,7 +166,9 @@ bool FFWrapper::readPacket(AVPacket& packet, bool* isEOF) {
     av_init_packet(&packet);
     packet.data = nullptr;
     packet.size = 0;
+    int64_t start = monotonicTime();
     int ret = av_read_frame(formatContext, &packet);
+    packetStats.readTime += monotonicTime() - start;
     if (ret < 0) {
         if (ret == AVERROR_EOF) {
             LOGE("av_read_frame failed: end of file");
@@ -124,25 +180,47 @@ bool FFWrapper::readPacket(AVPacket& packet, bool* isEOF) {
         }
         return false;
     }
+    packetStats.packets++;
     LOGD("readPacket ok");
     return true;
 }
 
-bool FFWrapper::decodeVideo(const AVPacket& packet, AVFrame** outframe, int* decoded) {
-    int got_frame = 0;
-    int ret = avcodec_decode_video2(videoCodecContext, videoFrame, &got_frame, &packet);
-    if (ret < 0) {
-        LOGE("avcodec_decode_video2 failed: %d", ret);
-        return false; 
+bool FFWrapper::sendPacket(AVCodecContext* codecContext, const AVPacket* packet) {
+    int ret = avcodec_send_packet(codecContext, packet);
+    if (ret < 0 && ret != AVERROR_EOF) {
+        // NOTES: AVERROR(EAGAIN) means the caller hasn't drained all frames before sending
+        LOGE("avcodec_send_packet failed: %d", ret);
+        return false;
     }
+    return true;
+}
 
-    if (decoded) {
-        *decoded = ret;
+bool FFWrapper::receiveFrame(AVCodecContext* codecContext, AVFrame* frame, bool* isEOF) {
+    int ret = avcodec_receive_frame(codecContext, frame);
+    if (ret < 0) {
+        if (ret == AVERROR_EOF) {
+            LOGD("avcodec_receive_frame: end of stream");
+            if (isEOF) {
+                *isEOF = true;
+            }
+        } else if (ret != AVERROR(EAGAIN)) {
+            LOGE("avcodec_receive_frame failed: %d", ret);
+        }
+        return false;
+    }
+    if (frame->pts == AV_NOPTS_VALUE) {
+        frame->pts = frame->best_effort_timestamp;
     }
+    return true;
+}
 
-    if (!got_frame) {
-        LOGE("avcodec_decode_video2 can't got frame");
-        return false; 
+bool FFWrapper::sendVideoPacket(const AVPacket* packet) {
+    return sendPacket(videoCodecContext, packet);
+}
+
+bool FFWrapper::receiveVideoFrame(AVFrame** outframe, bool* isEOF) {
+    if (!receiveFrame(videoCodecContext, videoFrame, isEOF)) {
+        return false;
     }
 
     LOGD("got video frame: pix_fmt=%s, video_size=%dx%d, pts=%.6g", 
@@ -150,57 +228,76 @@ bool FFWrapper::decodeVideo(const AVPacket& packet, AVFrame** outframe, int* dec
         av_q2d(formatContext->streams[videoIndex]->time_base)*videoFrame->pts);
 
     if (outframe) {
-        // create a new frame that references the same data as videoFrame.
-        // shortcut for av_frame_alloc()+av_frame_ref(). 
-        *outframe = av_frame_clone(videoFrame);
+        // hand over the decoded data to a new frame, videoFrame is reset for next receiving
+        *outframe = FramePool::instance().alloc();
+        if (!*outframe) {
+            av_frame_unref(videoFrame);
+            return false;
+        }
+        av_frame_move_ref(*outframe, videoFrame);
+    } else {
+        av_frame_unref(videoFrame);
     }
     return true;
 }
 
+void FFWrapper::flushVideoDecoder() {
+    avcodec_flush_buffers(videoCodecContext);
+}
 
-
-bool FFWrapper::setVideoScale(const AVFrame* frame, int dst_w, int dst_h, AVPixelFormat dst_pix_fmt) {
-    if (videoScaleContext) {
-        LOGW("videoScaleContext is not nullptr, free it first");
-        sws_freeContext(videoScaleContext);
+void FFWrapper::setVideoSkipLevel(int level) {
+    videoCodecContext->skip_loop_filter = AVDISCARD_DEFAULT;
+    videoCodecContext->skip_frame = AVDISCARD_DEFAULT;
+    if (level >= SKIP_LEVEL_NONREF_FILTER) {
+        videoCodecContext->skip_loop_filter = AVDISCARD_NONREF;
+    }
+    if (level >= SKIP_LEVEL_FILTER) {
+        videoCodecContext->skip_loop_filter = AVDISCARD_ALL;
+    }
+    if (level >= SKIP_LEVEL_NONREF_FRAMES) {
+        videoCodecContext->skip_frame = AVDISCARD_NONREF;
     }
-    videoScaleContext = sws_getContext(
-        frame->width, frame->height, (AVPixelFormat)frame->format, 
-        dst_w, dst_h, dst_pix_fmt,
-        SWS_BILINEAR, nullptr, nullptr, nullptr);
-    if (!videoScaleContext) {
-        LOGE("sws_getContext failed: src_size=%dx%d, src_fmt=%s, dst_size=%dx%d, dst_fmt=%s",         
-            frame->width, frame->height, av_get_pix_fmt_name((AVPixelFormat)frame->format), 
-            dst_w, dst_h, av_get_pix_fmt_name((AVPixelFormat)dst_pix_fmt));
-        return false;
-    }  
-    LOGD("sws_getContext succeed: src_size=%dx%d, src_fmt=%s, dst_size=%dx%d, dst_fmt=%s",         
-        frame->width, frame->height, av_get_pix_fmt_name((AVPixelFormat)frame->format), 
-        dst_w, dst_h, av_get_pix_fmt_name((AVPixelFormat)dst_pix_fmt)); 
-    return true;  
 }
 
-void FFWrapper::scaleVideo(const AVFrame* frame, uint8_t** dst_data, int* dst_linesize) {
-    sws_scale(videoScaleContext, (const uint8_t* const*)frame->data, 
-        frame->linesize, 0, frame->height, dst_data, dst_linesize);
+void FFWrapper::setVideoKeyframesOnly(bool keyframesOnly) {
+    videoCodecContext->skip_frame = keyframesOnly ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
 }
 
+bool FFWrapper::setVideoScale(const AVFrame* frame, int dst_w, int dst_h, AVPixelFormat dst_pix_fmt) {
+    // NOTES: large frames are scaled as slices in parallel
+    videoScaler = videoScalers.get(frame->width, frame->height, (AVPixelFormat)frame->format,
+        dst_w, dst_h, dst_pix_fmt, videoScaleFlags);
+    return videoScaler != nullptr;
+}
 
-bool FFWrapper::decodeAudio(const AVPacket& packet, AVFrame** outframe, int* decoded) {
-    int got_frame = 0;
-    int ret = avcodec_decode_audio4(audioCodecContext, audioFrame, &got_frame, &packet);
-    if (ret < 0) {
-        LOGE("avcodec_decode_audio4 failed: %d", ret);
-        return false;
+void FFWrapper::setVideoScaleQuality(int quality) {
+    switch (quality) {
+    case SCALE_QUALITY_FAST:
+        videoScaleFlags = SWS_FAST_BILINEAR;
+        break;
+    case SCALE_QUALITY_HIGH:
+        videoScaleFlags = SWS_BICUBIC;
+        break;
+    default:
+        videoScaleFlags = SWS_BILINEAR;
+        break;
     }
+}
 
-    if (decoded) {
-        *decoded = ret > packet.size ? packet.size : ret;
+void FFWrapper::scaleVideo(const AVFrame* frame, uint8_t** dst_data, int* dst_linesize) {
+    if (videoScaler) {
+        videoScaler->scale(frame, dst_data, dst_linesize);
     }
+}
 
-    if (!got_frame) {
-        LOGE("avcodec_decode_audio4 can't got frame");
-        return false; 
+
+bool FFWrapper::sendAudioPacket(const AVPacket* packet) {
+    return sendPacket(audioCodecContext, packet);
+}
+
+bool FFWrapper::receiveAudioFrame(AVFrame** outframe, bool* isEOF) {
+    if (!receiveFrame(audioCodecContext, audioFrame, isEOF)) {
+        return false;
     }
 
     LOGD("got audio frame: channels=%d, nb_samples=%d, pts=%.6g", 
@@ -208,12 +305,22 @@ bool FFWrapper::decodeAudio(const AVPacket& packet, AVFrame** outframe, int* dec
          av_q2d(formatContext->streams[audioIndex]->time_base)*audioFrame->pts);
 
     if (outframe) {
-        // shortcut for av_frame_alloc()+av_frame_ref()
-        *outframe = av_frame_clone(audioFrame);
+        // hand over the decoded data to a new frame, audioFrame is reset for next receiving
+        *outframe = FramePool::instance().alloc();
+        if (!*outframe) {
+            av_frame_unref(audioFrame);
+            return false;
+        }
+        av_frame_move_ref(*outframe, audioFrame);
+    } else {
+        av_frame_unref(audioFrame);
     }
     return true;
 }
 
+void FFWrapper::flushAudioDecoder() {
+    avcodec_flush_buffers(audioCodecContext);
+}
 
 bool FFWrapper::setAudioResample(const AVFrame* frame, int64_t dst_ch_layout, 
                       int dst_rate, AVSampleFormat dst_sample_fmt) {
@@ -244,107 +351,120 @@ bool FFWrapper::setAudioResample(const AVFrame* frame, int64_t dst_ch_layout,
     return true;                     
 }
 
-void FFWrapper::resampleAudio(const AVFrame* frame, uint8_t** dst_data, int dst_samples) {
-    swr_convert(audioResampleContext, 
+int FFWrapper::resampleAudio(const AVFrame* frame, uint8_t** dst_data, int dst_samples) {
+    int samples = swr_convert(audioResampleContext, 
         dst_data, dst_samples, 
         (const uint8_t**)frame->extended_data, frame->nb_samples);
+    return std::max(samples, 0);
 }
 
 bool FFWrapper::open(const char* url) {
-    // open input file, and allocate format context
-    if (avformat_open_input(&formatContext, url, nullptr, nullptr) < 0) {
-        LOGE("avformat_open_input(url=%s) failed", url);
-        return false;
+    // local files are read by our own input, the url is only a hint for probing the format then
+    if (inputConfig.mode != INPUT_MODE_DEFAULT) {
+        fileInput = new FileInput(inputConfig);
+        if (!fileInput->open(url)) {
+            delete fileInput;
+            fileInput = nullptr;
+        }
     }
-
-    // retrieve stream information
-    if (avformat_find_stream_info(formatContext, nullptr) < 0) {
-        LOGE("avformat_find_stream_info failed");
-        return false;
+    // remote media is read through the cache on disk, so it's downloaded once
+    bool remote = strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0;
+    if (remote && chunkCache && chunkCache->isOpen()) {
+        urlSource = new UrlSource(url);
+        cachedSource = new CachedSource(chunkCache, url, urlSource);
+        if (!cachedSource->open()) {
+            delete cachedSource;
+            cachedSource = nullptr;
+            delete urlSource;
+            urlSource = nullptr;
+        }
     }
+    ByteSource* source = fileInput ? static_cast<ByteSource*>(fileInput) : cachedSource;
+    return openInput(url, source, StreamCache::key(url));
+}
 
-    // find video/audio stream
-    videoIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
-    audioIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
-    if (videoIndex < 0 || audioIndex < 0) {
-        LOGE("av_find_best_stream failed: videoIndex=%d, audioIndex=%d", 
-            videoIndex, audioIndex);
-        return false;
-    }
+bool FFWrapper::open(ByteSource* source, const char* name) {
+    // the stream parameters of a source are only known again by its name
+    return openInput(name, source, name);
+}
 
-    if (videoIndex >= 0) {
-        // find decoder for video stream
-        AVCodec* videoDecoder = avcodec_find_decoder(formatContext->streams[videoIndex]->codecpar->codec_id);
-        if (!videoDecoder) {
-            LOGE("avcodec_find_decoder(videoIndex=%d) failed", videoIndex);
+bool FFWrapper::openInput(const char* url, ByteSource* source, const std::string& cacheKey) {
+    lastOpenStats = OpenStats();
+    packetStats = ReadStats();
+    int64_t start = monotonicTime();
+    if (source) {
+        ioContext = ByteSource::openContext(source, inputConfig.ioBufferSize);
+        formatContext = ioContext ? avformat_alloc_context() : nullptr;
+        if (!formatContext) {
+            LOGE("openInput: can't read from the source of %s", url);
             return false;
         }
+        formatContext->pb = ioContext;
+    }
+    // open input file, and allocate format context
+    AVDictionary* formatOpts = nullptr;
+    if (fastStart) {
+        av_dict_set_int(&formatOpts, "probesize", FAST_START_PROBESIZE, 0);
+        av_dict_set_int(&formatOpts, "analyzeduration", FAST_START_ANALYZE_DURATION, 0);
+    }
+    int ret = avformat_open_input(&formatContext, url, nullptr, &formatOpts);
+    av_dict_free(&formatOpts);
+    if (ret < 0) {
+        LOGE("avformat_open_input(url=%s) failed", url);
+        return false;
+    }
+    int64_t opened = monotonicTime();
+    lastOpenStats.openTime = opened - start;
 
-        // allocate a codec context for the decoder
-        videoCodecContext = avcodec_alloc_context3(videoDecoder);
-        if (!videoCodecContext) {
-            LOGE("avcodec_alloc_context3(videoDecoder=%p) failed", videoDecoder);
-            return false; 
-        }
-
-        // copy codec parameters from input stream to output codec context
-        if (avcodec_parameters_to_context(videoCodecContext, formatContext->streams[videoIndex]->codecpar) < 0) {
-            LOGE("avcodec_parameters_to_context(videoIndex=%d) failed", videoIndex);
-            return false;
+    // retrieve stream information, and find video/audio stream
+    if (!probeStreams(url, cacheKey)) {
+        return false;
+    }
+    if (!audioEnabled) {
+        for (unsigned int i = 0; i < formatContext->nb_streams; i++) {
+            if (int(i) != videoIndex) {
+                formatContext->streams[i]->discard = AVDISCARD_ALL;
+            }
         }
-
-        // Init the decoders with reference counting
-        AVDictionary* opts = nullptr;
-        av_dict_set(&opts, "refcounted_frames", "1", 0);
-        if (avcodec_open2(videoCodecContext, videoDecoder, &opts) < 0) {
-            LOGE("avcodec_open2(videoIndex=%d) failed", videoIndex);
-            return false;
-         }
     }
+    int64_t probed = monotonicTime();
+    lastOpenStats.probeTime = probed - opened;
 
+    // the audio decoder opens while the video decoder starts its threads
+    bool audioOpened = audioIndex < 0;
+    std::thread audioOpening;
     if (audioIndex >= 0) {
-        // find decoder for audio stream
-        AVCodec* audioDecoder = avcodec_find_decoder(formatContext->streams[audioIndex]->codecpar->codec_id);
-        if (!audioDecoder) {
-            LOGE("avcodec_find_decoder(audioIndex=%d) failed", audioIndex);
-            return false;
-        }
-
-        // allocate a codec context for the decoder
-        audioCodecContext = avcodec_alloc_context3(audioDecoder);
-        if (!audioCodecContext) {
-            LOGE("avcodec_alloc_context3(audioDecoder=%p) failed", audioDecoder);
-            return false; 
-        }
-
-        // copy codec parameters from input stream to output codec context
-        if (avcodec_parameters_to_context(audioCodecContext, formatContext->streams[audioIndex]->codecpar) < 0) {
-            LOGE("avcodec_parameters_to_context(audioIndex=%d) failed", audioIndex);
-            return false;
+        if (fastStart) {
+            audioOpening = std::thread([this, &audioOpened] { audioOpened = openAudioDecoder(); });
+        } else {
+            audioOpened = openAudioDecoder();
         }
-
-        // Init the decoders with reference counting
-        AVDictionary* opts = nullptr;
-        av_dict_set(&opts, "refcounted_frames", "1", 0);
-        if (avcodec_open2(audioCodecContext, audioDecoder, &opts) < 0) {
-            LOGE("avcodec_open2(audioIndex=%d) failed", audioIndex);
-            return false;
-         }
     }
+    bool videoOpened = videoIndex < 0 || openVideoDecoder();
+    if (audioOpening.joinable()) {
+        audioOpening.join();
+    }
+    if (!videoOpened || !audioOpened) {
+        return false;
+    }
+    lastOpenStats.codecTime = monotonicTime() - probed;
 
     // dump status    
-    LOGI("open %s succeed. start_time=%.6g, duration=%.6g", 
-        url, double(formatContext->start_time)/AV_TIME_BASE, double(formatContext->duration)/AV_TIME_BASE);
+    LOGI("open %s succeed. start_time=%.6g, duration=%.6g, open=%lldms, probe=%lldms%s, codec_init=%lldms", 
+        url, double(formatContext->start_time)/AV_TIME_BASE, double(formatContext->duration)/AV_TIME_BASE,
+        (long long)lastOpenStats.openTime/1000, (long long)lastOpenStats.probeTime/1000,
+        lastOpenStats.cached ? " (cached)" : "", (long long)lastOpenStats.codecTime/1000);
 
     if (videoCodecContext) {
-        LOGI("video_index=%d, pix_fmt=%s, video_size=%dx%d, start_time=%.6g, duration=%.6g, frames=%llu, fps=%.6g, refcounted=%d",
+        LOGI("video_index=%d, pix_fmt=%s, video_size=%dx%d, start_time=%.6g, duration=%.6g, frames=%llu, fps=%.6g, refcounted=%d, threads=%d, thread_type=%d, lowres=%d",
             videoIndex, av_get_pix_fmt_name(videoCodecContext->pix_fmt),
             videoCodecContext->width, videoCodecContext->height,
             av_q2d(formatContext->streams[videoIndex]->time_base)*formatContext->streams[videoIndex]->start_time,
             av_q2d(formatContext->streams[videoIndex]->time_base)*formatContext->streams[videoIndex]->duration,
             formatContext->streams[videoIndex]->nb_frames,
             av_q2d(formatContext->streams[videoIndex]->avg_frame_rate),
-            videoCodecContext->refcounted_frames);
+            videoCodecContext->refcounted_frames,
+            videoCodecContext->thread_count, videoCodecContext->active_thread_type, videoCodecContext->lowres);
     }
     if (audioCodecContext) {
         LOGI("audio_index=%d, sample_fmt=%s, is_planar=%d, channels=%d, sample_rate=%d, start_time=%.6g, duration=%.6g, refcounted=%d",
@@ -358,8 +478,149 @@ bool FFWrapper::open(const char* url) {
     return true;
 }
 
+bool FFWrapper::probeStreams(const char* url, const std::string& key) {
+    if (fastStart && !key.empty() && StreamCache::instance().apply(key, formatContext, &videoIndex, &audioIndex)) {
+        if (videoIndex >= 0 && (audioIndex >= 0 || !audioEnabled)) {
+            audioIndex = audioEnabled ? audioIndex : -1;
+            lastOpenStats.cached = true;
+            return true;
+        }
+        // known from a session without audio
+        videoIndex = -1;
+        audioIndex = -1;
+    }
+
+    if (avformat_find_stream_info(formatContext, nullptr) < 0) {
+        LOGE("avformat_find_stream_info failed");
+        return false;
+    }
+    if (fastStart && !streamsComplete()) {
+        // the data probed wasn't enough to know the streams, probe on with the default limits
+        LOGW("probeStreams: %s needs more than %d bytes to be probed", url, FAST_START_PROBESIZE);
+        formatContext->probesize = DEFAULT_PROBESIZE;
+        formatContext->max_analyze_duration = 0;
+        if (avformat_find_stream_info(formatContext, nullptr) < 0) {
+            LOGE("avformat_find_stream_info failed");
+            return false;
+        }
+    }
+    videoIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    audioIndex = audioEnabled ? av_find_best_stream(formatContext, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0) : -1;
+    if (videoIndex < 0 || (audioEnabled && audioIndex < 0)) {
+        LOGE("av_find_best_stream failed: videoIndex=%d, audioIndex=%d", 
+            videoIndex, audioIndex);
+        return false;
+    }
+    if (!key.empty()) {
+        StreamCache::instance().put(key, formatContext, videoIndex, audioIndex);
+    }
+    return true;
+}
+
+bool FFWrapper::streamsComplete() {
+    int video = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    int audio = audioEnabled ? av_find_best_stream(formatContext, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0) : -1;
+    if (video < 0 || (audioEnabled && audio < 0)) {
+        return false;
+    }
+    AVCodecParameters* v = formatContext->streams[video]->codecpar;
+    if (v->width <= 0 || v->height <= 0 || v->format < 0) {
+        return false;
+    }
+    AVCodecParameters* a = audio >= 0 ? formatContext->streams[audio]->codecpar : nullptr;
+    return !a || (a->sample_rate > 0 && a->channels > 0 && a->format >= 0);
+}
+
+bool FFWrapper::openVideoDecoder() {
+    // find decoder for video stream
+    AVCodec* videoDecoder = avcodec_find_decoder(formatContext->streams[videoIndex]->codecpar->codec_id);
+    if (!videoDecoder) {
+        LOGE("avcodec_find_decoder(videoIndex=%d) failed", videoIndex);
+        return false;
+    }
+
+    // allocate a codec context for the decoder
+    videoCodecContext = avcodec_alloc_context3(videoDecoder);
+    if (!videoCodecContext) {
+        LOGE("avcodec_alloc_context3(videoDecoder=%p) failed", videoDecoder);
+        return false; 
+    }
+
+    // copy codec parameters from input stream to output codec context
+    if (avcodec_parameters_to_context(videoCodecContext, formatContext->streams[videoIndex]->codecpar) < 0) {
+        LOGE("avcodec_parameters_to_context(videoIndex=%d) failed", videoIndex);
+        return false;
+    }
+
+    // decode with multiple threads, delayed frames are handled by the send/receive api
+    videoCodecContext->thread_count = videoThreadCount > 0 ? videoThreadCount : autoVideoThreadCount(videoCodecContext);
+    videoCodecContext->thread_type = videoThreadType > 0 ? videoThreadType : autoVideoThreadType(videoDecoder);
+
+    // decode at a reduced size if it's enough and the decoder can
+    if (videoDecodeWidth > 0 && videoDecodeHeight > 0) {
+        int lowres = 0;
+        while (lowres < videoDecoder->max_lowres &&
+            (videoCodecContext->width >> (lowres + 1)) >= videoDecodeWidth &&
+            (videoCodecContext->height >> (lowres + 1)) >= videoDecodeHeight) {
+            lowres++;
+        }
+        videoCodecContext->lowres = lowres;
+    }
+
+    // decode into recycled buffers
+    videoBuffers.attach(videoCodecContext);
+
+    // Init the decoders with reference counting
+    AVDictionary* opts = nullptr;
+    av_dict_set(&opts, "refcounted_frames", "1", 0);
+    int ret = avcodec_open2(videoCodecContext, videoDecoder, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        LOGE("avcodec_open2(videoIndex=%d) failed", videoIndex);
+        return false;
+    }
+    return true;
+}
+
+bool FFWrapper::openAudioDecoder() {
+    // find decoder for audio stream
+    AVCodec* audioDecoder = avcodec_find_decoder(formatContext->streams[audioIndex]->codecpar->codec_id);
+    if (!audioDecoder) {
+        LOGE("avcodec_find_decoder(audioIndex=%d) failed", audioIndex);
+        return false;
+    }
+
+    // allocate a codec context for the decoder
+    audioCodecContext = avcodec_alloc_context3(audioDecoder);
+    if (!audioCodecContext) {
+        LOGE("avcodec_alloc_context3(audioDecoder=%p) failed", audioDecoder);
+        return false; 
+    }
+
+    // copy codec parameters from input stream to output codec context
+    if (avcodec_parameters_to_context(audioCodecContext, formatContext->streams[audioIndex]->codecpar) < 0) {
+        LOGE("avcodec_parameters_to_context(audioIndex=%d) failed", audioIndex);
+        return false;
+    }
+
+    // Init the decoders with reference counting
+    AVDictionary* opts = nullptr;
+    av_dict_set(&opts, "refcounted_frames", "1", 0);
+    int ret = avcodec_open2(audioCodecContext, audioDecoder, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        LOGE("avcodec_open2(audioIndex=%d) failed", audioIndex);
+        return false;
+    }
+    return true;
+}
+
 void FFWrapper::close() {
     if (videoCodecContext) {
+        PoolStats frames = framePoolStats();
+        PoolStats buffers = videoBufferPoolStats();
+        LOGI("close: frame pool hits=%lld, misses=%lld, video buffer pool hits=%lld, misses=%lld",
+            (long long)frames.hits, (long long)frames.misses, (long long)buffers.hits, (long long)buffers.misses);
         avcodec_free_context(&videoCodecContext);
         videoCodecContext = nullptr;
         videoIndex = -1;
@@ -373,6 +634,24 @@ void FFWrapper::close() {
         avformat_close_input(&formatContext);
         formatContext = nullptr;
     }
+    if (packetStats.packets > 0) {
+        LOGI("close: %lld packets read in %lldms, %.0f packets/s", (long long)packetStats.packets,
+            (long long)packetStats.readTime/1000,
+            packetStats.readTime > 0 ? packetStats.packets*1000000.0/packetStats.readTime : 0.0);
+        packetStats = ReadStats();
+    }
+    // NOTES: after the format context, which doesn't free a custom AVIOContext
+    ByteSource::closeContext(&ioContext);
+    if (fileInput) {
+        delete fileInput;
+        fileInput = nullptr;
+    }
+    if (cachedSource) {
+        delete cachedSource;
+        cachedSource = nullptr;
+        delete urlSource;
+        urlSource = nullptr;
+    }
 }
 
 bool FFWrapper::seek(int64_t timestamp) {
@@ -384,5 +663,26 @@ bool FFWrapper::seek(int64_t timestamp) {
     return true;
 }
 
+bool FFWrapper::seekPosition(int64_t position) {
+    if (av_seek_frame(formatContext, -1, position, AVSEEK_FLAG_BYTE) < 0) {
+        LOGE("av_seek_frame(position=%lld) failed", (long long)position);
+        return false;
+    }
+    return true;
+}
+
+int64_t FFWrapper::keyframeTime(int64_t timestamp) {
+    if (videoIndex < 0) {
+        return timestamp;
+    }
+    AVStream* stream = formatContext->streams[videoIndex];
+    int64_t ts = av_rescale_q(timestamp, AV_TIME_BASE_Q, stream->time_base);
+    int i = av_index_search_timestamp(stream, ts, AVSEEK_FLAG_BACKWARD);
+    if (i < 0) {
+        return timestamp;
+    }
+    return av_rescale_q(stream->index_entries[i].timestamp, stream->time_base, AV_TIME_BASE_Q);
+}
+
 
 
@@ -11,11 +11,44 @@ extern "C" {
 #include <libswresample/swresample.h>
 }
 
+#include <atomic>
+#include <string>
+#include "video_scaler.h"
+#include "frame_pool.h"
+#include "video_qos.h"
+#include "byte_source.h"
+#include "file_input.h"
+#include "chunk_cache.h"
+
+// Video scale quality profiles
+#define SCALE_QUALITY_FAST      0   // SWS_FAST_BILINEAR, for power saving
+#define SCALE_QUALITY_DEFAULT   1   // SWS_BILINEAR
+#define SCALE_QUALITY_HIGH      2   // SWS_BICUBIC
+
+struct OpenStats {
+    // NOTES: in microseconds, of the last open()
+    int64_t openTime = 0;
+    int64_t probeTime = 0;
+    int64_t codecTime = 0;
+    // the stream parameters were taken from the StreamCache instead of probing
+    bool cached = false;
+};
+
+struct ReadStats {
+    int64_t packets = 0;
+    // NOTES: in microseconds, spent in readPacket()
+    int64_t readTime = 0;
+};
+
 class FFWrapper {
 public:
     // class utils
     static void freePacket(AVPacket& packet);
+    // NOTES: the frame shell goes back to the shared frame pool
     static void freeFrame(AVFrame* frame);
+    static PoolStats framePoolStats() {
+        return FramePool::instance().stats();
+    }
     static SwsContext* getVideoScale(
         int src_w, int src_h, AVPixelFormat src_pix_fmt,
         int dst_w, int dst_h, AVPixelFormat dst_pix_fmt);
@@ -32,22 +65,96 @@ public:
     FFWrapper();
     ~FFWrapper();
     bool open(const char* url);
+    // NOTES: reads from source, which must outlive close(). name is a hint for probing the format,
+    //        and keys the StreamCache unless it's empty
+    bool open(ByteSource* source, const char* name);
     void close();
+    // NOTES: should be called before open(). count 0 detects it from cpu cores and video size,
+    //        type 0 uses the per-codec policy, otherwise FF_THREAD_FRAME and/or FF_THREAD_SLICE
+    void setVideoThreads(int count, int type = 0) {
+        videoThreadCount = count;
+        videoThreadType = type;
+    }
+    // NOTES: should be called before open(), a session without audio opens files without an
+    //        audio stream as well, and reads only the video packets
+    void setAudioEnabled(bool enabled) {
+        audioEnabled = enabled;
+    }
+    // NOTES: should be called before open(), decoders supporting lowres decode at the smallest
+    //        1/2^n of the video size which is still at least width x height
+    void setVideoDecodeSize(int width, int height) {
+        videoDecodeWidth = width;
+        videoDecodeHeight = height;
+    }
+    // NOTES: should be called before open(), the streams are probed with a smaller probesize and
+    //        analyzeduration, or not at all if the StreamCache knows the source, and the video and
+    //        audio decoders are opened in parallel
+    void setFastStart(bool enabled) {
+        fastStart = enabled;
+    }
+    OpenStats openStats() {
+        return lastOpenStats;
+    }
+    // NOTES: should be called before open(), local files are read through a FileInput unless
+    //        the mode is INPUT_MODE_DEFAULT
+    void setInputConfig(const InputConfig& config) {
+        inputConfig = FileInput::validConfig(config);
+    }
+    // NOTES: since open(), read them on the demuxing thread or once it has stopped
+    ReadStats readStats() {
+        return packetStats;
+    }
+    InputStats inputStats() {
+        return fileInput ? fileInput->stats() : InputStats();
+    }
+    // NOTES: should be called before open(), http(s) urls of a known size are read through the
+    //        cache, nullptr reads them straight from the network
+    void setChunkCache(ChunkCache* cache) {
+        chunkCache = cache;
+    }
     // NOTES: in AV_TIME_BASE fractional seconds
     bool seek(int64_t timestamp);
+    // NOTES: in AV_TIME_BASE fractional seconds, the video keyframe at or before timestamp as far as
+    //        the container index knows, playback resumes from it after seek(timestamp)
+    int64_t keyframeTime(int64_t timestamp);
+    // NOTES: position is a byte offset in the file, e.g. of a keyframe packet
+    bool seekPosition(int64_t position);
+    // NOTES: false for formats like mp4 whose packets can't be found from a byte offset
+    bool canSeekPosition() {
+        return !(formatContext->iformat->flags & AVFMT_NO_BYTE_SEEK);
+    }
     bool readPacket(AVPacket& packet, bool* isEOF = nullptr);
 
     // video related
-    bool decodeVideo(const AVPacket& packet, AVFrame** frame, int* decoded = nullptr);
+    // NOTES: a null packet puts the decoder into draining mode
+    bool sendVideoPacket(const AVPacket* packet);
+    // NOTES: returns false if no frame is available yet, isEOF is set once the decoder is fully drained
+    bool receiveVideoFrame(AVFrame** frame, bool* isEOF = nullptr);
+    void flushVideoDecoder();
+    // NOTES: SKIP_LEVEL_XXX in video_qos.h, should be called on the decoding thread
+    void setVideoSkipLevel(int level);
+    // NOTES: only keyframes are decoded, should be called on the decoding thread
+    void setVideoKeyframesOnly(bool keyframesOnly);
+    // NOTES: cheap to call for every frame, scalers are cached per geometry
     bool setVideoScale(const AVFrame* frame, int dst_w, int dst_h, 
-        AVPixelFormat dst_pix_fmt);                   
+        AVPixelFormat dst_pix_fmt);
+    void setVideoScaleQuality(int quality);
+    // NOTES: a bilinear scale is enough, the scale quality isn't SCALE_QUALITY_HIGH
+    bool bilinearScale() {
+        return videoScaleFlags != SWS_BICUBIC;
+    }
     void scaleVideo(const AVFrame* frame, uint8_t** dst_data, int* dst_linesize);
     
     // audio related
-    bool decodeAudio(const AVPacket& packet, AVFrame** frame, int* decoded = nullptr);
+    // NOTES: a null packet puts the decoder into draining mode
+    bool sendAudioPacket(const AVPacket* packet);
+    // NOTES: returns false if no frame is available yet, isEOF is set once the decoder is fully drained
+    bool receiveAudioFrame(AVFrame** frame, bool* isEOF = nullptr);
+    void flushAudioDecoder();
     bool setAudioResample(const AVFrame* frame, int64_t dst_ch_layout, 
         int dst_rate, AVSampleFormat dst_sample_fmt);
-    void resampleAudio(const AVFrame* frame, uint8_t** dst_data, int dst_samples);
+    // NOTES: returns the samples written to dst_data, at most dst_samples
+    int resampleAudio(const AVFrame* frame, uint8_t** dst_data, int dst_samples);
 
 public:
     // NOTES: in AV_TIME_BASE fractional seconds
@@ -87,6 +194,14 @@ public:
     double videoFPS() {
         return av_q2d(formatContext->streams[videoIndex]->avg_frame_rate);
     }
+    // NOTES: entries of the container index, 0 for formats without one
+    int videoIndexEntries() {
+        return formatContext->streams[videoIndex]->nb_index_entries;
+    }
+    // NOTES: in plane buffers, a miss allocates a new buffer
+    PoolStats videoBufferPoolStats() {
+        return videoBuffers.stats();
+    }
 
     // audio related
     bool isAudio(const AVPacket& packet) {
@@ -112,16 +227,43 @@ public:
     }
 
 
+private:
+    static bool sendPacket(AVCodecContext* codecContext, const AVPacket* packet);
+    static bool receiveFrame(AVCodecContext* codecContext, AVFrame* frame, bool* isEOF);
+    bool openInput(const char* url, ByteSource* source, const std::string& cacheKey);
+    bool probeStreams(const char* url, const std::string& key);
+    bool streamsComplete();
+    bool openVideoDecoder();
+    bool openAudioDecoder();
+
 private:
     AVFormatContext* formatContext = nullptr;
+    bool fastStart = false;
+    OpenStats lastOpenStats;
+    InputConfig inputConfig;
+    FileInput* fileInput = nullptr;
+    ChunkCache* chunkCache = nullptr;
+    UrlSource* urlSource = nullptr;
+    CachedSource* cachedSource = nullptr;
+    AVIOContext* ioContext = nullptr;
+    ReadStats packetStats;
     
     // video related
     int videoIndex = -1;
     AVCodecContext* videoCodecContext = nullptr;
     AVFrame* videoFrame = nullptr;
-    SwsContext* videoScaleContext = nullptr;
+    VideoBufferPool videoBuffers;
+    int videoThreadCount = 0;
+    int videoThreadType = 0;
+    int videoDecodeWidth = 0;
+    int videoDecodeHeight = 0;
+    VideoScalerCache videoScalers;
+    VideoScaler* videoScaler = nullptr;
+    // NOTES: set from the player thread, read on the render thread
+    std::atomic<int> videoScaleFlags{SWS_BILINEAR};
 
     // audio related
+    bool audioEnabled = true;
     int audioIndex = -1;
     AVCodecContext* audioCodecContext = nullptr;
     AVFrame* audioFrame = nullptr;
@@ -0,0 +1,251 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "log.h"
+#include "clock.h"
+#include "file_input.h"
+
+extern "C" {
+#include <libavutil/error.h>
+}
+
+#undef  LOG_TAG
+#define LOG_TAG "FileInput"
+
+// NOTES: in microseconds, a copy from the mapping taking longer faulted its pages in from storage
+#define MMAP_STALL_TIME     1000
+
+
+InputConfig FileInput::validConfig(const InputConfig& config) {
+    InputConfig valid = config;
+    if (valid.mode != INPUT_MODE_MMAP && valid.mode != INPUT_MODE_READ_AHEAD) {
+        valid.mode = INPUT_MODE_DEFAULT;
+    }
+    valid.ioBufferSize = std::min(std::max(valid.ioBufferSize, INPUT_MIN_IO_BUFFER), INPUT_MAX_IO_BUFFER);
+    int64_t pageSize = sysconf(_SC_PAGESIZE);
+    int64_t blockSize = std::min(std::max(int64_t(valid.blockSize), pageSize), int64_t(INPUT_MAX_BLOCK_SIZE));
+    valid.blockSize = int((blockSize + pageSize - 1)/pageSize*pageSize);
+    valid.blockCount = std::min(std::max(valid.blockCount, 2), INPUT_MAX_BLOCK_COUNT);
+    // large blocks come in fewer
+    valid.blockCount = int(std::max<int64_t>(2, std::min<int64_t>(valid.blockCount, INPUT_MAX_READ_AHEAD/valid.blockSize)));
+    return valid;
+}
+
+FileInput::FileInput(const InputConfig& config) : config(validConfig(config)) {
+}
+
+FileInput::~FileInput() {
+    close();
+}
+
+bool FileInput::open(const std::string& url) {
+    close();
+    std::string path = url.compare(0, 5, "file:") == 0 ? url.substr(5) : url;
+    // NOTES: INPUT_MODE_DEFAULT is read by FFmpeg itself
+    if (config.mode == INPUT_MODE_DEFAULT || path.empty() || path[0] != '/') {
+        return false;
+    }
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        LOGE("open: can't open %s, errno=%d", path.c_str(), errno);
+        close();
+        return false;
+    }
+    fileSize = st.st_size;
+    position = 0;
+    inputStats = InputStats();
+
+    if (config.mode == INPUT_MODE_MMAP) {
+        void* data = fileSize > 0 ? mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        if (data == MAP_FAILED) {
+            // e.g. no address space left for a large file on a 32-bit process
+            LOGW("open: mmap(%s) failed, read it ahead instead", path.c_str());
+            config.mode = INPUT_MODE_READ_AHEAD;
+        } else {
+            mapped = static_cast<uint8_t*>(data);
+            madvise(mapped, fileSize, MADV_SEQUENTIAL);
+            adviseBlock = -1;
+        }
+    }
+    if (config.mode == INPUT_MODE_READ_AHEAD) {
+        blocks.resize(config.blockCount);
+        for (Block& block : blocks) {
+            // aligned, so the kernel can copy whole pages
+            if (posix_memalign(reinterpret_cast<void**>(&block.data), sysconf(_SC_PAGESIZE), config.blockSize) != 0) {
+                LOGE("open: can't allocate %d blocks of %d bytes", config.blockCount, config.blockSize);
+                close();
+                return false;
+            }
+        }
+        windowStart = 0;
+        readError = 0;
+        stopped = false;
+        aheadThread = std::thread(&FileInput::readingAhead, this);
+    }
+
+    LOGI("open: %s, size=%lld, mode=%d, io_buffer=%d, blocks=%dx%d", path.c_str(), (long long)fileSize,
+        config.mode, config.ioBufferSize, config.blockCount, config.blockSize);
+    return true;
+}
+
+void FileInput::close() {
+    if (aheadThread.joinable()) {
+        std::unique_lock<std::mutex> lock(m);
+        stopped = true;
+        lock.unlock();
+        aheadCondition.notify_one();
+        aheadThread.join();
+    }
+    for (Block& block : blocks) {
+        free(block.data);
+    }
+    blocks.clear();
+    if (mapped) {
+        munmap(mapped, fileSize);
+        mapped = nullptr;
+    }
+    if (fd >= 0) {
+        LOGI("close: reads=%lld, bytes=%lld, stalls=%lld, stall_time=%lldms", (long long)inputStats.reads,
+            (long long)inputStats.bytes, (long long)inputStats.stalls, (long long)inputStats.stallTime/1000);
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+int64_t FileInput::seek(int64_t offset) {
+    if (offset < 0) {
+        return AVERROR(EINVAL);
+    }
+    position = offset;
+    return position;
+}
+
+int FileInput::read(uint8_t* buf, int size) {
+    if (position >= fileSize) {
+        return AVERROR_EOF;
+    }
+    if (mapped) {
+        return readMapped(buf, size);
+    }
+    // NOTES: open() failed or the mode reads nothing ahead
+    return blocks.empty() ? AVERROR(EINVAL) : readBuffered(buf, size);
+}
+
+int FileInput::readMapped(uint8_t* buf, int size) {
+    int64_t block = position/config.blockSize;
+    if (block != adviseBlock) {
+        // the kernel reads the window ahead in the background, the copies below rarely fault
+        int64_t offset = block*config.blockSize;
+        madvise(mapped + offset, std::min(int64_t(config.blockSize)*config.blockCount, fileSize - offset), MADV_WILLNEED);
+        adviseBlock = block;
+        inputStats.reads++;
+    }
+    int n = int(std::min(int64_t(size), fileSize - position));
+    int64_t start = monotonicTime();
+    memcpy(buf, mapped + position, n);
+    int64_t elapsed = monotonicTime() - start;
+    if (elapsed > MMAP_STALL_TIME) {
+        inputStats.stalls++;
+        inputStats.stallTime += elapsed;
+    }
+    position += n;
+    inputStats.bytes += n;
+    return n;
+}
+
+int FileInput::readBuffered(uint8_t* buf, int size) {
+    int64_t offset = position/config.blockSize*config.blockSize;
+    std::unique_lock<std::mutex> lock(m);
+    if (windowStart != offset) {
+        windowStart = offset;
+        aheadCondition.notify_one();
+    }
+    Block& block = blocks[(offset/config.blockSize) % config.blockCount];
+    int64_t stallStart = -1;
+    while (!(block.ready && block.offset == offset) && !readError && !stopped) {
+        if (stallStart < 0) {
+            stallStart = monotonicTime();
+            inputStats.stalls++;
+        }
+        readerCondition.wait(lock);
+    }
+    if (stallStart >= 0) {
+        inputStats.stallTime += monotonicTime() - stallStart;
+    }
+    if (!(block.ready && block.offset == offset)) {
+        return readError ? AVERROR(readError) : AVERROR_EXIT;
+    }
+    int within = int(position - offset);
+    int n = std::min(size, block.size - within);
+    if (n <= 0) {
+        // the file was truncated while reading it
+        return AVERROR_EOF;
+    }
+    memcpy(buf, block.data + within, n);
+    position += n;
+    inputStats.bytes += n;
+    return n;
+}
+
+void FileInput::readingAhead() {
+    LOGD("readingAhead: thread started");
+    int64_t blockSize = config.blockSize;
+    int count = config.blockCount;
+    std::unique_lock<std::mutex> lock(m);
+    while (!stopped) {
+        // the block being read first, then the ones after it, the one before it last
+        int64_t offset = -1;
+        for (int i = 0; i < count && offset < 0; i++) {
+            int64_t o = i < count - 1 ? windowStart + i*blockSize : windowStart - blockSize;
+            if (o >= 0 && o < fileSize && blocks[(o/blockSize) % count].offset != o) {
+                offset = o;
+            }
+        }
+        if (offset < 0 || readError) {
+            aheadCondition.wait(lock);
+            continue;
+        }
+        Block& block = blocks[(offset/blockSize) % count];
+        block.offset = offset;
+        block.ready = false;
+        lock.unlock();
+
+        int64_t done = 0;
+        int reads = 0;
+        int error = 0;
+        while (done < blockSize && offset + done < fileSize) {
+            ssize_t n = pread(fd, block.data + done, blockSize - done, offset + done);
+            reads++;
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                error = errno;
+                break;
+            }
+            if (n == 0) {
+                break;
+            }
+            done += n;
+        }
+
+        lock.lock();
+        inputStats.reads += reads;
+        if (error) {
+            LOGE("readingAhead: pread at %lld failed, errno=%d", (long long)offset, error);
+            readError = error;
+            block.offset = -1;
+        } else {
+            block.size = int(done);
+            block.ready = true;
+        }
+        readerCondition.notify_one();
+    }
+    LOGD("readingAhead: thread exited");
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "byte_source.h"
+
+// Input modes of local files
+#define INPUT_MODE_DEFAULT      0   // FFmpeg's file protocol, small reads on the demuxing thread
+#define INPUT_MODE_MMAP         1   // the file is mapped, the kernel is asked to page in the blocks ahead
+#define INPUT_MODE_READ_AHEAD   2   // a thread reads the blocks ahead into aligned buffers
+
+// NOTES: the limits of InputConfig, in bytes and blocks
+#define INPUT_MIN_IO_BUFFER     4096
+#define INPUT_MAX_IO_BUFFER     (4*1024*1024)
+#define INPUT_MAX_BLOCK_SIZE    (64*1024*1024)
+#define INPUT_MAX_BLOCK_COUNT   64
+#define INPUT_MAX_READ_AHEAD    (256LL*1024*1024)
+
+struct InputConfig {
+    int mode = INPUT_MODE_DEFAULT;
+    // NOTES: in bytes, the buffer of the AVIOContext, the most the demuxer gets per read call
+    int ioBufferSize = 64*1024;
+    // NOTES: in bytes, multiples of the page size. blockSize*blockCount is read ahead of the demuxer
+    int blockSize = 1024*1024;
+    int blockCount = 8;
+};
+
+struct InputStats {
+    // read or madvise syscalls
+    int64_t reads = 0;
+    int64_t bytes = 0;
+    // the demuxer had to wait for storage
+    int64_t stalls = 0;
+    // NOTES: in microseconds
+    int64_t stallTime = 0;
+};
+
+//
+// A ByteSource over a local file which keeps storage access off the demuxing thread. In
+// INPUT_MODE_MMAP reads are copies from the mapping, and the blocks ahead are paged in by the
+// kernel's read-ahead with MADV_WILLNEED. In INPUT_MODE_READ_AHEAD a thread preads whole blocks
+// ahead of the demuxer into a ring of blockCount buffers, the block before the one being read is
+// kept for the short backward seeks of badly interleaved files. A seek out of the ring restarts
+// the read-ahead at the new position.
+//
+class FileInput: public ByteSource {
+public:
+    FileInput(const InputConfig& config);
+    ~FileInput();
+
+    // NOTES: an unknown mode is INPUT_MODE_DEFAULT, the sizes are clamped to the limits and
+    //        blockSize is rounded up to pages
+    static InputConfig validConfig(const InputConfig& config);
+
+    // NOTES: path or file:path, returns false if it isn't a local file which can be opened
+    bool open(const std::string& url);
+    void close();
+    // NOTES: read them once the demuxing has stopped
+    InputStats stats() {
+        return inputStats;
+    }
+
+    int read(uint8_t* buf, int size) override;
+    // NOTES: nothing is read here, the read-ahead follows the next read
+    int64_t seek(int64_t offset) override;
+    int64_t size() override {
+        return fileSize;
+    }
+
+private:
+    int readMapped(uint8_t* buf, int size);
+    int readBuffered(uint8_t* buf, int size);
+    void readingAhead();
+
+private:
+    struct Block {
+        uint8_t* data = nullptr;
+        // NOTES: of the file, -1 if the block is free
+        int64_t offset = -1;
+        int size = 0;
+        bool ready = false;
+    };
+
+private:
+    InputConfig config;
+    int fd = -1;
+    int64_t fileSize = 0;
+    int64_t position = 0;
+    InputStats inputStats;
+
+    // INPUT_MODE_MMAP
+    uint8_t* mapped = nullptr;
+    // the last block MADV_WILLNEED was given for
+    int64_t adviseBlock = -1;
+
+    // INPUT_MODE_READ_AHEAD, the blocks and the window are guarded by m
+    std::mutex m;
+    std::condition_variable readerCondition;
+    std::condition_variable aheadCondition;
+    std::thread aheadThread;
+    std::vector<Block> blocks;
+    // the offset of the first block of the window read ahead
+    int64_t windowStart = 0;
+    int readError = 0;
+    bool stopped = false;
+};
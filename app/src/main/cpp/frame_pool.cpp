@@ -0,0 +1,179 @@
+#include "log.h"
+#include "frame_pool.h"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+#undef  LOG_TAG
+#define LOG_TAG "FramePool"
+
+// NOTES: same as the largest SIMD alignment FFmpeg may be built with
+#define BUFFER_ALIGN    64
+
+
+FramePool::FramePool(size_t capacity) : capacity(capacity) {
+    // never grows, so free() doesn't allocate either
+    frames.reserve(capacity);
+}
+
+FramePool::~FramePool() {
+    for (AVFrame* frame : frames) {
+        av_frame_free(&frame);
+    }
+    frames.clear();
+}
+
+AVFrame* FramePool::alloc() {
+    {
+        std::unique_lock<std::mutex> lock(m);
+        if (!frames.empty()) {
+            AVFrame* frame = frames.back();
+            frames.pop_back();
+            hits++;
+            return frame;
+        }
+    }
+    misses++;
+    AVFrame* frame = av_frame_alloc();
+    if (!frame) {
+        LOGE("av_frame_alloc failed");
+    }
+    return frame;
+}
+
+void FramePool::free(AVFrame* frame) {
+    if (!frame) {
+        return;
+    }
+    av_frame_unref(frame);
+    {
+        std::unique_lock<std::mutex> lock(m);
+        if (frames.size() < capacity) {
+            frames.push_back(frame);
+            return;
+        }
+    }
+    av_frame_free(&frame);
+}
+
+
+VideoBufferPool::~VideoBufferPool() {
+    release();
+}
+
+void VideoBufferPool::attach(AVCodecContext* codecContext) {
+    codecContext->opaque = this;
+    codecContext->get_buffer2 = &VideoBufferPool::getBuffer;
+    codecContext->thread_safe_callbacks = 1;
+}
+
+void VideoBufferPool::release() {
+    std::unique_lock<std::mutex> lock(m);
+    // NOTES: buffers still referenced by frames are freed when they are returned
+    for (int i = 0; i < 4; i++) {
+        av_buffer_pool_uninit(&pools[i]);
+        poolSizes[i] = 0;
+        linesizes[i] = 0;
+    }
+    planes = 0;
+    format = AV_PIX_FMT_NONE;
+    width = 0;
+    height = 0;
+}
+
+AVBufferRef* VideoBufferPool::allocBuffer(void* opaque, int size) {
+    VideoBufferPool* pool = static_cast<VideoBufferPool*>(opaque);
+    pool->misses++;
+    return av_buffer_alloc(size);
+}
+
+// NOTES: the plane layout follows avcodec_default_get_buffer2()
+bool VideoBufferPool::update(AVCodecContext* codecContext, const AVFrame* frame) {
+    if (format == frame->format && width == frame->width && height == frame->height) {
+        return true;
+    }
+    for (int i = 0; i < 4; i++) {
+        av_buffer_pool_uninit(&pools[i]);
+        poolSizes[i] = 0;
+    }
+    planes = 0;
+    format = AV_PIX_FMT_NONE;
+
+    AVPixelFormat pix_fmt = (AVPixelFormat)frame->format;
+    int w = frame->width;
+    int h = frame->height;
+    int linesizeAlign[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(codecContext, &w, &h, linesizeAlign);
+    // widen until every linesize meets the codec's alignment
+    int unaligned = 0;
+    do {
+        if (av_image_fill_linesizes(linesizes, pix_fmt, w) < 0) {
+            LOGE("av_image_fill_linesizes failed: pix_fmt=%s, width=%d", av_get_pix_fmt_name(pix_fmt), w);
+            return false;
+        }
+        w += w & ~(w - 1);
+        unaligned = 0;
+        for (int i = 0; i < 4; i++) {
+            unaligned |= linesizes[i] % linesizeAlign[i];
+        }
+    } while (unaligned);
+
+    uint8_t* data[4] = {nullptr};
+    int size = av_image_fill_pointers(data, pix_fmt, h, nullptr, linesizes);
+    if (size < 0) {
+        LOGE("av_image_fill_pointers failed: pix_fmt=%s, height=%d", av_get_pix_fmt_name(pix_fmt), h);
+        return false;
+    }
+    for (planes = 0; planes < 4 && linesizes[planes]; planes++) {
+        if (planes < 3 && data[planes + 1]) {
+            poolSizes[planes] = data[planes + 1] - data[planes];
+        } else {
+            poolSizes[planes] = size - (data[planes] - data[0]);
+        }
+    }
+    for (int i = 0; i < planes; i++) {
+        pools[i] = av_buffer_pool_init2(poolSizes[i] + 16 + BUFFER_ALIGN - 1, this, &VideoBufferPool::allocBuffer, nullptr);
+        if (!pools[i]) {
+            LOGE("av_buffer_pool_init2 failed: size=%d", poolSizes[i]);
+            return false;
+        }
+    }
+    format = frame->format;
+    width = frame->width;
+    height = frame->height;
+    LOGD("update succeed: pix_fmt=%s, size=%dx%d, planes=%d, linesizes=%d/%d/%d/%d",
+        av_get_pix_fmt_name(pix_fmt), width, height, planes,
+        linesizes[0], linesizes[1], linesizes[2], linesizes[3]);
+    return true;
+}
+
+int VideoBufferPool::getBuffer(AVCodecContext* codecContext, AVFrame* frame, int flags) {
+    VideoBufferPool* pool = static_cast<VideoBufferPool*>(codecContext->opaque);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    // hardware and paletted frames, and codecs without direct rendering use the default buffers
+    if (!pool || !desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)) ||
+        !(codecContext->codec->capabilities & AV_CODEC_CAP_DR1)) {
+        return avcodec_default_get_buffer2(codecContext, frame, flags);
+    }
+
+    std::unique_lock<std::mutex> lock(pool->m);
+    if (!pool->update(codecContext, frame)) {
+        lock.unlock();
+        return avcodec_default_get_buffer2(codecContext, frame, flags);
+    }
+    for (int i = 0; i < pool->planes; i++) {
+        frame->buf[i] = av_buffer_pool_get(pool->pools[i]);
+        if (!frame->buf[i]) {
+            LOGE("av_buffer_pool_get failed: plane=%d", i);
+            av_frame_unref(frame);
+            return AVERROR(ENOMEM);
+        }
+        frame->data[i] = frame->buf[i]->data;
+        frame->linesize[i] = pool->linesizes[i];
+        pool->gets++;
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
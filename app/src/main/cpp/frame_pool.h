@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/buffer.h>
+#include <libavcodec/avcodec.h>
+}
+
+struct PoolStats {
+    int64_t hits = 0;
+    int64_t misses = 0;
+};
+
+//
+// Recycles the AVFrame shells handed from the decoders to the renders, so a decoded frame
+// doesn't cost an av_frame_alloc()/av_frame_free() pair. Shared by all players.
+//
+class FramePool {
+public:
+    static FramePool& instance() {
+        static FramePool pool;
+        return pool;
+    }
+
+    FramePool(size_t capacity = 64);
+    ~FramePool();
+
+    // NOTES: returns nullptr if out of memory
+    AVFrame* alloc();
+    // NOTES: unreferences the frame data, the shell is kept for the next alloc()
+    void free(AVFrame* frame);
+    PoolStats stats() {
+        PoolStats s;
+        s.hits = hits;
+        s.misses = misses;
+        return s;
+    }
+
+private:
+    std::mutex m;
+    std::vector<AVFrame*> frames;
+    size_t capacity;
+    std::atomic<int64_t> hits{0};
+    std::atomic<int64_t> misses{0};
+};
+
+
+//
+// Video frame buffers served by a custom get_buffer2 from one AVBufferPool per plane.
+// The pools are rebuilt only when the frame format or size changes, and outlive the
+// codec context, so reopening the same stream keeps its buffers.
+//
+class VideoBufferPool {
+public:
+    VideoBufferPool() {}
+    ~VideoBufferPool();
+
+    // NOTES: should be called before avcodec_open2(), the pool must outlive the codec context
+    void attach(AVCodecContext* codecContext);
+    void release();
+    PoolStats stats() {
+        PoolStats s;
+        s.hits = gets - misses;
+        s.misses = misses;
+        return s;
+    }
+
+private:
+    static int getBuffer(AVCodecContext* codecContext, AVFrame* frame, int flags);
+    static AVBufferRef* allocBuffer(void* opaque, int size);
+    bool update(AVCodecContext* codecContext, const AVFrame* frame);
+
+private:
+    // NOTES: get_buffer2 is called from the decoding threads with frame threading
+    std::mutex m;
+    AVBufferPool* pools[4] = {nullptr};
+    int poolSizes[4] = {0};
+    int linesizes[4] = {0};
+    int planes = 0;
+    int format = AV_PIX_FMT_NONE;
+    int width = 0;
+    int height = 0;
+    std::atomic<int64_t> gets{0};
+    std::atomic<int64_t> misses{0};
+};
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <algorithm>
+#include "log.h"
+#include "clock.h"
+#include "frame_scheduler.h"
+
+#undef  LOG_TAG
+#define LOG_TAG "FrameScheduler"
+
+// NOTES: in microseconds
+#define DEFAULT_FRAME_DURATION  40000
+// a frame due later than this is a timestamp discontinuity, it is written at once
+#define MAX_EARLY_DURATION      1000000
+// the jitter histogram is logged every this many frames
+#define JITTER_LOG_FRAMES       300
+
+
+void JitterHistogram::add(int64_t error) {
+    int64_t e = error < 0 ? -error : error;
+    int bucket = 0;
+    int64_t bound = 250;
+    while (bucket < BUCKETS - 1 && e >= bound) {
+        bucket++;
+        bound *= 2;
+    }
+    counts[bucket]++;
+    samples++;
+    maxAbsError = std::max(maxAbsError, e);
+}
+
+void JitterHistogram::reset() {
+    for (int i = 0; i < BUCKETS; i++) {
+        counts[i] = 0;
+    }
+    samples = 0;
+    maxAbsError = 0;
+}
+
+std::string JitterHistogram::toString() {
+    static const char* names[BUCKETS] = {
+        "<0.25ms", "<0.5ms", "<1ms", "<2ms", "<4ms", "<8ms", "<16ms", ">=16ms"
+    };
+    std::string s;
+    char item[64];
+    for (int i = 0; i < BUCKETS; i++) {
+        snprintf(item, sizeof(item), "%s%s:%lld", i ? " " : "", names[i], (long long)counts[i]);
+        s += item;
+    }
+    snprintf(item, sizeof(item), " max:%lldus", (long long)maxAbsError);
+    s += item;
+    return s;
+}
+
+
+void FrameScheduler::reset(double fps) {
+    setFrameRate(fps);
+    renderCost = 0;
+    lastPresented = -1;
+    lastLateness = 0;
+    counters = SchedulerStats();
+    histogram.reset();
+}
+
+void FrameScheduler::setFrameRate(double fps) {
+    frameDuration = fps > 0 ? int64_t(1000000/fps) : DEFAULT_FRAME_DURATION;
+}
+
+FrameScheduler::Action FrameScheduler::schedule(int64_t pts, int64_t runningTime, int64_t* deadline) {
+    int64_t now = monotonicTime();
+    int64_t target = now + (pts - runningTime);
+    int64_t start = target - renderCost;
+    if (start - now > MAX_EARLY_DURATION) {
+        LOGW("schedule: pts=%lldms is %lldms ahead of the clock, write it now",
+            (long long)pts/1000, (long long)(pts - runningTime)/1000);
+        start = now;
+    }
+    // it would still be on its way to the screen when the next frame is due
+    lastLateness = now + renderCost - target;
+    if (lastLateness > frameDuration) {
+        return ACTION_DROP;
+    }
+    *deadline = start;
+    return ACTION_PRESENT;
+}
+
+bool FrameScheduler::waitUntil(int64_t deadline, int64_t maxWait) {
+    TimeSource* source = TimeSource::current();
+    int64_t now = source->now();
+    if (deadline - now > maxWait) {
+        source->sleepFor(maxWait);
+        return false;
+    }
+    source->sleepUntil(deadline);
+    return true;
+}
+
+void FrameScheduler::presented(int64_t deadline, int64_t start, int64_t end) {
+    int64_t cost = end - start;
+    renderCost = renderCost ? (renderCost*7 + cost)/8 : cost;
+    histogram.add(start - deadline);
+    if (lastPresented >= 0 && end - lastPresented > 2*frameDuration) {
+        counters.repeated++;
+    }
+    lastPresented = end;
+    counters.presented++;
+    if (counters.presented % JITTER_LOG_FRAMES == 0) {
+        LOGI("presented=%lld, dropped=%lld, repeated=%lld, render_cost=%lldus, jitter: %s",
+            (long long)counters.presented, (long long)counters.dropped, (long long)counters.repeated,
+            (long long)renderCost, histogram.toString().c_str());
+    }
+}
+
+void FrameScheduler::dropped() {
+    counters.dropped++;
+}
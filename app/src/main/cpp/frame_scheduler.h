@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+//
+// Presentation error histogram, the error of a frame is when its write started minus its deadline.
+// Buckets are 0-0.25ms, 0.25-0.5ms, 0.5-1ms, ... doubling up to 16ms and more.
+//
+class JitterHistogram {
+public:
+    static const int BUCKETS = 8;
+
+    // NOTES: error in microseconds, early and late frames count the same
+    void add(int64_t error);
+    void reset();
+    int64_t count(int bucket) {
+        return counts[bucket];
+    }
+    int64_t total() {
+        return samples;
+    }
+    // NOTES: in microseconds
+    int64_t maxError() {
+        return maxAbsError;
+    }
+    std::string toString();
+
+private:
+    int64_t counts[BUCKETS] = {0};
+    int64_t samples = 0;
+    int64_t maxAbsError = 0;
+};
+
+struct SchedulerStats {
+    int64_t presented = 0;
+    int64_t dropped = 0;
+    // frames presented over two frame durations after the previous one, which was shown repeatedly
+    int64_t repeated = 0;
+    // NOTES: in microseconds
+    int64_t renderCost = 0;
+};
+
+//
+// Decides when each video frame is written to the video device. The target display time of a
+// frame follows from its pts and the master clock, writing starts early by the measured render
+// cost, and a frame is dropped if it couldn't be displayed before the next one is due.
+// All times are in microseconds, deadlines are in monotonic time (see TimeSource).
+//
+class FrameScheduler {
+public:
+    enum Action {
+        ACTION_PRESENT,
+        ACTION_DROP
+    };
+
+    // NOTES: fps <= 0 means unknown
+    void reset(double fps);
+    // NOTES: of the frames from now on, e.g. of the next source of a playlist, keeps the stats
+    void setFrameRate(double fps);
+    // NOTES: runningTime is the master clock now, deadline is when to start writing the frame
+    Action schedule(int64_t pts, int64_t runningTime, int64_t* deadline);
+    // NOTES: returns true at the deadline, or false after waiting maxWait, so the caller
+    //        can handle its events while waiting for a far deadline
+    bool waitUntil(int64_t deadline, int64_t maxWait);
+    // NOTES: called once the frame was written, start and end are the write times
+    void presented(int64_t deadline, int64_t start, int64_t end);
+    void dropped();
+    // NOTES: called after a seek, the gap to the previous frame is not a repeat
+    void flush() {
+        lastPresented = -1;
+    }
+
+    // NOTES: of the last scheduled frame, positive if it was late
+    int64_t lateness() {
+        return lastLateness;
+    }
+    SchedulerStats stats() {
+        SchedulerStats s = counters;
+        s.renderCost = renderCost;
+        return s;
+    }
+    JitterHistogram& jitter() {
+        return histogram;
+    }
+
+private:
+    int64_t frameDuration = 40000;
+    // exponential moving average of the write durations
+    int64_t renderCost = 0;
+    int64_t lastPresented = -1;
+    int64_t lastLateness = 0;
+    SchedulerStats counters;
+    JitterHistogram histogram;
+};
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "log.h"
+#include "clock.h"
+#include "ffwrapper.h"
+#include "keyframe_index.h"
+
+#undef  LOG_TAG
+#define LOG_TAG "KeyframeIndex"
+
+#define INDEX_MAGIC             0x4946424b  // "KBFI"
+#define INDEX_VERSION           1
+#define INDEX_FLAG_COMPLETE     0x01
+// NOTES: bytes hashed at each end of the file
+#define KEY_SAMPLE_SIZE         (64*1024)
+// an incomplete index built while playing may have holes after seeks, a keyframe this
+// far (in microseconds) before the seek target is a hole rather than a long GOP
+#define MAX_KEYFRAME_GAP        10000000
+
+struct IndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t flags;
+    uint32_t count;
+};
+
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+bool KeyframeIndex::isLocalFile(const std::string& url) {
+    // a url has its protocol before the first slash, e.g. http: or pipe:
+    size_t colon = url.find(':');
+    return url.compare(0, 5, "file:") == 0 || colon == std::string::npos || colon > url.find('/');
+}
+
+uint64_t KeyframeIndex::fileKey(const std::string& url) {
+    if (!isLocalFile(url)) {
+        return 0;
+    }
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    std::string path = url.compare(0, 5, "file:") == 0 ? url.substr(5) : url;
+    struct stat st;
+    FILE* file = nullptr;
+    if (stat(path.c_str(), &st) != 0 || !(file = fopen(path.c_str(), "rb"))) {
+        return 0;
+    }
+    int64_t size = st.st_size;
+    int64_t mtime = st.st_mtime;
+    hash = fnv1a(hash, &size, sizeof(size));
+    hash = fnv1a(hash, &mtime, sizeof(mtime));
+    std::vector<uint8_t> sample(KEY_SAMPLE_SIZE);
+    size_t n = fread(sample.data(), 1, sample.size(), file);
+    hash = fnv1a(hash, sample.data(), n);
+    if (size > KEY_SAMPLE_SIZE && fseeko(file, -KEY_SAMPLE_SIZE, SEEK_END) == 0) {
+        n = fread(sample.data(), 1, sample.size(), file);
+        hash = fnv1a(hash, sample.data(), n);
+    }
+    fclose(file);
+    return hash;
+}
+
+void KeyframeIndex::reset(uint64_t key) {
+    std::unique_lock<std::mutex> lock(m);
+    this->key = key;
+    complete = false;
+    dirty = false;
+    entries.clear();
+}
+
+void KeyframeIndex::add(int64_t timestamp, int64_t position) {
+    std::unique_lock<std::mutex> lock(m);
+    if (entries.empty() || timestamp > entries.back().timestamp) {
+        entries.push_back({timestamp, position});
+        dirty = true;
+        return;
+    }
+    auto it = std::lower_bound(entries.begin(), entries.end(), timestamp,
+        [](const KeyframeEntry& e, int64_t t) { return e.timestamp < t; });
+    if (it->timestamp != timestamp) {
+        entries.insert(it, {timestamp, position});
+        dirty = true;
+    }
+}
+
+bool KeyframeIndex::find(int64_t timestamp, KeyframeEntry* entry) {
+    std::unique_lock<std::mutex> lock(m);
+    auto it = std::upper_bound(entries.begin(), entries.end(), timestamp,
+        [](int64_t t, const KeyframeEntry& e) { return t < e.timestamp; });
+    if (it == entries.begin()) {
+        return false;
+    }
+    --it;
+    if (!complete && (it + 1 == entries.end() || timestamp - it->timestamp > MAX_KEYFRAME_GAP)) {
+        // past the indexed range, or in a hole of it
+        return false;
+    }
+    *entry = *it;
+    return true;
+}
+
+int KeyframeIndex::size() {
+    std::unique_lock<std::mutex> lock(m);
+    return entries.size();
+}
+
+bool KeyframeIndex::isComplete() {
+    std::unique_lock<std::mutex> lock(m);
+    return complete;
+}
+
+bool KeyframeIndex::load(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(IndexHeader)) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        LOGE("load: mmap(%s) failed", path.c_str());
+        return false;
+    }
+    const IndexHeader* header = static_cast<const IndexHeader*>(data);
+    const KeyframeEntry* begin = reinterpret_cast<const KeyframeEntry*>(header + 1);
+    bool valid = header->magic == INDEX_MAGIC && header->version == INDEX_VERSION &&
+        st.st_size == (off_t)(sizeof(IndexHeader) + header->count*sizeof(KeyframeEntry));
+    std::unique_lock<std::mutex> lock(m);
+    if (valid && header->key == key) {
+        entries.assign(begin, begin + header->count);
+        complete = header->flags & INDEX_FLAG_COMPLETE;
+        dirty = false;
+        LOGI("load: %s, %u keyframes%s", path.c_str(), header->count, complete ? ", complete" : "");
+    } else {
+        LOGW("load: %s is stale or corrupted", path.c_str());
+        valid = false;
+    }
+    lock.unlock();
+    munmap(data, st.st_size);
+    return valid;
+}
+
+bool KeyframeIndex::save(const std::string& path) {
+    std::unique_lock<std::mutex> lock(m);
+    if (!dirty) {
+        return true;
+    }
+    // the old index stays intact until the new one is fully written
+    std::string temp = path + ".tmp";
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (!file) {
+        LOGE("save: fopen(%s) failed", temp.c_str());
+        return false;
+    }
+    IndexHeader header = {INDEX_MAGIC, INDEX_VERSION, key,
+        uint32_t(complete ? INDEX_FLAG_COMPLETE : 0), uint32_t(entries.size())};
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(entries.data(), sizeof(KeyframeEntry), entries.size(), file) == entries.size();
+    written = fclose(file) == 0 && written;
+    if (!written || rename(temp.c_str(), path.c_str()) != 0) {
+        LOGE("save: write %s failed", path.c_str());
+        unlink(temp.c_str());
+        return false;
+    }
+    dirty = false;
+    LOGI("save: %s, %d keyframes", path.c_str(), (int)entries.size());
+    return true;
+}
+
+bool KeyframeIndex::scan(const std::string& url, const std::atomic<bool>& cancelled) {
+    AVFormatContext* formatContext = nullptr;
+    if (avformat_open_input(&formatContext, url.c_str(), nullptr, nullptr) < 0) {
+        LOGE("scan: avformat_open_input(%s) failed", url.c_str());
+        return false;
+    }
+    int videoIndex = -1;
+    if (avformat_find_stream_info(formatContext, nullptr) >= 0) {
+        videoIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    }
+    if (videoIndex < 0) {
+        LOGE("scan: no video stream in %s", url.c_str());
+        avformat_close_input(&formatContext);
+        return false;
+    }
+    // only the video packets are needed
+    for (unsigned int i = 0; i < formatContext->nb_streams; i++) {
+        if (int(i) != videoIndex) {
+            formatContext->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+    AVRational timeBase = formatContext->streams[videoIndex]->time_base;
+    AVPacket packet;
+    av_init_packet(&packet);
+    int64_t start = monotonicTime();
+    int ret = 0;
+    while (!cancelled.load() && (ret = av_read_frame(formatContext, &packet)) >= 0) {
+        int64_t ts = packet.pts != AV_NOPTS_VALUE ? packet.pts : packet.dts;
+        if (packet.stream_index == videoIndex && (packet.flags & AV_PKT_FLAG_KEY) &&
+            packet.pos >= 0 && ts != AV_NOPTS_VALUE) {
+            add(av_rescale_q(ts, timeBase, AV_TIME_BASE_Q), packet.pos);
+        }
+        av_packet_unref(&packet);
+    }
+    avformat_close_input(&formatContext);
+    if (ret != AVERROR_EOF) {
+        LOGW("scan: %s stopped, %d keyframes", cancelled.load() ? "cancelled" : "read error", size());
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(m);
+    complete = true;
+    dirty = true;
+    LOGI("scan: %d keyframes in %lldms", (int)entries.size(), (long long)(monotonicTime() - start)/1000);
+    return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+struct KeyframeEntry {
+    // NOTES: in AV_TIME_BASE fractional seconds
+    int64_t timestamp;
+    // NOTES: byte offset of the keyframe packet in the file
+    int64_t position;
+};
+
+//
+// Keyframe index of the video stream, built while demuxing or by a background scan, so a seek in
+// a format without a (good) container index is a byte seek instead of a scan. The index of a local
+// file is persisted as a sidecar file keyed by a hash of the file: a fixed header followed by the
+// sorted entries, so loading it is one mapping and one copy.
+//
+class KeyframeIndex {
+public:
+    // NOTES: a plain path or a file: url
+    static bool isLocalFile(const std::string& url);
+    // NOTES: a hash of the file size, modification time and its first and last 64KB, 0 if url
+    //        isn't a local file, its index is only built from the packets demuxed then
+    static uint64_t fileKey(const std::string& url);
+
+    // NOTES: drops all entries, the index is for the file of key now
+    void reset(uint64_t key);
+    uint64_t getKey() {
+        return key;
+    }
+    // NOTES: keyframes come in order while playing, out of order ones (after a seek) are inserted
+    void add(int64_t timestamp, int64_t position);
+    // NOTES: the keyframe at or before timestamp, returns false if the index doesn't cover timestamp
+    bool find(int64_t timestamp, KeyframeEntry* entry);
+    int size();
+    // NOTES: complete once every keyframe of the file is in it
+    bool isComplete();
+    // NOTES: returns false if the file doesn't exist or isn't the index of the same media file
+    bool load(const std::string& path);
+    // NOTES: only written if there were changes since the last load/save
+    bool save(const std::string& path);
+    // NOTES: reads all packets of url on the caller thread, returns false if cancelled or failed.
+    //        meant for local files, remote media would be downloaded in full
+    bool scan(const std::string& url, const std::atomic<bool>& cancelled);
+
+private:
+    std::mutex m;
+    uint64_t key = 0;
+    bool complete = false;
+    bool dirty = false;
+    std::vector<KeyframeEntry> entries;
+};
@@ -2,17 +2,23 @@
 
 #define ENABLE_LOG
 
-#ifdef ENABLE_LOG
+#ifdef __ANDROID__
 #include <android/log.h>
-#define LOGD(...) ((void)__android_log_print(ANDROID_LOG_DEBUG, "haoplayer", LOG_TAG " " __VA_ARGS__))
-#define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO,  "haoplayer", LOG_TAG " " __VA_ARGS__))
-#define LOGW(...) ((void)__android_log_print(ANDROID_LOG_WARN,  "haoplayer", LOG_TAG " " __VA_ARGS__))
-#define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, "haoplayer", LOG_TAG " " __VA_ARGS__))
+#define LOG_PRINT(level, ...)   ((void)__android_log_print(ANDROID_LOG_##level, "haoplayer", LOG_TAG " " __VA_ARGS__))
+#else
+// NOTES: host builds (e.g. with the WAV audio device) log to stderr
+#include <stdio.h>
+#define LOG_PRINT(level, ...)   ((void)fprintf(stderr, #level " haoplayer " LOG_TAG " " __VA_ARGS__), (void)fputc('\n', stderr))
+#endif
+
+#ifdef ENABLE_LOG
+#define LOGD(...) LOG_PRINT(DEBUG, __VA_ARGS__)
+#define LOGI(...) LOG_PRINT(INFO,  __VA_ARGS__)
+#define LOGW(...) LOG_PRINT(WARN,  __VA_ARGS__)
+#define LOGE(...) LOG_PRINT(ERROR, __VA_ARGS__)
 #else
-#include <android/log.h>
 #define LOGD(...)
 #define LOGI(...)
 #define LOGW(...)
 #define LOGE(...)
 #endif
-
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include "ffwrapper.h"
+#include "utils.h"
+
+//
+// Watermarks of a packet queue. The producer is throttled once either the buffered bytes
+// or the buffered duration reaches its high watermark, and resumed only after both of
+// them have dropped to their low watermarks.
+//
+struct BufferLimits {
+    // NOTES: in bytes
+    int64_t highBytes = 32*1024*1024;
+    int64_t lowBytes = 16*1024*1024;
+    // NOTES: in microseconds
+    int64_t highDuration = 4000000;
+    int64_t lowDuration = 2000000;
+};
+
+//
+// Single-producer/single-consumer packet queue bounded by bytes and by buffered media
+// duration (the dts span between the last pushed and the last popped packet).
+//
+class PacketQueue {
+public:
+    // NOTES: capacity is only a hard upper bound of the packet count
+    PacketQueue(size_t capacity = 4096) : packets(capacity) {}
+
+    // NOTES: pushNotifier wakes the consumer, popNotifier wakes the throttled producer
+    void setNotifiers(Notifier* pushNotifier, Notifier* popNotifier = nullptr) {
+        packets.setNotifiers(pushNotifier, popNotifier);
+        this->popNotifier = popNotifier;
+    }
+
+    // NOTES: should be called before the producer and consumer threads are started
+    void setLimits(const BufferLimits& limits) {
+        this->limits = limits;
+    }
+
+    // NOTES: timeBase is the stream time base in seconds
+    void setTimeBase(double timeBase) {
+        this->timeBase = timeBase;
+    }
+
+    bool empty() {
+        return packets.empty();
+    }
+
+    int size() {
+        return packets.size();
+    }
+
+    int64_t bytes() {
+        return byteCount.load();
+    }
+
+    // NOTES: in microseconds
+    int64_t duration() {
+        int64_t in = lastIn.load();
+        int64_t out = lastOut.load();
+        if (packets.empty() || in == AV_NOPTS_VALUE || out == AV_NOPTS_VALUE || in < out) {
+            return 0;
+        }
+        return in - out;
+    }
+
+    // NOTES: producer only
+    bool push(const AVPacket& packet) {
+        bool wasEmpty = packets.empty();
+        if (throttled.load()) {
+            if (!belowLow()) {
+                return false;
+            }
+            throttled.store(false);
+        } else if (!wasEmpty && aboveHigh()) {
+            throttled.store(true);
+            // the consumer may have drained the queue before it could see the flag
+            if (!belowLow()) {
+                return false;
+            }
+            throttled.store(false);
+        }
+
+        byteCount.fetch_add(packet.size);
+        if (!packets.push(packet)) {
+            byteCount.fetch_sub(packet.size);
+            return false;
+        }
+        int64_t ts = timestamp(packet);
+        if (ts != AV_NOPTS_VALUE) {
+            lastIn.store(ts);
+            if (wasEmpty || lastOut.load() == AV_NOPTS_VALUE) {
+                lastOut.store(ts);
+            }
+        }
+        return true;
+    }
+
+    // NOTES: consumer only
+    bool pop(AVPacket& packet) {
+        if (!packets.pop(packet)) {
+            return false;
+        }
+        byteCount.fetch_sub(packet.size);
+        int64_t ts = timestamp(packet);
+        if (ts != AV_NOPTS_VALUE) {
+            lastOut.store(ts);
+        }
+        if (throttled.load() && belowLow() && throttled.exchange(false) && popNotifier) {
+            popNotifier->notify();
+        }
+        return true;
+    }
+
+private:
+    int64_t timestamp(const AVPacket& packet) {
+        int64_t ts = packet.dts != AV_NOPTS_VALUE ? packet.dts : packet.pts;
+        if (ts == AV_NOPTS_VALUE) {
+            return AV_NOPTS_VALUE;
+        }
+        return int64_t(ts * timeBase * 1000000);
+    }
+
+    bool aboveHigh() {
+        return bytes() >= limits.highBytes || duration() >= limits.highDuration;
+    }
+
+    bool belowLow() {
+        return bytes() <= limits.lowBytes && duration() <= limits.lowDuration;
+    }
+
+private:
+    RingBuffer<AVPacket> packets;
+    BufferLimits limits;
+    double timeBase = 0;
+    Notifier* popNotifier = nullptr;
+    std::atomic<int64_t> byteCount{0};
+    std::atomic<int64_t> lastIn{AV_NOPTS_VALUE};
+    std::atomic<int64_t> lastOut{AV_NOPTS_VALUE};
+    std::atomic<bool> throttled{false};
+};
@@ -14,24 +14,28 @@ Player::Player() {
         element->setBus(bus);
     }
 
-    demuxer.setEngine(&ffWrapper);
+    demuxer.setNextEngine(&nextWrapper);
     demuxer.setAudioSink(&audioDecoder);
     demuxer.setVideoSink(&videoDecoder);
 
-    videoDecoder.setEngine(&ffWrapper);
     videoDecoder.setSource(&demuxer);
     videoDecoder.setVideoSink(&videoRender);
-    videoRender.setEngine(&ffWrapper);
     videoRender.setSource(&videoDecoder);
 
-    audioDecoder.setEngine(&ffWrapper);
     audioDecoder.setSource(&demuxer);
     audioDecoder.setAudioSink(&audioRender);
-    audioRender.setEngine(&ffWrapper);
     audioRender.setSource(&audioDecoder);
+
+    setEngine(&ffWrapper);
+
+    demuxer.setStartupTimer(&startupTimer);
+    videoDecoder.setStartupTimer(&startupTimer);
+    videoRender.setStartupTimer(&startupTimer);
 }
 
 Player::~Player() {
+    // the element threads use the bus and the engine until they are stopped
+    stop();
     delete bus;
     elememts.clear();
 }
@@ -47,6 +51,37 @@ void Player::setDataSource(const char* url) {
     demuxer.setSource(url);
 }
 
+bool Player::setDataSource(ByteSource* source, const char* name) {
+    if (!validStates()) {
+        return false;
+    }
+    State s = elememts[0]->getState();
+    if (s != STATE_NULL) {
+        return false;
+    }
+    demuxer.setSource(source, name);
+    return true;
+}
+
+void Player::appendDataSource(const char* url) {
+    demuxer.appendSource(url);
+}
+
+void Player::clearPlaylist() {
+    demuxer.clearSources();
+}
+
+void Player::setIndexDirectory(const char* directory) {
+    if (!validStates()) {
+        return;
+    }
+    State s = elememts[0]->getState();
+    if (s != STATE_NULL) {
+        return;
+    }
+    demuxer.setIndexDirectory(directory);
+}
+
 void Player::setSurface(jobject surface) {
     videoRender.setSurface(surface);
 }
@@ -57,6 +92,9 @@ void Player::play() {
     }
     State ss[] = {STATE_NULL, STATE_READY, STATE_PAUSED, STATE_PLAYING};
     State i = elememts[0]->getState();
+    if (i == STATE_NULL) {
+        startupTimer.start();
+    }
     while (i < STATE_PLAYING) {
         for (Element* e : elememts) {
             e->setState(ss[i+1]);
@@ -83,6 +121,8 @@ void Player::stop() {
         }
         i = ss[i-1];
     }
+    // the elements may have been stopped halfway through a switch to the next source
+    setEngine(demuxer.getEngine());
 }
 
 void Player::pause() {
@@ -117,14 +157,30 @@ void Player::seek(int position) {
     }
     State ss[] = {STATE_NULL, STATE_READY, STATE_PAUSED, STATE_PLAYING};
     State i = elememts[0]->getState();
-    while (i > STATE_READY) {
+    if (i >= STATE_PAUSED) {
+        // NOTES: seek in place, the elements are flushed from upstream to downstream and each
+        //        one holds until the engine has seeked, then resumed from downstream to upstream
+        Event flushStart(EVENT_FLUSH_START);
+        flushStart.value = monotonicTime();
         for (Element* e : elememts) {
-            e->setState(ss[i-1]);
-            if (e->getState() != ss[i-1]) {
-                return;
-            }
+            sendEventAndWait(e, flushStart);
         }
-        i = ss[i-1];
+        int64_t target = int64_t(position)*1000;
+        int64_t resumed = target;
+        if (!demuxer.seek(position)) {
+            resumed = clock->runningTime();
+        } else if (seekMode != SEEK_MODE_ACCURATE) {
+            resumed = int64_t(demuxer.getKeyframePosition(position))*1000;
+        }
+        // the audio render sets the clock again with its first frame
+        clock->setOffset(resumed);
+        Event flushStop(EVENT_FLUSH_STOP);
+        flushStop.value = seekMode == SEEK_MODE_ACCURATE ? target : -1;
+        for (auto it = elememts.rbegin(); it != elememts.rend(); ++it) {
+            sendEventAndWait(*it, flushStop);
+        }
+        LOGI("seek: position=%dms, resumed at %lldms", position, (long long)resumed/1000);
+        return;
     }
     while (i < STATE_READY) {
         for (Element* e : elememts) {
@@ -138,6 +194,55 @@ void Player::seek(int position) {
     demuxer.seek(position);
 }
 
+void Player::setSeekMode(int mode) {
+    seekMode = mode;
+}
+
+void Player::setVideoScaleQuality(int quality) {
+    ffWrapper.setVideoScaleQuality(quality);
+    nextWrapper.setVideoScaleQuality(quality);
+}
+
+void Player::setFastStart(bool enabled) {
+    if (!validStates()) {
+        return;
+    }
+    State s = elememts[0]->getState();
+    if (s != STATE_NULL) {
+        return;
+    }
+    ffWrapper.setFastStart(enabled);
+    nextWrapper.setFastStart(enabled);
+}
+
+void Player::setInputConfig(const InputConfig& config) {
+    if (!validStates()) {
+        return;
+    }
+    State s = elememts[0]->getState();
+    if (s != STATE_NULL) {
+        return;
+    }
+    ffWrapper.setInputConfig(config);
+    nextWrapper.setInputConfig(config);
+}
+
+void Player::setCacheDirectory(const char* directory, int64_t capacity) {
+    if (!validStates()) {
+        return;
+    }
+    State s = elememts[0]->getState();
+    if (s != STATE_NULL) {
+        return;
+    }
+    ChunkCache* cache = nullptr;
+    if (directory && *directory && ChunkCache::instance().open(directory, capacity)) {
+        cache = &ChunkCache::instance();
+    }
+    ffWrapper.setChunkCache(cache);
+    nextWrapper.setChunkCache(cache);
+}
+
 int Player::getDuration() {
     if (demuxer.getState() >= STATE_READY) {
         return demuxer.getDuration();
@@ -156,6 +261,36 @@ int Player::getPosition() {
     return clock->runningTime()/1000;
 }
 
+int Player::getStartupTime(int phase) {
+    if (phase < 0 || phase >= STARTUP_PHASES) {
+        return -1;
+    }
+    int64_t elapsed = startupTimer.elapsed(phase);
+    return elapsed < 0 ? -1 : int(elapsed/1000);
+}
+
+QoSStats Player::getQoSStats() {
+    return videoDecoder.qosStats();
+}
+
+bool Player::sendEventAndWait(Element* element, Event event) {
+    Notifier handled;
+    event.data = &handled;
+    if (element->onEvent(event) != STATUS_SUCCESS) {
+        return false;
+    }
+    handled.wait();
+    return true;
+}
+
+void Player::setEngine(FFWrapper* engine) {
+    demuxer.setEngine(engine);
+    videoDecoder.setEngine(engine);
+    videoRender.setEngine(engine);
+    audioDecoder.setEngine(engine);
+    audioRender.setEngine(engine);
+}
+
 bool Player::validStates() {
     State s = elememts[0]->getState();
     for (int i=1; i < elememts.size(); i++) {
@@ -8,37 +8,83 @@
 #include "audio_render.h"
 #include "video_decoder.h"
 #include "video_render.h"
+#include "startup_timer.h"
 #include "player.h"
 
+// Seek modes
+#define SEEK_MODE_KEYFRAME  0   // resume from the keyframe at or before the position, fast
+#define SEEK_MODE_ACCURATE  1   // decode from that keyframe, but resume exactly at the position
+
+// Video quality of service stats, the indexes of Player.getQoSStats(), see QoSStats
+#define QOS_LEVEL                   0   // the current skip level, SKIP_LEVEL_XXX
+#define QOS_REPORTS                 1
+#define QOS_LEVEL_CHANGES           2
+#define QOS_FILTER_SKIPPED_FRAMES   3
+#define QOS_DECODER_SKIPPED_FRAMES  4
+#define QOS_SKIPPED_PACKETS         5
+#define QOS_STATS                   6
+
+//
+// One media session: its own FFWrapper, elements, clock and bus, so several players can run at the
+// same time. The thread pool and the frame pool are process wide and shared by all of them.
+//
 struct Player {
-    static Player& instance() {
-        static Player player;
-        return player;
-    }
+    Player();
+    // NOTES: stops the player first
+    ~Player();
+    Player(const Player&) = delete;
+    Player& operator=(const Player&) = delete;
+
     void setDataSource(const char* url);
+    // NOTES: source must outlive the next stop(), name keys the stream parameters cached by a fast
+    //        start and may be empty. returns false if not in STATE_NULL
+    bool setDataSource(ByteSource* source, const char* name);
+    // NOTES: the playlist, sources appended are played one after the other without a gap once the
+    //        data source ends. the next one is opened and decoded ahead while the one before it plays
+    void appendDataSource(const char* url);
+    void clearPlaylist();
+    void setIndexDirectory(const char* directory);
     void setSurface(jobject surface);
     void play();
     void stop();
     void pause();
     void seek(int position);
+    void setSeekMode(int mode);
+    void setVideoScaleQuality(int quality);
+    // NOTES: should be called in STATE_NULL, see FFWrapper::setFastStart()
+    void setFastStart(bool enabled);
+    // NOTES: should be called in STATE_NULL, how local files are read, see FileInput
+    void setInputConfig(const InputConfig& config);
+    // NOTES: should be called in STATE_NULL, http(s) media is cached in directory, which is shared
+    //        by all players, up to capacity bytes. nullptr plays it straight from the network
+    void setCacheDirectory(const char* directory, int64_t capacity);
     int getDuration();
     int getPosition();
-
-private:
-    Player();
-    ~Player();
+    // NOTES: in milliseconds since play() was called in STATE_NULL, until phase STARTUP_XXX was
+    //        reached, -1 if it isn't reached yet
+    int getStartupTime(int phase);
+    // NOTES: the skip counters of the video decoder since play() was called in STATE_NULL, kept
+    //        across seeks and playlist switches
+    QoSStats getQoSStats();
 
 private:
     bool validStates();
+    bool sendEventAndWait(Element* element, Event event);
+    void setEngine(FFWrapper* engine);
 
 private:
     FFWrapper ffWrapper;
+    // the engine the next source of the playlist is prerolled in, the demuxer swaps the two
+    FFWrapper nextWrapper;
     Demuxer demuxer;
     VideoDecoder videoDecoder;
     VideoRender videoRender;
     AudioDecoder audioDecoder;
     AudioRender audioRender;
-    Clock* clock = nullptr;
+    StartupTimer startupTimer;
+    // of the audio render, the clock of all elements
+    AudioDeviceClock* clock = nullptr;
     Bus* bus = nullptr;
+    int seekMode = SEEK_MODE_KEYFRAME;
     std::vector<Element*> elememts{&demuxer, &videoDecoder, &audioDecoder, &videoRender, &audioRender};
 };
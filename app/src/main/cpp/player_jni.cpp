@@ -1,17 +1,39 @@
 #include <pthread.h>
+#include <memory>
 #include "log.h"
 #include "player_jni.h"
 #include "player.h"
+#include "audio_track.h"
+#include "thumbnail_engine.h"
 
 #undef  LOG_TAG
 #define LOG_TAG  "player_jni"
 
 static pthread_key_t gThreadKey;
 static JavaVM* gJavaVM;
-static jobject gSurface;
+
+//
+// The native side of a java Player, it owns the global references of the surface and of the
+// buffer played from
+//
+struct PlayerHandle {
+    Player player;
+    jobject surface = nullptr;
+    jobject buffer = nullptr;
+    std::unique_ptr<MemorySource> memorySource;
+};
+
+static Player* toPlayer(jlong handle) {
+    PlayerHandle* h = reinterpret_cast<PlayerHandle*>(handle);
+    return h ? &h->player : nullptr;
+}
 
 JNIEnv* getJNIEnv(void) {
-    JNIEnv* env = nullptr;
+    // attached threads keep their env in the key
+    JNIEnv* env = static_cast<JNIEnv*>(pthread_getspecific(gThreadKey));
+    if (env) {
+        return env;
+    }
     int err = gJavaVM->AttachCurrentThread(&env, 0);
     if(err < 0) {
         LOGE("Failed to attach current thread");
@@ -53,67 +75,319 @@ JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void* reserved) {
     return JNI_VERSION_1_6;
 }
 
-JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeInit(JNIEnv*, jclass) {
-    // TODO: save methodID, fieldID, ...
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeInit(JNIEnv* env, jclass) {
     LOGI("Java_com_hao_player_Player_nativeInit Enter");
+    // resolve the method IDs used on the audio thread once
+    if (!initAudioTrackBindings(env)) {
+        LOGE("initAudioTrackBindings failed");
+    }
     LOGI("Java_com_hao_player_Player_nativeInit Exit");
 }
 
-JNIEXPORT void JNICALL Java_com_hao_player_Player_setSurface(JNIEnv* env, jclass, jobject surface) {
-    LOGI("Java_com_hao_player_Player_setSurface Enter");
-    gSurface = env->NewGlobalRef(surface);
-    Player::instance().setSurface(gSurface);
-    LOGI("Java_com_hao_player_Player_setSurface Exit");
+JNIEXPORT jlong JNICALL Java_com_hao_player_Player_nativeCreate(JNIEnv*, jclass) {
+    LOGI("Java_com_hao_player_Player_nativeCreate Enter");
+    PlayerHandle* h = new PlayerHandle();
+    LOGI("Java_com_hao_player_Player_nativeCreate Exit");
+    return reinterpret_cast<jlong>(h);
 }
 
-JNIEXPORT void JNICALL Java_com_hao_player_Player_setDataSource(JNIEnv* env, jclass, jstring source) {
-    LOGI("Java_com_hao_player_Player_setDataSource Enter");
-    const char* url = env->GetStringUTFChars(source, 0);
-    Player::instance().setDataSource(url);
-    env->ReleaseStringUTFChars(source, url);
-    LOGI("Java_com_hao_player_Player_setDataSource Exit");
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeRelease(JNIEnv* env, jclass, jlong handle) {
+    LOGI("Java_com_hao_player_Player_nativeRelease Enter");
+    PlayerHandle* h = reinterpret_cast<PlayerHandle*>(handle);
+    if (h) {
+        // the surface and the buffer may be in use until all threads are stopped
+        h->player.stop();
+        if (h->surface) {
+            env->DeleteGlobalRef(h->surface);
+        }
+        if (h->buffer) {
+            env->DeleteGlobalRef(h->buffer);
+        }
+        delete h;
+    }
+    LOGI("Java_com_hao_player_Player_nativeRelease Exit");
 }
 
-JNIEXPORT void JNICALL Java_com_hao_player_Player_play(JNIEnv*, jclass) {
-    LOGI("Java_com_hao_player_Player_play Enter");
-    Player::instance().play();
-    LOGI("Java_com_hao_player_Player_play Exit");
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetSurface(JNIEnv* env, jclass, jlong handle, jobject surface) {
+    LOGI("Java_com_hao_player_Player_nativeSetSurface Enter");
+    PlayerHandle* h = reinterpret_cast<PlayerHandle*>(handle);
+    if (h) {
+        jobject old = h->surface;
+        h->surface = surface ? env->NewGlobalRef(surface) : nullptr;
+        h->player.setSurface(h->surface);
+        if (old) {
+            env->DeleteGlobalRef(old);
+        }
+    }
+    LOGI("Java_com_hao_player_Player_nativeSetSurface Exit");
 }
 
-JNIEXPORT void JNICALL Java_com_hao_player_Player_pause(JNIEnv*, jclass) {
-    LOGI("Java_com_hao_player_Player_pause Enter");
-    Player::instance().pause();
-    LOGI("Java_com_hao_player_Player_pause Exit");
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetDataSource(JNIEnv* env, jclass, jlong handle, jstring source) {
+    LOGI("Java_com_hao_player_Player_nativeSetDataSource Enter");
+    Player* player = toPlayer(handle);
+    if (player) {
+        const char* url = env->GetStringUTFChars(source, 0);
+        player->setDataSource(url);
+        env->ReleaseStringUTFChars(source, url);
+    }
+    LOGI("Java_com_hao_player_Player_nativeSetDataSource Exit");
 }
 
-JNIEXPORT void JNICALL Java_com_hao_player_Player_stop(JNIEnv* env, jclass)
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetDataSourceBuffer(JNIEnv* env, jclass, jlong handle,
+    jobject buffer, jstring name)
 {
-    LOGI("Java_com_hao_player_Player_stop Enter");
-    Player::instance().stop();
-    env->DeleteGlobalRef(gSurface);
-    LOGI("Java_com_hao_player_Player_stop Exit");
+    LOGI("Java_com_hao_player_Player_nativeSetDataSourceBuffer Enter");
+    PlayerHandle* h = reinterpret_cast<PlayerHandle*>(handle);
+    const uint8_t* data = static_cast<const uint8_t*>(env->GetDirectBufferAddress(buffer));
+    jlong size = env->GetDirectBufferCapacity(buffer);
+    if (h && data && size >= 0) {
+        // played in place, the java buffer is kept alive until another one replaces it
+        std::unique_ptr<MemorySource> source(new MemorySource(data, size));
+        const char* sourceName = name ? env->GetStringUTFChars(name, 0) : nullptr;
+        bool accepted = h->player.setDataSource(source.get(), sourceName ? sourceName : "");
+        if (sourceName) {
+            env->ReleaseStringUTFChars(name, sourceName);
+        }
+        if (accepted) {
+            if (h->buffer) {
+                env->DeleteGlobalRef(h->buffer);
+            }
+            h->buffer = env->NewGlobalRef(buffer);
+            h->memorySource = std::move(source);
+        }
+    } else if (h) {
+        LOGE("nativeSetDataSourceBuffer: not a direct buffer");
+    }
+    LOGI("Java_com_hao_player_Player_nativeSetDataSourceBuffer Exit");
+}
+
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeAppendDataSource(JNIEnv* env, jclass, jlong handle, jstring source) {
+    LOGI("Java_com_hao_player_Player_nativeAppendDataSource Enter");
+    Player* player = toPlayer(handle);
+    if (player) {
+        const char* url = env->GetStringUTFChars(source, 0);
+        player->appendDataSource(url);
+        env->ReleaseStringUTFChars(source, url);
+    }
+    LOGI("Java_com_hao_player_Player_nativeAppendDataSource Exit");
+}
+
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeClearPlaylist(JNIEnv*, jclass, jlong handle) {
+    LOGI("Java_com_hao_player_Player_nativeClearPlaylist Enter");
+    Player* player = toPlayer(handle);
+    if (player) {
+        player->clearPlaylist();
+    }
+    LOGI("Java_com_hao_player_Player_nativeClearPlaylist Exit");
+}
+
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetIndexDirectory(JNIEnv* env, jclass, jlong handle, jstring directory) {
+    LOGI("Java_com_hao_player_Player_nativeSetIndexDirectory Enter");
+    Player* player = toPlayer(handle);
+    if (player) {
+        const char* path = env->GetStringUTFChars(directory, 0);
+        player->setIndexDirectory(path);
+        env->ReleaseStringUTFChars(directory, path);
+    }
+    LOGI("Java_com_hao_player_Player_nativeSetIndexDirectory Exit");
 }
 
-JNIEXPORT void JNICALL Java_com_hao_player_Player_seek(JNIEnv*, jclass, jint position)
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetCacheDirectory(JNIEnv* env, jclass, jlong handle,
+    jstring directory, jlong capacity)
 {
-    LOGI("Java_com_hao_player_Player_seek Enter");
-    Player::instance().seek(position);
-    LOGI("Java_com_hao_player_Player_seek Exit");
+    LOGI("Java_com_hao_player_Player_nativeSetCacheDirectory Enter");
+    Player* player = toPlayer(handle);
+    if (player) {
+        const char* path = directory ? env->GetStringUTFChars(directory, 0) : nullptr;
+        player->setCacheDirectory(path, capacity);
+        if (path) {
+            env->ReleaseStringUTFChars(directory, path);
+        }
+    }
+    LOGI("Java_com_hao_player_Player_nativeSetCacheDirectory Exit");
 }
 
-JNIEXPORT jint JNICALL Java_com_hao_player_Player_getDuration(JNIEnv*, jclass)
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativePlay(JNIEnv*, jclass, jlong handle) {
+    LOGI("Java_com_hao_player_Player_nativePlay Enter");
+    Player* player = toPlayer(handle);
+    if (player) {
+        player->play();
+    }
+    LOGI("Java_com_hao_player_Player_nativePlay Exit");
+}
+
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativePause(JNIEnv*, jclass, jlong handle) {
+    LOGI("Java_com_hao_player_Player_nativePause Enter");
+    Player* player = toPlayer(handle);
+    if (player) {
+        player->pause();
+    }
+    LOGI("Java_com_hao_player_Player_nativePause Exit");
+}
+
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeStop(JNIEnv*, jclass, jlong handle)
 {
-    LOGI("Java_com_hao_player_Player_getDuration Enter");
-    return Player::instance().getDuration();
-    LOGI("Java_com_hao_player_Player_getDuration Exit");
+    LOGI("Java_com_hao_player_Player_nativeStop Enter");
+    Player* player = toPlayer(handle);
+    if (player) {
+        player->stop();
+    }
+    LOGI("Java_com_hao_player_Player_nativeStop Exit");
 }
 
-JNIEXPORT jint Java_com_hao_player_Player_getPosition(JNIEnv*, jclass)
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSeek(JNIEnv*, jclass, jlong handle, jint position)
 {
-    LOGI("Java_com_hao_player_Player_getPosition Enter");
-    return Player::instance().getPosition();
-    LOGI("Java_com_hao_player_Player_getPosition Exit");
+    LOGI("Java_com_hao_player_Player_nativeSeek Enter");
+    Player* player = toPlayer(handle);
+    if (player) {
+        player->seek(position);
+    }
+    LOGI("Java_com_hao_player_Player_nativeSeek Exit");
 }
 
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetSeekMode(JNIEnv*, jclass, jlong handle, jint mode)
+{
+    LOGI("Java_com_hao_player_Player_nativeSetSeekMode Enter");
+    Player* player = toPlayer(handle);
+    if (player) {
+        player->setSeekMode(mode);
+    }
+    LOGI("Java_com_hao_player_Player_nativeSetSeekMode Exit");
+}
 
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetVideoScaleQuality(JNIEnv*, jclass, jlong handle, jint quality)
+{
+    LOGI("Java_com_hao_player_Player_nativeSetVideoScaleQuality Enter");
+    Player* player = toPlayer(handle);
+    if (player) {
+        player->setVideoScaleQuality(quality);
+    }
+    LOGI("Java_com_hao_player_Player_nativeSetVideoScaleQuality Exit");
+}
 
+JNIEXPORT jint JNICALL Java_com_hao_player_Player_nativeGetDuration(JNIEnv*, jclass, jlong handle)
+{
+    Player* player = toPlayer(handle);
+    return player ? player->getDuration() : 0;
+}
+
+JNIEXPORT jint JNICALL Java_com_hao_player_Player_nativeGetPosition(JNIEnv*, jclass, jlong handle)
+{
+    Player* player = toPlayer(handle);
+    return player ? player->getPosition() : 0;
+}
+
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetFastStart(JNIEnv*, jclass, jlong handle, jboolean enabled)
+{
+    LOGI("Java_com_hao_player_Player_nativeSetFastStart Enter");
+    Player* player = toPlayer(handle);
+    if (player) {
+        player->setFastStart(enabled);
+    }
+    LOGI("Java_com_hao_player_Player_nativeSetFastStart Exit");
+}
+
+JNIEXPORT jintArray JNICALL Java_com_hao_player_Player_nativeGetStartupTimes(JNIEnv* env, jclass, jlong handle)
+{
+    Player* player = toPlayer(handle);
+    jint times[STARTUP_PHASES];
+    for (int i = 0; i < STARTUP_PHASES; i++) {
+        times[i] = player ? player->getStartupTime(i) : -1;
+    }
+    jintArray result = env->NewIntArray(STARTUP_PHASES);
+    if (result) {
+        env->SetIntArrayRegion(result, 0, STARTUP_PHASES, times);
+    }
+    return result;
+}
+
+JNIEXPORT jlongArray JNICALL Java_com_hao_player_Player_nativeGetQoSStats(JNIEnv* env, jclass, jlong handle)
+{
+    Player* player = toPlayer(handle);
+    QoSStats qos = player ? player->getQoSStats() : QoSStats();
+    jlong stats[QOS_STATS];
+    stats[QOS_LEVEL] = qos.level;
+    stats[QOS_REPORTS] = qos.reports;
+    stats[QOS_LEVEL_CHANGES] = qos.levelChanges;
+    stats[QOS_FILTER_SKIPPED_FRAMES] = qos.filterSkippedFrames();
+    stats[QOS_DECODER_SKIPPED_FRAMES] = qos.decoderSkippedFrames();
+    stats[QOS_SKIPPED_PACKETS] = qos.skippedPackets;
+    jlongArray result = env->NewLongArray(QOS_STATS);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, QOS_STATS, stats);
+    }
+    return result;
+}
+
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetInputMode(JNIEnv*, jclass, jlong handle, jint mode,
+    jint blockSize, jint blockCount)
+{
+    LOGI("Java_com_hao_player_Player_nativeSetInputMode Enter");
+    Player* player = toPlayer(handle);
+    if (player) {
+        InputConfig config;
+        config.mode = mode;
+        if (blockSize > 0) {
+            config.blockSize = blockSize;
+        }
+        if (blockCount > 0) {
+            config.blockCount = blockCount;
+        }
+        player->setInputConfig(config);
+    }
+    LOGI("Java_com_hao_player_Player_nativeSetInputMode Exit");
+}
+
+JNIEXPORT jlong JNICALL Java_com_hao_player_ThumbnailEngine_nativeCreate(JNIEnv*, jclass, jint workers) {
+    LOGI("Java_com_hao_player_ThumbnailEngine_nativeCreate Enter");
+    ThumbnailEngine* engine = new ThumbnailEngine(workers);
+    LOGI("Java_com_hao_player_ThumbnailEngine_nativeCreate Exit");
+    return reinterpret_cast<jlong>(engine);
+}
+
+JNIEXPORT void JNICALL Java_com_hao_player_ThumbnailEngine_nativeRelease(JNIEnv*, jclass, jlong handle) {
+    LOGI("Java_com_hao_player_ThumbnailEngine_nativeRelease Enter");
+    delete reinterpret_cast<ThumbnailEngine*>(handle);
+    LOGI("Java_com_hao_player_ThumbnailEngine_nativeRelease Exit");
+}
+
+JNIEXPORT jboolean JNICALL Java_com_hao_player_ThumbnailEngine_nativeOpen(JNIEnv* env, jclass, jlong handle, jstring source) {
+    LOGI("Java_com_hao_player_ThumbnailEngine_nativeOpen Enter");
+    ThumbnailEngine* engine = reinterpret_cast<ThumbnailEngine*>(handle);
+    bool opened = false;
+    if (engine && source) {
+        const char* url = env->GetStringUTFChars(source, 0);
+        opened = engine->open(url);
+        env->ReleaseStringUTFChars(source, url);
+    }
+    LOGI("Java_com_hao_player_ThumbnailEngine_nativeOpen Exit");
+    return opened;
+}
+
+JNIEXPORT jint JNICALL Java_com_hao_player_ThumbnailEngine_nativeGetDuration(JNIEnv*, jclass, jlong handle)
+{
+    ThumbnailEngine* engine = reinterpret_cast<ThumbnailEngine*>(handle);
+    return engine ? engine->getDuration() : 0;
+}
+
+// NOTES: the RGBA pixels of the sprite, the layout of an ARGB_8888 Bitmap, and the position of
+//        each tile into positions. null if no thumbnail could be made
+JNIEXPORT jbyteArray JNICALL Java_com_hao_player_ThumbnailEngine_nativeGenerate(JNIEnv* env, jclass, jlong handle,
+    jint count, jint tileWidth, jint tileHeight, jint columns, jintArray positions)
+{
+    LOGI("Java_com_hao_player_ThumbnailEngine_nativeGenerate Enter");
+    ThumbnailEngine* engine = reinterpret_cast<ThumbnailEngine*>(handle);
+    Sprite sprite;
+    jbyteArray pixels = nullptr;
+    if (engine && engine->generate(count, tileWidth, tileHeight, columns, &sprite)) {
+        pixels = env->NewByteArray(sprite.pixels.size());
+        if (pixels) {
+            env->SetByteArrayRegion(pixels, 0, sprite.pixels.size(), reinterpret_cast<const jbyte*>(sprite.pixels.data()));
+        }
+        if (positions && env->GetArrayLength(positions) >= count) {
+            env->SetIntArrayRegion(positions, 0, count, reinterpret_cast<const jint*>(sprite.positions.data()));
+        }
+    }
+    LOGI("Java_com_hao_player_ThumbnailEngine_nativeGenerate Exit");
+    return pixels;
+}
@@ -7,14 +7,33 @@ extern "C" {
 #endif
 
 JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeInit(JNIEnv*, jclass);
-JNIEXPORT void JNICALL Java_com_hao_player_Player_setSurface(JNIEnv*, jclass, jobject);
-JNIEXPORT void JNICALL Java_com_hao_player_Player_setDataSource(JNIEnv*, jclass, jstring);
-JNIEXPORT void JNICALL Java_com_hao_player_Player_play(JNIEnv*, jclass);
-JNIEXPORT void JNICALL Java_com_hao_player_Player_pause(JNIEnv*, jclass);
-JNIEXPORT void JNICALL Java_com_hao_player_Player_stop(JNIEnv*, jclass);
-JNIEXPORT void JNICALL Java_com_hao_player_Player_seek(JNIEnv*, jclass, jint);
-JNIEXPORT jint JNICALL Java_com_hao_player_Player_getDuration(JNIEnv*, jclass);
-JNIEXPORT jint JNICALL Java_com_hao_player_Player_getPosition(JNIEnv*, jclass);
+JNIEXPORT jlong JNICALL Java_com_hao_player_Player_nativeCreate(JNIEnv*, jclass);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeRelease(JNIEnv*, jclass, jlong);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetSurface(JNIEnv*, jclass, jlong, jobject);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetDataSource(JNIEnv*, jclass, jlong, jstring);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetDataSourceBuffer(JNIEnv*, jclass, jlong, jobject, jstring);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeAppendDataSource(JNIEnv*, jclass, jlong, jstring);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeClearPlaylist(JNIEnv*, jclass, jlong);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetIndexDirectory(JNIEnv*, jclass, jlong, jstring);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetCacheDirectory(JNIEnv*, jclass, jlong, jstring, jlong);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativePlay(JNIEnv*, jclass, jlong);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativePause(JNIEnv*, jclass, jlong);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeStop(JNIEnv*, jclass, jlong);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSeek(JNIEnv*, jclass, jlong, jint);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetSeekMode(JNIEnv*, jclass, jlong, jint);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetVideoScaleQuality(JNIEnv*, jclass, jlong, jint);
+JNIEXPORT jint JNICALL Java_com_hao_player_Player_nativeGetDuration(JNIEnv*, jclass, jlong);
+JNIEXPORT jint JNICALL Java_com_hao_player_Player_nativeGetPosition(JNIEnv*, jclass, jlong);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetFastStart(JNIEnv*, jclass, jlong, jboolean);
+JNIEXPORT jintArray JNICALL Java_com_hao_player_Player_nativeGetStartupTimes(JNIEnv*, jclass, jlong);
+JNIEXPORT jlongArray JNICALL Java_com_hao_player_Player_nativeGetQoSStats(JNIEnv*, jclass, jlong);
+JNIEXPORT void JNICALL Java_com_hao_player_Player_nativeSetInputMode(JNIEnv*, jclass, jlong, jint, jint, jint);
+
+JNIEXPORT jlong JNICALL Java_com_hao_player_ThumbnailEngine_nativeCreate(JNIEnv*, jclass, jint);
+JNIEXPORT void JNICALL Java_com_hao_player_ThumbnailEngine_nativeRelease(JNIEnv*, jclass, jlong);
+JNIEXPORT jboolean JNICALL Java_com_hao_player_ThumbnailEngine_nativeOpen(JNIEnv*, jclass, jlong, jstring);
+JNIEXPORT jint JNICALL Java_com_hao_player_ThumbnailEngine_nativeGetDuration(JNIEnv*, jclass, jlong);
+JNIEXPORT jbyteArray JNICALL Java_com_hao_player_ThumbnailEngine_nativeGenerate(JNIEnv*, jclass, jlong, jint, jint, jint, jint, jintArray);
 
 #ifdef __cplusplus
 }
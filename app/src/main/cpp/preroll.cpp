@@ -0,0 +1,150 @@
+#include "log.h"
+#include "clock.h"
+#include "preroll.h"
+
+#undef  LOG_TAG
+#define LOG_TAG "Preroll"
+
+// NOTES: enough to start both renders at once, in frames and microseconds
+#define PREROLL_VIDEO_FRAMES        2
+#define PREROLL_AUDIO_DURATION      300000
+// a source whose first frames are not within this many packets is switched to as it is
+#define PREROLL_MAX_PACKETS         512
+
+
+void Preroll::start(FFWrapper* engine, const std::string& url, Notifier* done) {
+    cancel();
+    this->engine = engine;
+    this->url = url;
+    notifier = done;
+    cancelled.store(false);
+    this->done.store(false);
+    opened = false;
+    audioDuration = 0;
+    prerollStats = PrerollStats();
+    prerollThread = std::thread(&Preroll::prerolling, this);
+}
+
+void Preroll::cancel() {
+    if (!engine) {
+        return;
+    }
+    cancelled.store(true);
+    if (prerollThread.joinable()) {
+        prerollThread.join();
+    }
+    freeFrames();
+    engine->close();
+    engine = nullptr;
+    done.store(false);
+}
+
+void Preroll::reset() {
+    if (prerollThread.joinable()) {
+        prerollThread.join();
+    }
+    freeFrames();
+    engine = nullptr;
+    done.store(false);
+}
+
+void Preroll::takeVideoFrames(std::deque<AVFrame*>& frames) {
+    frames.insert(frames.end(), videoFrames.begin(), videoFrames.end());
+    videoFrames.clear();
+}
+
+void Preroll::takeAudioFrames(std::deque<AVFrame*>& frames) {
+    frames.insert(frames.end(), audioFrames.begin(), audioFrames.end());
+    audioFrames.clear();
+    for (AVPacket& packet : videoPackets) {
+        FFWrapper::freePacket(packet);
+    }
+    videoPackets.clear();
+}
+
+void Preroll::takeVideoPackets(std::deque<AVPacket>& packets) {
+    packets.insert(packets.end(), videoPackets.begin(), videoPackets.end());
+    videoPackets.clear();
+}
+
+void Preroll::prerolling() {
+    LOGD("prerolling: thread started, %s", url.c_str());
+    int64_t start = monotonicTime();
+    opened = engine->open(url.c_str());
+    prerollStats.openTime = monotonicTime() - start;
+    if (!opened) {
+        LOGE("prerolling: can't open %s", url.c_str());
+        engine->close();
+    }
+
+    // decode the first frames the same way the decoders would. once the video frames are enough
+    // the video packets are held while the audio prerolls on, and decoded after the switch
+    int64_t decodeStart = monotonicTime();
+    while (opened && !cancelled.load() && prerollStats.packets < PREROLL_MAX_PACKETS &&
+        (int(videoFrames.size()) < PREROLL_VIDEO_FRAMES || audioDuration < PREROLL_AUDIO_DURATION)) {
+        AVPacket packet;
+        bool isEOF = false;
+        if (!engine->readPacket(packet, &isEOF)) {
+            if (isEOF) {
+                break;
+            }
+            continue;
+        }
+        prerollStats.packets++;
+        bool video = engine->isVideo(packet);
+        if (video && int(videoFrames.size()) >= PREROLL_VIDEO_FRAMES) {
+            videoPackets.push_back(packet);
+            continue;
+        }
+        if (video || engine->isAudio(packet)) {
+            bool sent = video ? engine->sendVideoPacket(&packet) : engine->sendAudioPacket(&packet);
+            if (sent) {
+                receiveFrames(video);
+            }
+        }
+        engine->freePacket(packet);
+    }
+    prerollStats.decodeTime = monotonicTime() - decodeStart;
+    prerollStats.videoFrames = videoFrames.size();
+    prerollStats.audioFrames = audioFrames.size();
+    prerollStats.heldPackets = videoPackets.size();
+    LOGI("prerolling: %s %s, open=%lldms, decode=%lldms, packets=%d, video_frames=%d, held=%d, audio=%lldms",
+        url.c_str(), opened ? "ready" : "failed", (long long)prerollStats.openTime/1000,
+        (long long)prerollStats.decodeTime/1000, prerollStats.packets, prerollStats.videoFrames,
+        prerollStats.heldPackets, (long long)audioDuration/1000);
+    done.store(true);
+    if (notifier) {
+        notifier->notify();
+    }
+}
+
+void Preroll::receiveFrames(bool video) {
+    AVFrame* frame = nullptr;
+    // NOTES: video frames past the ones needed stay in the codec, the decoder receives them next
+    while (!(video && int(videoFrames.size()) >= PREROLL_VIDEO_FRAMES) &&
+        (video ? engine->receiveVideoFrame(&frame) : engine->receiveAudioFrame(&frame))) {
+        if (video) {
+            videoFrames.push_back(frame);
+            continue;
+        }
+        if (frame->sample_rate > 0) {
+            audioDuration += int64_t(frame->nb_samples)*1000000/frame->sample_rate;
+        }
+        audioFrames.push_back(frame);
+    }
+}
+
+void Preroll::freeFrames() {
+    for (AVFrame* frame : videoFrames) {
+        FFWrapper::freeFrame(frame);
+    }
+    videoFrames.clear();
+    for (AVFrame* frame : audioFrames) {
+        FFWrapper::freeFrame(frame);
+    }
+    audioFrames.clear();
+    for (AVPacket& packet : videoPackets) {
+        FFWrapper::freePacket(packet);
+    }
+    videoPackets.clear();
+}
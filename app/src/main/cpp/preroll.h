@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include "ffwrapper.h"
+#include "utils.h"
+
+// The flags of the elements which switched to the next source, see EVENT_SOURCE_SWITCHED
+#define SWITCHED_VIDEO_DECODER  0x01
+#define SWITCHED_AUDIO_DECODER  0x02
+#define SWITCHED_VIDEO_RENDER   0x04
+#define SWITCHED_AUDIO_RENDER   0x08
+#define SWITCHED_DECODERS       (SWITCHED_VIDEO_DECODER | SWITCHED_AUDIO_DECODER)
+#define SWITCHED_ALL            (SWITCHED_DECODERS | SWITCHED_VIDEO_RENDER | SWITCHED_AUDIO_RENDER)
+
+struct PrerollStats {
+    // NOTES: in microseconds
+    int64_t openTime = 0;
+    int64_t decodeTime = 0;
+    int packets = 0;
+    int videoFrames = 0;
+    int audioFrames = 0;
+    // video packets read after the video frames were enough, not decoded yet
+    int heldPackets = 0;
+};
+
+//
+// The next source of a gapless playlist. Its engine is opened, probed and decoded up to its first
+// frames on a background thread while the current source plays. At the end of the current source
+// the elements switch to it one after the other, each once it has passed on its last data of the
+// current source: the demuxer sends EVENT_SWITCH_SOURCE to the decoders, which drain their codecs,
+// pass the event on to the renders and continue with the frames decoded here.
+//
+class Preroll {
+public:
+    ~Preroll() {
+        cancel();
+    }
+
+    // NOTES: engine should be closed, done is notified once the preroll finished
+    void start(FFWrapper* engine, const std::string& url, Notifier* done);
+    // NOTES: stops the preroll, frees the frames not taken and closes the engine
+    void cancel();
+    // NOTES: forgets a finished preroll whose engine is in use now
+    void reset();
+
+    bool isStarted() {
+        return engine != nullptr;
+    }
+    bool isDone() {
+        return done.load();
+    }
+    // NOTES: done and the engine is open
+    bool isReady() {
+        return done.load() && opened;
+    }
+    FFWrapper* getEngine() {
+        return engine;
+    }
+    const std::string& getUrl() {
+        return url;
+    }
+    // NOTES: the frames decoded ahead in presentation order, they belong to the caller afterwards.
+    //        should be called once the preroll is done
+    void takeVideoFrames(std::deque<AVFrame*>& frames);
+    void takeAudioFrames(std::deque<AVFrame*>& frames);
+    // NOTES: the video packets to decode after those frames, before the ones demuxed next
+    void takeVideoPackets(std::deque<AVPacket>& packets);
+    PrerollStats stats() {
+        return prerollStats;
+    }
+
+private:
+    void prerolling();
+    void receiveFrames(bool video);
+    void freeFrames();
+
+private:
+    FFWrapper* engine = nullptr;
+    std::string url;
+    Notifier* notifier = nullptr;
+    std::thread prerollThread;
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> done{false};
+    bool opened = false;
+    // in microseconds
+    int64_t audioDuration = 0;
+    std::deque<AVFrame*> videoFrames;
+    std::deque<AVFrame*> audioFrames;
+    std::deque<AVPacket> videoPackets;
+    PrerollStats prerollStats;
+};
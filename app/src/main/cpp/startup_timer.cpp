@@ -0,0 +1,44 @@
+#include <algorithm>
+#include "log.h"
+#include "clock.h"
+#include "startup_timer.h"
+
+#undef  LOG_TAG
+#define LOG_TAG "StartupTimer"
+
+
+void StartupTimer::start() {
+    for (int i = 0; i < STARTUP_PHASES; i++) {
+        times[i].store(-1);
+    }
+    startTime.store(monotonicTime());
+}
+
+void StartupTimer::mark(int phase, int64_t time) {
+    if (times[phase].load() >= 0) {
+        return;
+    }
+    int64_t unmarked = -1;
+    if (!times[phase].compare_exchange_strong(unmarked, time < 0 ? monotonicTime() : time)) {
+        return;
+    }
+    if (phase == STARTUP_FIRST_DISPLAYED) {
+        dump();
+    }
+}
+
+void StartupTimer::dump() {
+    // each phase as the time since the one before, the ones not reached count as 0
+    int64_t phases[STARTUP_PHASES];
+    int64_t last = 0;
+    for (int i = 0; i < STARTUP_PHASES; i++) {
+        int64_t t = elapsed(i);
+        phases[i] = t < 0 ? 0 : std::max(t - last, int64_t(0));
+        last = std::max(t, last);
+    }
+    LOGI("time to first frame %lldms: open=%lldms, probe=%lldms, codec_init=%lldms, first_packet=%lldms, first_decoded=%lldms, first_displayed=%lldms",
+        (long long)elapsed(STARTUP_FIRST_DISPLAYED)/1000, (long long)phases[STARTUP_OPENED]/1000,
+        (long long)phases[STARTUP_PROBED]/1000, (long long)phases[STARTUP_CODECS_OPENED]/1000,
+        (long long)phases[STARTUP_FIRST_PACKET]/1000, (long long)phases[STARTUP_FIRST_DECODED]/1000,
+        (long long)phases[STARTUP_FIRST_DISPLAYED]/1000);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Startup phases, in the order they are reached
+#define STARTUP_OPENED          0   // the container is opened
+#define STARTUP_PROBED          1   // the stream parameters are known
+#define STARTUP_CODECS_OPENED   2
+#define STARTUP_FIRST_PACKET    3
+#define STARTUP_FIRST_DECODED   4   // the first video frame is decoded
+#define STARTUP_FIRST_DISPLAYED 5   // the first video frame is posted to the surface
+#define STARTUP_PHASES          6
+
+//
+// Time to first frame of a session, broken down by phase. The elements mark the phases they reach
+// from their own threads, only the first mark of each phase after start() counts. The breakdown is
+// logged once the first frame is displayed.
+//
+class StartupTimer {
+public:
+    StartupTimer() {
+        start();
+    }
+
+    // NOTES: the phases are measured from now on
+    void start();
+    // NOTES: time defaults to now, cheap to call again for a phase already marked
+    void mark(int phase, int64_t time = -1);
+    // NOTES: in microseconds since start(), -1 if the phase isn't reached yet
+    int64_t elapsed(int phase) {
+        int64_t time = times[phase].load();
+        return time < 0 ? -1 : time - startTime.load();
+    }
+
+private:
+    void dump();
+
+private:
+    std::atomic<int64_t> startTime{0};
+    std::atomic<int64_t> times[STARTUP_PHASES];
+};
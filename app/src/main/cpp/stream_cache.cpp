@@ -0,0 +1,120 @@
+#include <sys/stat.h>
+#include "log.h"
+#include "stream_cache.h"
+
+#undef  LOG_TAG
+#define LOG_TAG "StreamCache"
+
+
+static CachedStream saveStream(AVFormatContext* formatContext, int index) {
+    CachedStream cached;
+    if (index < 0) {
+        return cached;
+    }
+    AVStream* stream = formatContext->streams[index];
+    std::shared_ptr<AVCodecParameters> codecpar(avcodec_parameters_alloc(),
+        [](AVCodecParameters* p) { avcodec_parameters_free(&p); });
+    if (!codecpar || avcodec_parameters_copy(codecpar.get(), stream->codecpar) < 0) {
+        return cached;
+    }
+    cached.index = index;
+    cached.codecpar = codecpar;
+    cached.avgFrameRate = stream->avg_frame_rate;
+    cached.startTime = stream->start_time;
+    cached.duration = stream->duration;
+    return cached;
+}
+
+static bool matchStream(AVFormatContext* formatContext, const CachedStream& cached) {
+    if (cached.index < 0) {
+        return true;
+    }
+    AVCodecParameters* codecpar = formatContext->streams[cached.index]->codecpar;
+    return cached.codecpar && codecpar->codec_type == cached.codecpar->codec_type &&
+        codecpar->codec_id == cached.codecpar->codec_id;
+}
+
+static void applyStream(AVFormatContext* formatContext, const CachedStream& cached) {
+    if (cached.index < 0) {
+        return;
+    }
+    AVStream* stream = formatContext->streams[cached.index];
+    // the same source, these only complete what its header told, like the pixel and sample formats
+    avcodec_parameters_copy(stream->codecpar, cached.codecpar.get());
+    if (stream->avg_frame_rate.num == 0) {
+        stream->avg_frame_rate = cached.avgFrameRate;
+    }
+    if (stream->start_time == AV_NOPTS_VALUE) {
+        stream->start_time = cached.startTime;
+    }
+    if (stream->duration == AV_NOPTS_VALUE) {
+        stream->duration = cached.duration;
+    }
+}
+
+std::string StreamCache::key(const char* url) {
+    std::string key = url;
+    std::string path = key.compare(0, 5, "file:") == 0 ? key.substr(5) : key;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+        key += "|" + std::to_string((long long)st.st_size) + "|" + std::to_string((long long)st.st_mtime);
+    }
+    return key;
+}
+
+void StreamCache::put(const std::string& key, AVFormatContext* formatContext, int videoIndex, int audioIndex) {
+    // formats without a header, like mpegts, only know their streams after reading packets
+    if (formatContext->ctx_flags & AVFMTCTX_NOHEADER) {
+        return;
+    }
+    Entry entry;
+    entry.key = key;
+    entry.streams = formatContext->nb_streams;
+    entry.startTime = formatContext->start_time;
+    entry.duration = formatContext->duration;
+    entry.video = saveStream(formatContext, videoIndex);
+    entry.audio = saveStream(formatContext, audioIndex);
+    if ((videoIndex >= 0 && !entry.video.codecpar) || (audioIndex >= 0 && !entry.audio.codecpar)) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m);
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->key == key) {
+            entries.erase(it);
+            break;
+        }
+    }
+    entries.push_front(entry);
+    if (entries.size() > capacity) {
+        entries.pop_back();
+    }
+}
+
+bool StreamCache::apply(const std::string& key, AVFormatContext* formatContext, int* videoIndex, int* audioIndex) {
+    std::unique_lock<std::mutex> lock(m);
+    auto it = entries.begin();
+    while (it != entries.end() && it->key != key) {
+        ++it;
+    }
+    if (it == entries.end()) {
+        return false;
+    }
+    if (formatContext->nb_streams != it->streams ||
+        !matchStream(formatContext, it->video) || !matchStream(formatContext, it->audio)) {
+        LOGW("apply: the streams of %s changed", key.c_str());
+        entries.erase(it);
+        return false;
+    }
+    entries.splice(entries.begin(), entries, it);
+    applyStream(formatContext, it->video);
+    applyStream(formatContext, it->audio);
+    if (formatContext->start_time == AV_NOPTS_VALUE) {
+        formatContext->start_time = it->startTime;
+    }
+    if (formatContext->duration == AV_NOPTS_VALUE) {
+        formatContext->duration = it->duration;
+    }
+    *videoIndex = it->video.index;
+    *audioIndex = it->audio.index;
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+struct CachedStream {
+    int index = -1;
+    std::shared_ptr<AVCodecParameters> codecpar;
+    AVRational avgFrameRate = {0, 1};
+    int64_t startTime = AV_NOPTS_VALUE;
+    int64_t duration = AV_NOPTS_VALUE;
+};
+
+//
+// The stream parameters avformat_find_stream_info() found for the sources opened before, so a
+// source opened again can skip probing. Shared by all players, the least recently used sources
+// are dropped first. Local files are known by their path, size and modification time, so a file
+// replaced in between is probed again.
+//
+class StreamCache {
+public:
+    static StreamCache& instance() {
+        static StreamCache cache;
+        return cache;
+    }
+
+    StreamCache(size_t capacity = 32) : capacity(capacity) {}
+
+    static std::string key(const char* url);
+    // NOTES: keeps the parameters of the video and audio streams of a probed source
+    void put(const std::string& key, AVFormatContext* formatContext, int videoIndex, int audioIndex);
+    // NOTES: fills the streams of a source just opened with the parameters kept for it, false if none
+    //        are kept or they don't match its streams. should be called before the first packet is read
+    bool apply(const std::string& key, AVFormatContext* formatContext, int* videoIndex, int* audioIndex);
+
+private:
+    struct Entry {
+        std::string key;
+        unsigned int streams = 0;
+        int64_t startTime = AV_NOPTS_VALUE;
+        int64_t duration = AV_NOPTS_VALUE;
+        CachedStream video;
+        CachedStream audio;
+    };
+
+private:
+    std::mutex m;
+    // most recently used first
+    std::list<Entry> entries;
+    size_t capacity;
+};
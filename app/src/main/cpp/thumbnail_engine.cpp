@@ -0,0 +1,249 @@
+#include <string.h>
+#include <thread>
+#include <algorithm>
+#include "log.h"
+#include "clock.h"
+#include "thumbnail_engine.h"
+
+#undef  LOG_TAG
+#define LOG_TAG "ThumbnailEngine"
+
+#define THUMBNAIL_MAX_WORKERS   4
+// a keyframe is expected within this many video packets after a seek
+#define MAX_SEEK_PACKETS        256
+
+
+ThumbnailEngine::ThumbnailEngine(int workers) {
+    if (workers <= 0) {
+        workers = std::min(THUMBNAIL_MAX_WORKERS, std::max(1, int(std::thread::hardware_concurrency())));
+    }
+    this->workers = workers;
+}
+
+ThumbnailEngine::~ThumbnailEngine() {
+    close();
+}
+
+bool ThumbnailEngine::open(const std::string& url) {
+    close();
+    this->url = url;
+    FFWrapper* session = openSession(0, 0);
+    if (!session) {
+        return false;
+    }
+    if (session->duration() != AV_NOPTS_VALUE) {
+        duration = session->duration()*1000/AV_TIME_BASE;
+    }
+    // the worker sessions are opened for the tile size of each sprite
+    session->close();
+    delete session;
+    return true;
+}
+
+void ThumbnailEngine::close() {
+    for (FFWrapper* session : sessions) {
+        session->close();
+        delete session;
+    }
+    sessions.clear();
+    sessionWidth = 0;
+    sessionHeight = 0;
+    duration = 0;
+}
+
+int ThumbnailEngine::getDuration() {
+    return duration;
+}
+
+FFWrapper* ThumbnailEngine::openSession(int tileWidth, int tileHeight) {
+    FFWrapper* session = new FFWrapper();
+    // the workers run in parallel already
+    session->setVideoThreads(1, FF_THREAD_SLICE);
+    session->setAudioEnabled(false);
+    session->setVideoDecodeSize(tileWidth, tileHeight);
+    if (!session->open(url.c_str())) {
+        session->close();
+        delete session;
+        return nullptr;
+    }
+    session->setVideoKeyframesOnly(true);
+    return session;
+}
+
+bool ThumbnailEngine::generate(int count, int tileWidth, int tileHeight, int columns, Sprite* sprite) {
+    if (count <= 0 || duration <= 0) {
+        LOGE("generate failed: count=%d, duration=%dms", count, duration);
+        return false;
+    }
+    std::vector<int> positions(count);
+    for (int i = 0; i < count; i++) {
+        positions[i] = int(int64_t(duration)*(2*i + 1)/(2*count));
+    }
+    return generate(positions, tileWidth, tileHeight, columns, sprite);
+}
+
+bool ThumbnailEngine::generate(const std::vector<int>& positions, int tileWidth, int tileHeight,
+    int columns, Sprite* sprite) {
+    if (url.empty() || positions.empty() || tileWidth <= 0 || tileHeight <= 0 || columns <= 0) {
+        LOGE("generate failed: url=%s, count=%d, tile=%dx%d, columns=%d", url.c_str(),
+            (int)positions.size(), tileWidth, tileHeight, columns);
+        return false;
+    }
+    int64_t start = monotonicTime();
+    int count = positions.size();
+    sprite->tileWidth = tileWidth;
+    sprite->tileHeight = tileHeight;
+    sprite->columns = std::min(columns, count);
+    sprite->rows = (count + sprite->columns - 1)/sprite->columns;
+    sprite->stride = sprite->columns*tileWidth*4;
+    sprite->positions.assign(count, -1);
+    // opaque black, the letterbox of each tile
+    sprite->pixels.assign(size_t(sprite->stride)*sprite->rows*tileHeight, 0);
+    for (size_t i = 3; i < sprite->pixels.size(); i += 4) {
+        sprite->pixels[i] = 0xff;
+    }
+
+    // lowres depends on the tile size, so sessions opened for another one are opened again
+    if (sessionWidth != tileWidth || sessionHeight != tileHeight) {
+        for (FFWrapper* session : sessions) {
+            session->close();
+            delete session;
+        }
+        sessions.clear();
+        sessionWidth = tileWidth;
+        sessionHeight = tileHeight;
+    }
+
+    // contiguous shares, so each worker only seeks forward
+    int n = std::min(workers, count);
+    int share = (count + n - 1)/n;
+    n = (count + share - 1)/share;
+    if (int(sessions.size()) < n) {
+        sessions.resize(n, nullptr);
+    }
+    std::vector<ThumbnailStats> stats(n);
+    std::vector<std::thread> threads;
+    for (int w = 0; w < n; w++) {
+        int first = w*share;
+        int last = std::min(count, first + share);
+        threads.push_back(std::thread([this, w, first, last, tileWidth, tileHeight, &positions, sprite, &stats] {
+            int64_t openStart = monotonicTime();
+            if (!sessions[w]) {
+                sessions[w] = openSession(tileWidth, tileHeight);
+                stats[w].openTime = monotonicTime() - openStart;
+            }
+            if (sessions[w]) {
+                extract(sessions[w], positions, first, last, sprite, &stats[w]);
+            }
+        }));
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    // a session which failed to open is tried again next time
+    sessions.erase(std::remove(sessions.begin(), sessions.end(), nullptr), sessions.end());
+
+    lastStats = ThumbnailStats();
+    lastStats.workers = n;
+    for (const ThumbnailStats& s : stats) {
+        lastStats.thumbnails += s.thumbnails;
+        lastStats.decoded += s.decoded;
+        lastStats.openTime += s.openTime;
+        lastStats.seekTime += s.seekTime;
+        lastStats.decodeTime += s.decodeTime;
+        lastStats.scaleTime += s.scaleTime;
+    }
+    lastStats.totalTime = monotonicTime() - start;
+    LOGI("generate: %d/%d thumbnails (%d decoded) in %lldms, %.1f/s, workers=%d, open=%lldms, seek=%lldms, decode=%lldms, scale=%lldms",
+        lastStats.thumbnails, count, lastStats.decoded, (long long)lastStats.totalTime/1000,
+        lastStats.totalTime > 0 ? lastStats.thumbnails*1000000.0/lastStats.totalTime : 0.0, n,
+        (long long)lastStats.openTime/1000, (long long)lastStats.seekTime/1000,
+        (long long)lastStats.decodeTime/1000, (long long)lastStats.scaleTime/1000);
+    return lastStats.thumbnails > 0;
+}
+
+void ThumbnailEngine::extract(FFWrapper* session, const std::vector<int>& positions, int first, int last,
+    Sprite* sprite, ThumbnailStats* stats) {
+    int64_t lastKeyframe = AV_NOPTS_VALUE;
+    int lastTile = -1;
+    for (int tile = first; tile < last; tile++) {
+        // seek to the keyframe at or before the position
+        int64_t seekStart = monotonicTime();
+        session->seek(int64_t(positions[tile])*AV_TIME_BASE/1000);
+        session->flushVideoDecoder();
+        AVPacket packet;
+        bool found = false;
+        for (int i = 0; i < MAX_SEEK_PACKETS && session->readPacket(packet); i++) {
+            if (session->isVideo(packet) && (packet.flags & AV_PKT_FLAG_KEY)) {
+                found = true;
+                break;
+            }
+            session->freePacket(packet);
+        }
+        stats->seekTime += monotonicTime() - seekStart;
+        if (!found) {
+            LOGW("extract: no keyframe at %dms", positions[tile]);
+            continue;
+        }
+        int64_t keyframe = packet.pts != AV_NOPTS_VALUE ? packet.pts : packet.dts;
+        if (lastTile >= 0 && keyframe == lastKeyframe) {
+            // the previous position landed on the same keyframe
+            session->freePacket(packet);
+            copyTile(sprite, lastTile, tile);
+            sprite->positions[tile] = sprite->positions[lastTile];
+            stats->thumbnails++;
+            continue;
+        }
+
+        // the keyframe alone, draining makes decoders with a reorder delay output it at once
+        int64_t decodeStart = monotonicTime();
+        session->sendVideoPacket(&packet);
+        session->freePacket(packet);
+        session->sendVideoPacket(nullptr);
+        AVFrame* frame = nullptr;
+        bool decoded = session->receiveVideoFrame(&frame);
+        stats->decodeTime += monotonicTime() - decodeStart;
+        if (!decoded) {
+            LOGW("extract: decode the keyframe at %dms failed", positions[tile]);
+            continue;
+        }
+        stats->decoded++;
+
+        // fit the display aspect ratio into the tile
+        int64_t scaleStart = monotonicTime();
+        double aspect = double(frame->width)/frame->height;
+        if (frame->sample_aspect_ratio.num > 0 && frame->sample_aspect_ratio.den > 0) {
+            aspect *= av_q2d(frame->sample_aspect_ratio);
+        }
+        int w = sprite->tileWidth;
+        int h = std::max(1, int(w/aspect));
+        if (h > sprite->tileHeight) {
+            h = sprite->tileHeight;
+            w = std::max(1, int(h*aspect));
+        }
+        int x = (tile % sprite->columns)*sprite->tileWidth + (sprite->tileWidth - w)/2;
+        int y = (tile / sprite->columns)*sprite->tileHeight + (sprite->tileHeight - h)/2;
+        uint8_t* dst_data[4] = {sprite->pixels.data() + size_t(y)*sprite->stride + x*4, nullptr, nullptr, nullptr};
+        int dst_linesize[4] = {sprite->stride, 0, 0, 0};
+        if (session->setVideoScale(frame, w, h, AV_PIX_FMT_RGBA)) {
+            session->scaleVideo(frame, dst_data, dst_linesize);
+            sprite->positions[tile] = int(frame->pts*session->videoTimeBase()*1000);
+            stats->thumbnails++;
+            lastKeyframe = keyframe;
+            lastTile = tile;
+        }
+        session->freeFrame(frame);
+        stats->scaleTime += monotonicTime() - scaleStart;
+    }
+}
+
+void ThumbnailEngine::copyTile(Sprite* sprite, int from, int to) {
+    int rowBytes = sprite->tileWidth*4;
+    for (int y = 0; y < sprite->tileHeight; y++) {
+        const uint8_t* src = sprite->pixels.data() +
+            size_t((from / sprite->columns)*sprite->tileHeight + y)*sprite->stride + (from % sprite->columns)*rowBytes;
+        uint8_t* dst = sprite->pixels.data() +
+            size_t((to / sprite->columns)*sprite->tileHeight + y)*sprite->stride + (to % sprite->columns)*rowBytes;
+        memcpy(dst, src, rowBytes);
+    }
+}
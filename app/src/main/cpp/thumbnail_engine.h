@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "ffwrapper.h"
+
+struct ThumbnailStats {
+    int thumbnails = 0;
+    // keyframes decoded, thumbnails landing on the same keyframe share it
+    int decoded = 0;
+    int workers = 0;
+    // NOTES: in microseconds, summed over all workers
+    int64_t openTime = 0;
+    int64_t seekTime = 0;
+    int64_t decodeTime = 0;
+    int64_t scaleTime = 0;
+    // NOTES: in microseconds, wall time of the whole sprite
+    int64_t totalTime = 0;
+};
+
+//
+// A grid of thumbnails in one RGBA image, tile i is at column i%columns and row i/columns
+//
+struct Sprite {
+    int tileWidth = 0;
+    int tileHeight = 0;
+    int columns = 0;
+    int rows = 0;
+    // NOTES: in bytes
+    int stride = 0;
+    std::vector<uint8_t> pixels;
+    // NOTES: in milliseconds, the pts of the keyframe in each tile, -1 if it couldn't be made
+    std::vector<int> positions;
+};
+
+//
+// Headless thumbnail extraction for seek bar previews, independent of the Player. Each worker
+// thread has its own FFWrapper session (video only, single threaded decoding at a lowres size
+// where the decoder supports it), seeks to its share of the positions in order and decodes just
+// the keyframe found there, which is scaled into its tile through the session's cached scaler.
+//
+class ThumbnailEngine {
+public:
+    // NOTES: workers 0 means one per cpu core, up to THUMBNAIL_MAX_WORKERS
+    ThumbnailEngine(int workers = 0);
+    ~ThumbnailEngine();
+
+    // NOTES: probes url, returns false if it has no decodable video
+    bool open(const std::string& url);
+    void close();
+    // NOTES: in milliseconds
+    int getDuration();
+    // NOTES: count thumbnails from the middle of count equal parts of the duration
+    bool generate(int count, int tileWidth, int tileHeight, int columns, Sprite* sprite);
+    // NOTES: positions in milliseconds, returns false if no thumbnail could be made
+    bool generate(const std::vector<int>& positions, int tileWidth, int tileHeight, int columns, Sprite* sprite);
+    // NOTES: of the last generate()
+    ThumbnailStats stats() {
+        return lastStats;
+    }
+
+private:
+    FFWrapper* openSession(int tileWidth, int tileHeight);
+    void extract(FFWrapper* session, const std::vector<int>& positions, int first, int last,
+        Sprite* sprite, ThumbnailStats* stats);
+    void copyTile(Sprite* sprite, int from, int to);
+
+private:
+    std::string url;
+    int workers = 0;
+    // one per worker, kept open for the following sprites
+    std::vector<FFWrapper*> sessions;
+    int sessionWidth = 0;
+    int sessionHeight = 0;
+    // in milliseconds, 0 if unknown
+    int duration = 0;
+    ThumbnailStats lastStats;
+};
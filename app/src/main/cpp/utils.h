@@ -1,9 +1,56 @@
 #pragma once
 
 #include <queue>
+#include <algorithm>
+#include <vector>
+#include <atomic>
 #include <mutex>
 #include <thread>
+#include <functional>
 #include <condition_variable>
+#include "clock.h"
+
+//
+// Wakes up a worker thread when one of its inputs (event, buffer or state) changes.
+// A notification sent while nobody is waiting is remembered, so it is never lost.
+//
+class Notifier
+{
+public:
+    void notify() {
+        std::unique_lock<std::mutex> lock(m);
+        signaled = true;
+        condition.notify_one();
+    }
+
+    // NOTES: timeout unit is milliseconds, a negative timeout waits forever
+    bool wait(long timeout=-1) {
+        std::unique_lock<std::mutex> lock(m);
+        if (timeout < 0) {
+            condition.wait(lock, [this] { return signaled; });
+        } else if (!condition.wait_for(lock, std::chrono::milliseconds(timeout), [this] { return signaled; })) {
+            return false;
+        }
+        signaled = false;
+        return true;
+    }
+
+    // NOTES: deadline is in microseconds of the current TimeSource, returns false once it passed
+    bool waitUntil(int64_t deadline) {
+        std::unique_lock<std::mutex> lock(m);
+        if (!TimeSource::current()->waitUntil(condition, lock, deadline, [this] { return signaled; })) {
+            return false;
+        }
+        signaled = false;
+        return true;
+    }
+
+private:
+    std::mutex m;
+    std::condition_variable condition;
+    bool signaled = false;
+};
+
 
 template <typename T>
 class Queue
@@ -11,6 +58,14 @@ class Queue
 public:
     Queue(size_t maxsize = 256) : maxSize(maxsize) {}
 
+    // NOTES: pushNotifier is notified when an element is pushed (wakes the consumer),
+    //        popNotifier is notified when an element is popped (wakes the producer)
+    void setNotifiers(Notifier* pushNotifier, Notifier* popNotifier = nullptr) {
+        std::unique_lock<std::mutex> lock(m);
+        this->pushNotifier = pushNotifier;
+        this->popNotifier = popNotifier;
+    }
+
     bool empty() {
         std::unique_lock<std::mutex> lock(m);
         return q.empty();
@@ -32,6 +87,9 @@ public:
         } 
         q.push(e);
         pushCondition.notify_all();
+        if (pushNotifier) {
+            pushNotifier->notify();
+        }
         return true;
     }
 
@@ -47,6 +105,9 @@ public:
         e = q.front();
         q.pop();
         popCondition.notify_all();
+        if (popNotifier) {
+            popNotifier->notify();
+        }
         return true;
     }
 
@@ -56,6 +117,8 @@ private:
     std::condition_variable pushCondition;
     std::condition_variable popCondition;
     size_t maxSize;
+    Notifier* pushNotifier = nullptr;
+    Notifier* popNotifier = nullptr;
 };
 
 
@@ -67,6 +130,14 @@ public:
     PriorityQueue(size_t maxsize = 256, Compare compare = Compare()) 
         : q(compare), maxSize(maxsize) {}
 
+    // NOTES: pushNotifier is notified when an element is pushed (wakes the consumer),
+    //        popNotifier is notified when an element is popped (wakes the producer)
+    void setNotifiers(Notifier* pushNotifier, Notifier* popNotifier = nullptr) {
+        std::unique_lock<std::mutex> lock(m);
+        this->pushNotifier = pushNotifier;
+        this->popNotifier = popNotifier;
+    }
+
     bool empty() {
         std::unique_lock<std::mutex> lock(m);
         return q.empty();
@@ -88,6 +159,9 @@ public:
         } 
         q.push(e);
         pushCondition.notify_all();
+        if (pushNotifier) {
+            pushNotifier->notify();
+        }
         return true;
     }
 
@@ -103,6 +177,9 @@ public:
         e = q.top();
         q.pop();
         popCondition.notify_all();
+        if (popNotifier) {
+            popNotifier->notify();
+        }
         return true;
     }
 
@@ -112,5 +189,203 @@ private:
     std::mutex m;
     std::condition_variable pushCondition;
     std::condition_variable popCondition;
-    
+    Notifier* pushNotifier = nullptr;
+    Notifier* popNotifier = nullptr;
+};
+
+
+#define CACHE_LINE_SIZE 64
+
+//
+// Bounded lock-free ring buffer for exactly one producer thread and one consumer thread.
+// The producer and consumer indexes live on separate cache lines, and the notifiers are
+// only signaled on empty->non-empty (push) and full->non-full (pop) transitions.
+//
+template <typename T>
+class RingBuffer
+{
+public:
+    // NOTES: capacity is rounded up to a power of 2
+    RingBuffer(size_t capacity = 256) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        buffer.resize(size);
+        mask = size - 1;
+    }
+
+    // NOTES: pushNotifier is notified when the buffer becomes non-empty (wakes the consumer),
+    //        popNotifier is notified when the buffer becomes non-full (wakes the producer)
+    void setNotifiers(Notifier* pushNotifier, Notifier* popNotifier = nullptr) {
+        this->pushNotifier = pushNotifier;
+        this->popNotifier = popNotifier;
+    }
+
+    bool empty() {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    int size() {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    // NOTES: producer only, timeout unit is milliseconds
+    bool push(const T& e, long timeout=0) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - cachedTail > mask) {
+            cachedTail = tail.load(std::memory_order_seq_cst);
+            if (h - cachedTail > mask) {
+                if (timeout == 0 || !popNotifier || !popNotifier->wait(timeout)) {
+                    return false;
+                }
+                cachedTail = tail.load(std::memory_order_seq_cst);
+                if (h - cachedTail > mask) {
+                    return false;
+                }
+            }
+        }
+        buffer[h & mask] = e;
+        head.store(h + 1, std::memory_order_seq_cst);
+        // the consumer may be waiting if it had consumed everything before this element
+        if (pushNotifier && tail.load(std::memory_order_seq_cst) == h) {
+            pushNotifier->notify();
+        }
+        return true;
+    }
+
+    // NOTES: consumer only, timeout unit is milliseconds
+    bool pop(T& e, long timeout=0) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == cachedHead) {
+            cachedHead = head.load(std::memory_order_seq_cst);
+            if (t == cachedHead) {
+                if (timeout == 0 || !pushNotifier || !pushNotifier->wait(timeout)) {
+                    return false;
+                }
+                cachedHead = head.load(std::memory_order_seq_cst);
+                if (t == cachedHead) {
+                    return false;
+                }
+            }
+        }
+        e = buffer[t & mask];
+        tail.store(t + 1, std::memory_order_seq_cst);
+        // the producer may be waiting if the buffer was full before this pop
+        if (popNotifier && head.load(std::memory_order_seq_cst) - t > mask) {
+            popNotifier->notify();
+        }
+        return true;
+    }
+
+private:
+    std::vector<T> buffer;
+    size_t mask = 0;
+    Notifier* pushNotifier = nullptr;
+    Notifier* popNotifier = nullptr;
+    char pad0[CACHE_LINE_SIZE];
+    // written by the producer
+    std::atomic<size_t> head{0};
+    size_t cachedTail = 0;
+    char pad1[CACHE_LINE_SIZE];
+    // written by the consumer
+    std::atomic<size_t> tail{0};
+    size_t cachedHead = 0;
+    char pad2[CACHE_LINE_SIZE];
+};
+
+
+//
+// Persistent worker threads running batches of short tasks, e.g. slices of a frame.
+//
+class ThreadPool
+{
+public:
+    // shared by all players
+    static ThreadPool& instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    // NOTES: threads 0 means one thread per cpu core
+    ThreadPool(int threads = 0) {
+        if (threads <= 0) {
+            threads = std::max(1, int(std::thread::hardware_concurrency()));
+        }
+        for (int i = 0; i < threads; i++) {
+            workers.push_back(std::thread(&ThreadPool::working, this));
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            stopped = true;
+        }
+        condition.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    int size() {
+        return workers.size();
+    }
+
+    // NOTES: runs all tasks and waits for them to complete, the caller runs the first task itself
+    void run(const std::vector<std::function<void()>>& tasks) {
+        if (tasks.empty()) {
+            return;
+        }
+        Batch batch;
+        batch.remaining = tasks.size() - 1;
+        {
+            std::unique_lock<std::mutex> lock(m);
+            for (size_t i = 1; i < tasks.size(); i++) {
+                const std::function<void()>* task = &tasks[i];
+                Batch* b = &batch;
+                queue.push([task, b] {
+                    (*task)();
+                    std::unique_lock<std::mutex> lock(b->m);
+                    if (--b->remaining == 0) {
+                        b->condition.notify_one();
+                    }
+                });
+            }
+        }
+        condition.notify_all();
+        tasks[0]();
+        std::unique_lock<std::mutex> lock(batch.m);
+        batch.condition.wait(lock, [&batch] { return batch.remaining == 0; });
+    }
+
+private:
+    struct Batch {
+        std::mutex m;
+        std::condition_variable condition;
+        size_t remaining = 0;
+    };
+
+    void working() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                condition.wait(lock, [this] { return stopped || !queue.empty(); });
+                if (queue.empty()) {
+                    return;
+                }
+                task = std::move(queue.front());
+                queue.pop();
+            }
+            task();
+        }
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> queue;
+    std::mutex m;
+    std::condition_variable condition;
+    bool stopped = false;
 };
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "log.h"
 #include "ffwrapper.h"
 #include "video_decoder.h"
@@ -9,69 +10,228 @@ void VideoDecoder::decoding() {
     LOGD("decoding: thread started");
     AVFrame* pendingFrame = nullptr;
     bool pendingEOS = false;
+    bool draining = false;
+    bool flushing = false;
+    // frames ending before it are discarded after an accurate seek, in microseconds
+    int64_t seekTarget = -1;
+    int discarded = 0;
+    // the next source of the playlist, and the frames decoded and the packets held by its preroll
+    Preroll* nextSource = nullptr;
+    std::deque<AVFrame*> prerolledFrames;
+    std::deque<AVPacket> prerolledPackets;
+    // the render still has frames of the previous source, see EVENT_SWITCH_SOURCE
+    bool waitingSink = false;
+    // packets are only late once the clock runs in the segment of their source
+    int clockSegment = clock->getSegment();
+    qos.reset(ffWrapper->videoFPS());
+    ffWrapper->setVideoSkipLevel(qos.level());
     for (;;) {
         // Handle events
         Event ev;
         if (eventQueue.pop(ev)) {
-            if (ev.id == EVENT_STOP_THREAD) {
+            if (ev.id == EVENT_STOP_THREAD || ev.id == EVENT_FLUSH_START) {
+                if (ev.id == EVENT_FLUSH_START && nextSource) {
+                    // what the switch waits for is dropped anyway, the render switches on its flush
+                    videoSink->onEvent(Event(EVENT_SWITCH_SOURCE, nextSource));
+                    switchSource(nextSource, prerolledFrames, prerolledPackets);
+                    nextSource = nullptr;
+                }
                 if (pendingFrame) {
                     ffWrapper->freeFrame(pendingFrame);
                     pendingFrame = nullptr;
                 }
+                for (AVFrame* f : prerolledFrames) {
+                    ffWrapper->freeFrame(f);
+                }
+                prerolledFrames.clear();
+                for (AVPacket& p : prerolledPackets) {
+                    ffWrapper->freePacket(p);
+                }
+                prerolledPackets.clear();
                 while (!bufferQueue.empty()) {
                     AVPacket p;
                     bufferQueue.pop(p);
                     ffWrapper->freePacket(p);
                 }
+                // reset the decoder, it may be in draining mode
+                ffWrapper->flushVideoDecoder();
+                if (ev.id == EVENT_FLUSH_START) {
+                    pendingEOS = false;
+                    draining = false;
+                    waitingSink = false;
+                    flushing = true;
+                    static_cast<Notifier*>(ev.data)->notify();
+                    continue;
+                }
+                QoSStats stats = qos.getStats();
+                LOGI("decoding: qos reports=%lld, level_changes=%lld, filter_skipped=%lld, decoder_skipped=%lld, packets_skipped=%lld",
+                    (long long)stats.reports, (long long)stats.levelChanges, (long long)stats.filterSkippedFrames(),
+                    (long long)stats.decoderSkippedFrames(), (long long)stats.skippedPackets);
                 LOGD("decoding: thread exited");
                 break;
             };
             if (ev.id == EVENT_EOS) {
                 pendingEOS = true;
-                videoSink->onEvent(Event(EVENT_EOS));
                 continue;
             }
+            if (ev.id == EVENT_QOS) {
+                if (qos.report(ev.value, monotonicTime())) {
+                    ffWrapper->setVideoSkipLevel(qos.level());
+                }
+                continue;
+            }
+            if (ev.id == EVENT_SWITCH_SOURCE) {
+                nextSource = static_cast<Preroll*>(ev.data);
+                continue;
+            }
+            if (ev.id == EVENT_SOURCE_SWITCHED) {
+                // from the render, the demuxer recycles the previous engine once all switched
+                waitingSink = false;
+                demuxer->onEvent(ev);
+                continue;
+            }
+            if (ev.id == EVENT_FLUSH_STOP) {
+                flushing = false;
+                seekTarget = ev.value;
+                discarded = 0;
+                clockSegment = clock->getSegment();
+                // lateness before the seek says nothing about the new position
+                qos.reset(ffWrapper->videoFPS());
+                ffWrapper->setVideoSkipLevel(qos.level());
+                static_cast<Notifier*>(ev.data)->notify();
+                continue;
+            }
+            continue;
+        }
+
+        // Flushing
+        if (flushing) {
+            notifier.wait();
             continue;
         }
 
-        // Handle buffers
+        // Switching, the render shows the last frames of the previous source first
+        if (waitingSink) {
+            notifier.wait();
+            continue;
+        }
+
+        // Handle buffers, drain all decoded frames before sending next packet
         AVFrame* frame = nullptr;
         if (pendingFrame) {
             frame = pendingFrame;
             pendingFrame = nullptr;
+        } else if (!prerolledFrames.empty()) {
+            frame = prerolledFrames.front();
+            prerolledFrames.pop_front();
         } else {
-            AVPacket packet;
-            if (!bufferQueue.pop(packet)) {
-                if (pendingEOS) {
-                    LOGD("decoding: end of stream, will sleep 10ms");
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            bool isEOF = false;
+            if (!ffWrapper->receiveVideoFrame(&frame, &isEOF)) {
+                if (isEOF) {
+                    if (draining && nextSource) {
+                        // all tail frames have been pushed, the render switches after them
+                        draining = false;
+                        videoSink->onEvent(Event(EVENT_SWITCH_SOURCE, nextSource));
+                        switchSource(nextSource, prerolledFrames, prerolledPackets);
+                        nextSource = nullptr;
+                        clockSegment++;
+                        waitingSink = true;
+                        continue;
+                    }
+                    if (draining) {
+                        // all tail frames have been pushed
+                        draining = false;
+                        videoSink->onEvent(Event(EVENT_EOS));
+                    }
+                    LOGD("decoding: end of stream, wait for events");
+                    notifier.wait();
                     continue;
                 }
-                if (states.getCurrent() == STATE_PAUSED) {
-                    LOGD("decoding: current state is STATE_PAUSED, will sleep 10ms");
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                AVPacket packet;
+                bool popped = !prerolledPackets.empty();
+                if (popped) {
+                    packet = prerolledPackets.front();
+                    prerolledPackets.pop_front();
+                } else {
+                    popped = bufferQueue.pop(packet);
+                }
+                if (popped) {
+                    // don't decode what would be displayed too late anyway
+                    int64_t pts = packet.pts != AV_NOPTS_VALUE ? packet.pts : packet.dts;
+                    int64_t running = clock->runningTime();
+                    if (pts != AV_NOPTS_VALUE && clock->getSegment() >= clockSegment &&
+                        qos.skipPacket(packet.flags & AV_PKT_FLAG_KEY, pts*ffWrapper->videoTimeBase()*1000000, running)) {
+                        ffWrapper->freePacket(packet);
+                        continue;
+                    }
+                    if (!ffWrapper->sendVideoPacket(&packet)) {
+                        LOGE("decoding: decode video error");
+                        bus->sendMessage(Message(MESSAGE_ERROR_DECODE, this));
+                    } else {
+                        qos.sentPacket();
+                    }
+                    ffWrapper->freePacket(packet);
+                    continue;
+                }
+                if ((pendingEOS || nextSource) && !draining) {
+                    // no more packets, flush the decoder to get the delayed frames
+                    LOGD("decoding: end of %s, drain the decoder", nextSource ? "source" : "stream");
+                    ffWrapper->sendVideoPacket(nullptr);
+                    draining = true;
                     continue;
                 }
+                if (states.getCurrent() == STATE_PAUSED) {
+                    LOGD("decoding: current state is STATE_PAUSED, wait for buffers");
+                }
+                notifier.wait();
                 continue;
             }
-            if (!ffWrapper->decodeVideo(packet, &frame, nullptr)) {
-                LOGE("decoding: decode video error");
-                bus->sendMessage(Message(MESSAGE_ERROR_DECODE, this));
-                ffWrapper->freePacket(packet);
-                continue;
+            qos.receivedFrame();
+            if (startupTimer) {
+                startupTimer->mark(STARTUP_FIRST_DECODED);
+            }
+            // decode from the keyframe, but only show what ends after the seek target
+            if (seekTarget >= 0) {
+                double timeBase = ffWrapper->videoTimeBase();
+                int64_t pts = frame->pts * timeBase * 1000000;
+                int64_t duration = av_frame_get_pkt_duration(frame) * timeBase * 1000000;
+                if (frame->pts != AV_NOPTS_VALUE && pts + std::max<int64_t>(duration, 1) <= seekTarget) {
+                    ffWrapper->freeFrame(frame);
+                    discarded++;
+                    continue;
+                }
+                LOGD("decoding: %d frames before the seek target %lldms discarded", discarded, (long long)seekTarget/1000);
+                seekTarget = -1;
             }
-            ffWrapper->freePacket(packet);
         }
         // push buffer to video render
         Buffer buf(BUFFER_AVFRAME, frame);
         if (videoSink->onBuffer(buf) == STATUS_FAILED) {
-            LOGW("decoding: push buffer to video render failed");
+            LOGW("decoding: push buffer to video render failed, wait for it to be consumed");
             pendingFrame = frame;
+            notifier.wait();
         }
     }
 }
 
-VideoDecoder::VideoDecoder() {   
+void VideoDecoder::switchSource(Preroll* preroll, std::deque<AVFrame*>& frames, std::deque<AVPacket>& packets) {
+    ffWrapper = preroll->getEngine();
+    preroll->takeVideoFrames(frames);
+    preroll->takeVideoPackets(packets);
+    bufferQueue.setTimeBase(ffWrapper->videoTimeBase());
+    qos.reset(ffWrapper->videoFPS());
+    ffWrapper->setVideoSkipLevel(qos.level());
+    LOGD("switchSource: %s, %d frames prerolled, %d packets held", preroll->getUrl().c_str(), (int)frames.size(),
+        (int)packets.size());
+    // the demuxer goes on with the packets of the next source
+    Event switched(EVENT_SOURCE_SWITCHED);
+    switched.value = SWITCHED_VIDEO_DECODER;
+    demuxer->onEvent(switched);
+}
+
+VideoDecoder::VideoDecoder() {
+    eventQueue.setNotifiers(&notifier);
+    bufferQueue.setNotifiers(&notifier);
 }
 
 VideoDecoder::~VideoDecoder() {    
@@ -94,6 +254,8 @@ int VideoDecoder::toReady() {
         return STATUS_FAILED;
     }
     if (current == STATE_NULL) {
+        bufferQueue.setTimeBase(ffWrapper->videoTimeBase());
+        qos.resetStats();
         states.setCurrent(STATE_READY);
         return STATUS_SUCCESS;
     }
@@ -117,6 +279,7 @@ int VideoDecoder::toPaused() {
     }
     // current == STATE_PLAYING)
     states.setCurrent(STATE_PAUSED);
+    notifier.notify();
     return STATUS_SUCCESS;
 }
 
@@ -127,6 +290,7 @@ int VideoDecoder::toPlaying() {
         return STATUS_FAILED;
     }
     states.setCurrent(STATE_PLAYING);
+    notifier.notify();
     return STATUS_SUCCESS;
 }
 
@@ -169,7 +333,3 @@ int VideoDecoder::onBuffer(const Buffer& buffer) {
     return STATUS_SUCCESS;
 }
 
-
-bool VideoDecoder::BufferCompare::operator()(const AVPacket& lPacket, const AVPacket& rPacket) {
-    return lPacket.dts >= rPacket.dts;
-};
\ No newline at end of file
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <thread>
+#include <deque>
 #include "element.h"
 #include "ffwrapper.h"
 #include "utils.h"
+#include "packet_queue.h"
+#include "preroll.h"
+#include "startup_timer.h"
 
 class VideoDecoder: public Element {
 
@@ -29,6 +33,9 @@ public:
     
     int onEvent(const Event& event) override;
     int onBuffer(const Buffer& buffer) override;
+    Notifier* getNotifier() override {
+        return &notifier;
+    }
 
 public:
     void setEngine(FFWrapper* ffWrapper) {
@@ -36,10 +43,23 @@ public:
     }
     void setSource(Element* demuxer) {
         this->demuxer = demuxer;
+        bufferQueue.setNotifiers(&notifier, demuxer->getNotifier());
     }
     void setVideoSink(Element* videoSink) {
         this->videoSink = videoSink;
     }
+    // NOTES: marks the first decoded frame
+    void setStartupTimer(StartupTimer* startupTimer) {
+        this->startupTimer = startupTimer;
+    }
+    // NOTES: limits of the packets buffered from demuxer, should be set in STATE_NULL
+    void setBufferLimits(const BufferLimits& limits) {
+        bufferQueue.setLimits(limits);
+    }
+    // NOTES: skip counters since the source was opened, kept across seeks and playlist switches
+    QoSStats qosStats() {
+        return qos.getStats();
+    }
 
 private:
     int toNull();
@@ -47,20 +67,20 @@ private:
     int toPaused();
     int toPlaying();
     void decoding();
+    // NOTES: continues with the engine, the prerolled frames and the held packets of the next source
+    void switchSource(Preroll* preroll, std::deque<AVFrame*>& frames, std::deque<AVPacket>& packets);
 
 private:
     Clock* clock = nullptr;
     Bus* bus = nullptr;
     FFWrapper* ffWrapper = nullptr;
+    StartupTimer* startupTimer = nullptr;
     Element* demuxer = nullptr;
     Element* videoSink = nullptr;
     States states;
     std::thread decodingThread;
     Queue<Event> eventQueue;
-
-private:
-    struct BufferCompare {
-        bool operator()(const AVPacket& lPacket, const AVPacket& rPacket);
-    };
-    PriorityQueue<AVPacket, BufferCompare> bufferQueue;
+    Notifier notifier;
+    PacketQueue bufferQueue;
+    VideoQoS qos;
 };
\ No newline at end of file
@@ -1,15 +1,20 @@
-#include <chrono>
+#include <algorithm>
 #include <jni.h>
 #include <android/native_window_jni.h>
 #include <android/native_window.h>
 #include "log.h"
+#include "clock.h"
 #include "ffwrapper.h"
+#include "color_convert.h"
 #include "video_device.h"
 
 
 #undef  LOG_TAG 
 #define LOG_TAG "VideoDevice"
 
+// NOTES: android/hardware/graphics/common HAL format, planes are Y, Cr, Cb with 16 bytes aligned strides
+#define HAL_PIXEL_FORMAT_YV12   0x32315659
+
 extern JNIEnv* getJNIEnv(void);
 
 class SurfaceDevice: public VideoDevice {
@@ -32,6 +37,7 @@ public:
                     surface = static_cast<jobject>(value);
                     window = ANativeWindow_fromSurface(env, surface);
                 }
+                resetWindowFormat();
                 break;
             default:
                 LOGE("setProperty: unsupported key=%d", key);
@@ -61,80 +67,27 @@ public:
     int write(void* buf, int buflen) override {
         int writed = 0;
         AVFrame* frame = static_cast<AVFrame*>(buf);
+        bool yuv = setYUVWindow(frame);
         ANativeWindow_Buffer buffer = {0};
         if (ANativeWindow_lock(window, &buffer, 0) == 0) {
             LOGD("write: window: width=%d, height=%d, stride=%d, format=%d",
                  buffer.width, buffer.height, buffer.stride, buffer.format);
-            if (buffer.width > 0 && buffer.height > 0) {
-                // adjust display width/height based on video width/height
-                int W = buffer.width;
-                int H = buffer.height;
-                int offset = 0;
-                if (buffer.width*frame->height > frame->width*buffer.height) {
-                    W = buffer.height*frame->width/frame->height;
-                    offset = (buffer.width - W)*4/2;
-                } else {
-                    H = buffer.width*frame->height/frame->width;
-                    //offset = (buffer.height - H)*buffer.stride*4/2;
-                }
-
-                // set video scale context
-                if (width != buffer.width || height != buffer.height || format != buffer.format) {
-                    //ffWrapper->setVideoScale(frame, buffer.width, buffer.height, AV_PIX_FMT_RGBA);
-                    ffWrapper->setVideoScale(frame, W, H, AV_PIX_FMT_RGBA);
-                    width = buffer.width;
-                    height = buffer.height;
-                    format = buffer.format;
-                }
-                // scale video
-                int dst_linesize = buffer.stride * 4;
-                uint8_t* dst_data = static_cast<uint8_t*>(buffer.bits) + offset;
-
-                using namespace std::chrono;
-                system_clock::time_point tp = system_clock::now();
-                ffWrapper->scaleVideo(frame, &dst_data, &dst_linesize);
-
-                if (H < buffer.height) {
-                    int h = (buffer.height - H)/2;
-                    dst_data += h*buffer.stride*4;
-                    ffWrapper->scaleVideo(frame, &dst_data, &dst_linesize);
-                    dst_data += h*buffer.stride*4;
-                    ffWrapper->scaleVideo(frame, &dst_data, &dst_linesize);
-
-                    for (int j=0; j < buffer.height; j++) {
-                        dst_data = static_cast<uint8_t*>(buffer.bits) + j*buffer.stride*4;
-                        for (int i=0; i < buffer.width; i++) {
-                            if (j < h) {
-                                if (i < buffer.width/2) {
-                                    dst_data[4*i+1] = 0;
-                                    dst_data[4*i+2] = 0;
-                                } else {
-                                    dst_data[4*i] = 0;
-                                }
-                            } else if (j < 2*h) {
-                                if (i < buffer.width/2) {
-                                    dst_data[4*i] = 0;
-                                    dst_data[4*i+2] = 0;
-                                } else {
-                                    dst_data[4*i+1] = 0;
-                                }
-
-                            } else {
-                                if (i < buffer.width/2) {
-                                    dst_data[4*i] = 0;
-                                    dst_data[4*i+1] = 0;
-                                } else {
-                                    dst_data[4*i+2] = 0;
-                                }
-                            }
-                        }
-                    }
-
-                }
-
-                system_clock::duration d = system_clock::now() - tp;
-                LOGD("scaleVideo duration is %lldms", duration_cast<milliseconds>(d).count());
-                writed = dst_linesize * frame->height;
+            bool rgba = buffer.format == WINDOW_FORMAT_RGBA_8888 || buffer.format == WINDOW_FORMAT_RGBX_8888;
+            if (yuv && buffer.format == HAL_PIXEL_FORMAT_YV12) {
+                writed = writeYV12(frame, buffer);
+            } else if (yuv && rgba) {
+                // the window accepted the geometry but not the format, the next frames get the base
+                // geometry back. this one is converted into the buffer, which has the window's aspect
+                LOGW("write: window format %d isn't YV12, fall back to RGBA", buffer.format);
+                yuvSupported = false;
+                writed = writeRGBA(frame, buffer);
+            } else if (yuv) {
+                yuvSupported = false;
+                droppedFrames++;
+                LOGW("write: window format %d is neither YV12 nor RGBA, frame dropped, dropped=%d",
+                     buffer.format, droppedFrames);
+            } else if (buffer.width > 0 && buffer.height > 0) {
+                writed = writeRGBA(frame, buffer);
             }
             ANativeWindow_unlockAndPost(window);
         } else {
@@ -142,14 +95,130 @@ public:
             ANativeWindow_release(window);
             JNIEnv* env = getJNIEnv();
             window = ANativeWindow_fromSurface(env, surface);
+            resetWindowFormat();
         }
         ffWrapper->freeFrame(frame);
         return writed;
     }
+
+private:
+    //
+    // Negotiates a YV12 window for planar YUV 4:2:0 frames, so they can be copied without any color
+    // conversion or scaling, the compositor scales the window. The buffers get the aspect ratio of
+    // the window, with the frame centered in black borders, so the picture isn't distorted.
+    // Returns false if the window should be written in RGBA.
+    //
+    bool setYUVWindow(const AVFrame* frame) {
+        bool planar420 = frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUVJ420P;
+        if (!planar420 || !yuvSupported) {
+            if (yuvWidth || yuvHeight) {
+                // restore the window's base geometry and format
+                ANativeWindow_setBuffersGeometry(window, 0, 0, 0);
+                yuvWidth = 0;
+                yuvHeight = 0;
+            }
+            return false;
+        }
+        if (yuvWidth == frame->width && yuvHeight == frame->height) {
+            return true;
+        }
+        if (!yuvWidth && !yuvHeight) {
+            // NOTES: the size of the surface as long as the base geometry is set
+            windowWidth = ANativeWindow_getWidth(window);
+            windowHeight = ANativeWindow_getHeight(window);
+        }
+        int width = frame->width;
+        int height = frame->height;
+        if (windowWidth > 0 && windowHeight > 0) {
+            if (int64_t(windowWidth)*height > int64_t(width)*windowHeight) {
+                width = int(int64_t(height)*windowWidth/windowHeight);
+            } else {
+                height = int(int64_t(width)*windowHeight/windowWidth);
+            }
+        }
+        // the frame is centered on even lines and columns of the chroma planes
+        width = FFALIGN(width, 2);
+        height = FFALIGN(height, 2);
+        if (ANativeWindow_setBuffersGeometry(window, width, height, HAL_PIXEL_FORMAT_YV12) != 0) {
+            LOGW("setYUVWindow: YV12 window isn't supported, fall back to RGBA");
+            yuvSupported = false;
+            return false;
+        }
+        LOGD("setYUVWindow: window geometry is %dx%d for %dx%d frames, format is YV12",
+             width, height, frame->width, frame->height);
+        yuvWidth = frame->width;
+        yuvHeight = frame->height;
+        return true;
+    }
+
+    int writeYV12(const AVFrame* frame, const ANativeWindow_Buffer& buffer) {
+        int w = std::min(frame->width, buffer.width);
+        int h = std::min(frame->height, buffer.height);
+        int x = (buffer.width - w)/2 & ~1;
+        int y = (buffer.height - h)/2 & ~1;
+        int yStride = buffer.stride;
+        int cStride = FFALIGN(buffer.stride/2, 16);
+        uint8_t* yPlane = static_cast<uint8_t*>(buffer.bits);
+        uint8_t* vPlane = yPlane + yStride*buffer.height;
+        uint8_t* uPlane = vPlane + cStride*(buffer.height/2);
+        av_image_copy_plane(yPlane + y*yStride + x, yStride, frame->data[0], frame->linesize[0], w, h);
+        av_image_copy_plane(vPlane + (y/2)*cStride + x/2, cStride, frame->data[2], frame->linesize[2], (w + 1)/2, (h + 1)/2);
+        av_image_copy_plane(uPlane + (y/2)*cStride + x/2, cStride, frame->data[1], frame->linesize[1], (w + 1)/2, (h + 1)/2);
+        // letterbox, black is Y=16 U=V=128 in the limited range of the window
+        fillPlaneBorders(yPlane, yStride, buffer.width, buffer.height, x, y, w, h, 16);
+        fillPlaneBorders(vPlane, cStride, buffer.width/2, buffer.height/2, x/2, y/2, (w + 1)/2, (h + 1)/2, 128);
+        fillPlaneBorders(uPlane, cStride, buffer.width/2, buffer.height/2, x/2, y/2, (w + 1)/2, (h + 1)/2, 128);
+        return yStride*buffer.height + 2*cStride*(buffer.height/2);
+    }
+
+    int writeRGBA(const AVFrame* frame, const ANativeWindow_Buffer& buffer) {
+        // adjust display rect based on video width/height, keep the aspect ratio
+        int W = buffer.width;
+        int H = buffer.height;
+        if (buffer.width*frame->height > frame->width*buffer.height) {
+            W = buffer.height*frame->width/frame->height;
+        } else {
+            H = buffer.width*frame->height/frame->width;
+        }
+        int X = (buffer.width - W)/2;
+        int Y = (buffer.height - H)/2;
+        int dst_linesize = buffer.stride * 4;
+        uint8_t* bits = static_cast<uint8_t*>(buffer.bits);
+
+        int64_t scaleStart = monotonicTime();
+        // convert without sws_scale, scaling bilinearly into the display rect unless the picture
+        // shrinks too much for it or a better quality is asked for
+        bool scaled = W != frame->width || H != frame->height;
+        bool convert = !scaled || (ffWrapper->bilinearScale() &&
+            W >= frame->width*CONVERT_MIN_SCALE && H >= frame->height*CONVERT_MIN_SCALE);
+        if (!convert || !convertToRGBA(frame, bits, dst_linesize, X, Y, W, H)) {
+            // pick the scaler for the current frame and window geometry
+            ffWrapper->setVideoScale(frame, W, H, AV_PIX_FMT_RGBA);
+            uint8_t* dst_data = bits + Y*dst_linesize + X*4;
+            ffWrapper->scaleVideo(frame, &dst_data, &dst_linesize);
+        }
+        // letterbox
+        fillRGBABorders(bits, dst_linesize, buffer.width, buffer.height, X, Y, W, H);
+
+        LOGD("scaleVideo duration is %lldus", (long long)(monotonicTime() - scaleStart));
+        return dst_linesize * buffer.height;
+    }
+
+    void resetWindowFormat() {
+        yuvWidth = 0;
+        yuvHeight = 0;
+        yuvSupported = true;
+    }
+
 private:
-    int width = 0;
-    int height = 0;
-    int format = AV_PIX_FMT_NONE;
+    // of the frames the YV12 geometry is set for, 0 while the window has its base geometry
+    int yuvWidth = 0;
+    int yuvHeight = 0;
+    bool yuvSupported = true;
+    // the base geometry, the surface size
+    int windowWidth = 0;
+    int windowHeight = 0;
+    int droppedFrames = 0;
     FFWrapper* ffWrapper = nullptr;
     ANativeWindow* window = nullptr;
     jobject surface = nullptr;
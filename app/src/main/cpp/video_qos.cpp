@@ -0,0 +1,83 @@
+#include "log.h"
+#include "video_qos.h"
+
+#undef  LOG_TAG
+#define LOG_TAG "VideoQoS"
+
+// NOTES: in microseconds
+#define DEFAULT_FRAME_DURATION  40000
+// the level is raised at most this often while late, so each step can take effect first
+#define RAISE_INTERVAL          500000
+// and lowered after frames have been early on average for this long
+#define RESTORE_INTERVAL        2000000
+
+
+void VideoQoS::reset(double fps) {
+    frameDuration = fps > 0 ? int64_t(1000000/fps) : DEFAULT_FRAME_DURATION;
+    averageLateness = 0;
+    changedTime = 0;
+    inTimeSince = -1;
+    waitKeyframe = false;
+    std::lock_guard<std::mutex> lock(m);
+    skipLevel = SKIP_LEVEL_NONE;
+}
+
+void VideoQoS::resetStats() {
+    std::lock_guard<std::mutex> lock(m);
+    stats = QoSStats();
+}
+
+bool VideoQoS::report(int64_t lateness, int64_t now) {
+    std::unique_lock<std::mutex> lock(m);
+    stats.reports++;
+    lock.unlock();
+    averageLateness = (averageLateness*3 + lateness)/4;
+    int level = skipLevel;
+    if (averageLateness >= 0) {
+        inTimeSince = -1;
+    } else if (inTimeSince < 0) {
+        inTimeSince = now;
+    }
+    if (averageLateness > frameDuration/2) {
+        if (skipLevel < SKIP_LEVELS - 1 && now - changedTime >= RAISE_INTERVAL) {
+            level = skipLevel + 1;
+        }
+    } else if (inTimeSince >= 0 && skipLevel > SKIP_LEVEL_NONE &&
+        now - inTimeSince >= RESTORE_INTERVAL && now - changedTime >= RESTORE_INTERVAL) {
+        level = skipLevel - 1;
+        inTimeSince = now;
+    }
+    if (level == skipLevel) {
+        return false;
+    }
+    LOGI("report: average lateness is %lldus, skip level %d -> %d",
+        (long long)averageLateness, skipLevel, level);
+    lock.lock();
+    skipLevel = level;
+    stats.levelChanges++;
+    lock.unlock();
+    changedTime = now;
+    if (skipLevel < SKIP_LEVEL_TO_KEYFRAME) {
+        waitKeyframe = false;
+    }
+    return true;
+}
+
+bool VideoQoS::skipPacket(bool isKeyframe, int64_t pts, int64_t runningTime) {
+    if (skipLevel < SKIP_LEVEL_TO_KEYFRAME) {
+        return false;
+    }
+    // once a packet is skipped the frames referring to it can't be decoded until a keyframe
+    if (!waitKeyframe && !isKeyframe && pts < runningTime) {
+        waitKeyframe = true;
+    }
+    if (waitKeyframe && isKeyframe) {
+        waitKeyframe = false;
+    }
+    if (waitKeyframe) {
+        std::lock_guard<std::mutex> lock(m);
+        stats.skippedPackets++;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+
+// Skip levels of the video decoder, each one adds to the previous ones
+#define SKIP_LEVEL_NONE             0
+#define SKIP_LEVEL_NONREF_FILTER    1   // no loop filter on non-reference frames
+#define SKIP_LEVEL_FILTER           2   // no loop filter at all
+#define SKIP_LEVEL_NONREF_FRAMES    3   // non-reference frames are not decoded
+#define SKIP_LEVEL_TO_KEYFRAME      4   // packets which are late already are skipped up to the next keyframe
+#define SKIP_LEVELS                 5
+
+struct QoSStats {
+    // the skip level when the stats were taken
+    int level = SKIP_LEVEL_NONE;
+    int64_t reports = 0;
+    int64_t levelChanges = 0;
+    // packets sent to and frames received from the decoder at each level
+    int64_t packets[SKIP_LEVELS] = {0};
+    int64_t frames[SKIP_LEVELS] = {0};
+    // packets not sent to the decoder
+    int64_t skippedPackets = 0;
+
+    // NOTES: frames decoded without (part of) the loop filter
+    int64_t filterSkippedFrames() {
+        return frames[SKIP_LEVEL_NONREF_FILTER] + frames[SKIP_LEVEL_FILTER];
+    }
+    // NOTES: frames the decoder discarded, approximate while frames are in flight
+    int64_t decoderSkippedFrames() {
+        int64_t skipped = 0;
+        for (int i = SKIP_LEVEL_NONREF_FRAMES; i < SKIP_LEVELS; i++) {
+            skipped += packets[i] - frames[i];
+        }
+        return skipped > 0 ? skipped : 0;
+    }
+};
+
+//
+// Quality of service of the video decoder. The video render reports how late each frame is,
+// the skip level is raised one step at a time while frames are late on average, and lowered
+// again once they have been in time for a while. All times are in microseconds. The stats may be
+// read from any thread, the rest is used on the decoding thread only.
+//
+class VideoQoS {
+public:
+    // NOTES: fps <= 0 means unknown, restarts the adaptation at SKIP_LEVEL_NONE, e.g. after a seek,
+    //        the stats of the session are kept
+    void reset(double fps);
+    // NOTES: at the start of a session
+    void resetStats();
+    // NOTES: lateness is positive for late frames, returns true if the skip level changed
+    bool report(int64_t lateness, int64_t now);
+    int level() {
+        return skipLevel;
+    }
+    // NOTES: returns true if the packet should not be decoded, pts and runningTime are
+    //        in the same timebase, runningTime is the master clock now
+    bool skipPacket(bool isKeyframe, int64_t pts, int64_t runningTime);
+    void sentPacket() {
+        std::lock_guard<std::mutex> lock(m);
+        stats.packets[skipLevel]++;
+    }
+    void receivedFrame() {
+        std::lock_guard<std::mutex> lock(m);
+        stats.frames[skipLevel]++;
+    }
+    QoSStats getStats() {
+        std::lock_guard<std::mutex> lock(m);
+        QoSStats s = stats;
+        s.level = skipLevel;
+        return s;
+    }
+
+private:
+    int64_t frameDuration = 40000;
+    int64_t averageLateness = 0;
+    int64_t changedTime = 0;
+    // since when frames are early on average, -1 if they are not
+    int64_t inTimeSince = -1;
+    int skipLevel = SKIP_LEVEL_NONE;
+    bool waitKeyframe = false;
+    // guards stats, and skipLevel against the decoding thread changing it
+    std::mutex m;
+    QoSStats stats;
+};
@@ -7,20 +7,54 @@
 #define LOG_TAG "VideoRender"
 
 
+// NOTES: in microseconds, far deadlines are waited for in slices so events are still handled
+#define RENDER_WAIT_SLICE   10000
+
 void VideoRender::rendering() {
     LOGD("rendering: thread started");
     bool pendingEOS = false;
     bool firstFrame = true;
+    bool flushing = false;
+    // when the pending seek was requested, in monotonic time
+    int64_t seekTime = -1;
+    AVFrame* pendingFrame = nullptr;
+    // the next source of the playlist, see EVENT_SWITCH_SOURCE
+    Preroll* nextSource = nullptr;
+    // the frames are scheduled once the clock runs in the segment of their source
+    int clockSegment = clock->getSegment();
+    clock->setSegmentNotifier(&notifier);
+    scheduler.reset(ffWrapper->videoFPS());
     for (;;) {
         // Handle events
         Event ev;
         if (eventQueue.pop(ev)) {
-            if (ev.id == EVENT_STOP_THREAD) {
+            if (ev.id == EVENT_STOP_THREAD || ev.id == EVENT_FLUSH_START) {
+                if (ev.id == EVENT_FLUSH_START && nextSource) {
+                    // the frames of the previous source are dropped anyway
+                    switchSource(nextSource);
+                    nextSource = nullptr;
+                }
+                if (pendingFrame) {
+                    ffWrapper->freeFrame(pendingFrame);
+                    pendingFrame = nullptr;
+                }
                 while (!bufferQueue.empty()) {
                     AVFrame* frame = nullptr;
                     bufferQueue.pop(frame);
                     ffWrapper->freeFrame(frame);
                 }
+                if (ev.id == EVENT_FLUSH_START) {
+                    pendingEOS = false;
+                    flushing = true;
+                    seekTime = ev.value;
+                    static_cast<Notifier*>(ev.data)->notify();
+                    continue;
+                }
+                SchedulerStats stats = scheduler.stats();
+                LOGI("rendering: presented=%lld, dropped=%lld, repeated=%lld, jitter: %s",
+                     (long long)stats.presented, (long long)stats.dropped, (long long)stats.repeated,
+                     scheduler.jitter().toString().c_str());
+                clock->setSegmentNotifier(nullptr);
                 LOGD("rendering: thread exited");
                 break;
             };
@@ -28,81 +62,135 @@ void VideoRender::rendering() {
                 pendingEOS = true;
                 continue;
             }
+            if (ev.id == EVENT_SWITCH_SOURCE) {
+                nextSource = static_cast<Preroll*>(ev.data);
+                continue;
+            }
+            if (ev.id == EVENT_FLUSH_STOP) {
+                // the first frame at the new position is drawn at once, even when paused
+                flushing = false;
+                firstFrame = true;
+                scheduler.flush();
+                clockSegment = clock->getSegment();
+                static_cast<Notifier*>(ev.data)->notify();
+                continue;
+            }
+            continue;
+        }
+
+        // Flushing
+        if (flushing) {
+            notifier.wait();
             continue;
         }
 
         // Current is PAUSE
         if (!firstFrame && states.getCurrent() == STATE_PAUSED) {
-            LOGD("rendering: current state is STATE_PAUSED, will sleep 10ms");
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            LOGD("rendering: current state is STATE_PAUSED, wait for state change");
+            notifier.wait();
             continue;
         }
 
         // Current is STATE_PLAYING
-        AVFrame* frame = nullptr;
-        if (!bufferQueue.pop(frame)) {
+        AVFrame* frame = pendingFrame;
+        bool resumed = pendingFrame != nullptr;
+        pendingFrame = nullptr;
+        if (!frame && !bufferQueue.pop(frame)) {
+            if (nextSource) {
+                // the last frame of the previous source is shown, the decoder pushes the next ones
+                switchSource(nextSource);
+                nextSource = nullptr;
+                clockSegment++;
+                continue;
+            }
             if (pendingEOS) {
-                LOGD("rendering: end of stream, will sleep 10ms");
+                LOGD("rendering: end of stream, wait for events");
                 bus->sendMessage(Message(MESSAGE_EOS));
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                notifier.wait();
                 continue;
             }
-            LOGW("rendering, buffer queue is empty");
+            LOGW("rendering, buffer queue is empty, wait for buffers");
+            notifier.wait();
             continue;
         }
 
         // Always draw the first frame
         if (firstFrame) {
             firstFrame = false;
+            int64_t pts = frame->pts * ffWrapper->videoTimeBase() * 1000000;
             videoDevice->write(frame, sizeof(AVFrame));
+            if (startupTimer) {
+                startupTimer->mark(STARTUP_FIRST_DISPLAYED);
+            }
+            if (seekTime >= 0) {
+                lastSeekLatency.store(monotonicTime() - seekTime);
+                LOGI("rendering: first frame after seek is pts=%lldms, time to first frame is %lldms",
+                     (long long)pts/1000, (long long)lastSeekLatency.load()/1000);
+                seekTime = -1;
+            }
             continue;
         }
 
-        // Sync video displaying based on the given clock
-        using namespace std::chrono;
-        system_clock::time_point tp = system_clock::now();
-        double offset = frame->pts * ffWrapper->videoTimeBase() * 1000 - clock->runningTime()/1000;
-        double threshold = 500 / ffWrapper->videoFPS();
-        if (offset < 0.0f) {
-            // rendering speed is slower
-            if (offset > -threshold) {
-                LOGD("rendering: clock=%lldms, offset=%.6gms ( > %.6gms, write video fram)",
-                     clock->runningTime()/1000, offset, -threshold);
-                videoDevice->write(frame, sizeof(AVFrame));
-            } else {
-                LOGD("rendering: clock=%lldms, offset=%.6gms ( <= %.6gms, drop video frame)",
-                     clock->runningTime()/1000, offset, -threshold);
-                ffWrapper->freeFrame(frame);
-            }
-        } else {
-            // rendering speed is faster
-            if (offset > threshold) {
-                int64_t sleepDuration = offset - threshold;
-                // FIXME: if sleepDuration is too big, we shouldn't sleep too long duration.
-                if (sleepDuration > threshold) {
-                    LOGD("rendering: clock=%lldms, offset=%.6gms ( > %.6gms, write video frame)",
-                         clock->runningTime()/1000, offset, 2*threshold);
-                    videoDevice->write(frame, sizeof(AVFrame));
-                } else {
-                    LOGD("rendering: clock=%lldms, offset=%.6gms ( > %.6gms, sleep %lldms and write video frame)",
-                         clock->runningTime()/1000, offset, sleepDuration, threshold);
-                    std::this_thread::sleep_for(milliseconds(sleepDuration));
-                    videoDevice->write(frame, sizeof(AVFrame));
-                }
+        // The audio of the previous source is still playing, sleep until its last sample is played
+        // or, if the audio render didn't switch yet, until it does. events wake up earlier
+        int64_t remaining = clock->untilNextSegment();
+        if (clock->getSegment() < clockSegment) {
+            if (remaining < 0) {
+                notifier.wait();
             } else {
-                LOGD("rendering: clock=%lldms, offset=%.6gms ( <= %.6gms, write video frame)",
-                     clock->runningTime()/1000, offset, threshold);
-                videoDevice->write(frame, sizeof(AVFrame));
+                // just past the switch, in the time of the clock
+                notifier.waitUntil(monotonicTime() + remaining + 1000);
             }
+            pendingFrame = frame;
+            continue;
+        }
+
+        // Schedule the frame on the master clock
+        int64_t pts = frame->pts * ffWrapper->videoTimeBase() * 1000000;
+        int64_t deadline = 0;
+        FrameScheduler::Action action = scheduler.schedule(pts, clock->runningTime(), &deadline);
+        // let the decoder skip work while frames are late, once per frame
+        if (!resumed) {
+            Event qos(EVENT_QOS);
+            qos.value = scheduler.lateness();
+            videoDecoder->onEvent(qos);
         }
-        system_clock::duration d = system_clock::now() - tp;
-        LOGD("rendering: clock=%lldms, duration is %lldms",
-             clock->runningTime()/1000, duration_cast<milliseconds>(d).count());
+        if (action == FrameScheduler::ACTION_DROP) {
+            LOGD("rendering: clock=%lldms, pts=%lldms, drop video frame",
+                 (long long)clock->runningTime()/1000, (long long)pts/1000);
+            scheduler.dropped();
+            ffWrapper->freeFrame(frame);
+            continue;
+        }
+        if (!scheduler.waitUntil(deadline, RENDER_WAIT_SLICE)) {
+            pendingFrame = frame;
+            continue;
+        }
+        int64_t renderStart = monotonicTime();
+        videoDevice->write(frame, sizeof(AVFrame));
+        int64_t renderEnd = monotonicTime();
+        scheduler.presented(deadline, renderStart, renderEnd);
+        LOGD("rendering: clock=%lldms, pts=%lldms, late=%lldus, duration is %lldus",
+             (long long)clock->runningTime()/1000, (long long)pts/1000,
+             (long long)(renderStart - deadline), (long long)(renderEnd - renderStart));
     }
 }
 
+void VideoRender::switchSource(Preroll* preroll) {
+    ffWrapper = preroll->getEngine();
+    videoDevice->setProperty(VIDEO_ENGIN, ffWrapper);
+    scheduler.setFrameRate(ffWrapper->videoFPS());
+    scheduler.flush();
+    LOGD("switchSource: %s", preroll->getUrl().c_str());
+    Event switched(EVENT_SOURCE_SWITCHED);
+    switched.value = SWITCHED_VIDEO_RENDER;
+    videoDecoder->onEvent(switched);
+}
+
 VideoRender::VideoRender() {
     videoDevice = VideoDevice::create("SurfaceDevice"); 
+    eventQueue.setNotifiers(&notifier);
+    bufferQueue.setNotifiers(&notifier);
 }
 
 VideoRender::~VideoRender() {    
@@ -150,6 +238,7 @@ int VideoRender::toPaused() {
     }
     // current == STATE_PLAYING
     states.setCurrent(STATE_PAUSED);
+    notifier.notify();
     return STATUS_SUCCESS;
 }
 
@@ -160,6 +249,7 @@ int VideoRender::toPlaying() {
         return STATUS_FAILED;
     }
     states.setCurrent(STATE_PLAYING);
+    notifier.notify();
     return STATUS_SUCCESS;
 }
 
@@ -200,7 +290,3 @@ int VideoRender::onBuffer(const Buffer& buffer) {
     }
     return STATUS_SUCCESS;
 }
-
-bool VideoRender::BufferCompare::operator()(const AVFrame* lFrame, const AVFrame* rFrame) {
-    return lFrame->pts >= rFrame->pts;
-};
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include "video_device.h"
 #include "ffwrapper.h"
 #include "utils.h"
+#include "frame_scheduler.h"
+#include "preroll.h"
+#include "startup_timer.h"
 
 class VideoRender: public Element {
 
@@ -29,6 +32,9 @@ public:
     
     int onEvent(const Event& event) override;
     int onBuffer(const Buffer& buffer) override;
+    Notifier* getNotifier() override {
+        return &notifier;
+    }
 
 public:
     void setEngine(FFWrapper* ffWrapper) {
@@ -37,10 +43,24 @@ public:
     }
     void setSource(Element* videoDecoder) {
         this->videoDecoder = videoDecoder;
+        bufferQueue.setNotifiers(&notifier, videoDecoder->getNotifier());
     }
     void setSurface(void* surface) {
         videoDevice->setProperty(VIDEO_SURFACE, surface);
     }
+    // NOTES: marks the first displayed frame
+    void setStartupTimer(StartupTimer* startupTimer) {
+        this->startupTimer = startupTimer;
+    }
+    // NOTES: pacing counters of the current playback, read them from the rendering thread
+    //        or once it has stopped
+    SchedulerStats schedulerStats() {
+        return scheduler.stats();
+    }
+    // NOTES: in microseconds from the last seek request to its first frame on screen, -1 if none
+    int64_t seekLatency() {
+        return lastSeekLatency.load();
+    }
 
 private:
     int toNull();
@@ -48,20 +68,22 @@ private:
     int toPaused();
     int toPlaying();
     void rendering();
+    // NOTES: continues with the engine of the next source
+    void switchSource(Preroll* preroll);
 
 private:
     Clock* clock = nullptr;
     Bus* bus = nullptr;
     FFWrapper* ffWrapper = nullptr;
+    StartupTimer* startupTimer = nullptr;
     Element* videoDecoder = nullptr;
     States states;
     VideoDevice* videoDevice = nullptr;
     void* surface = nullptr;
     std::thread renderingThread;
     Queue<Event> eventQueue;
-private:
-    struct BufferCompare {
-        bool operator()(const AVFrame* lFrame, const AVFrame* rFrame);
-    };
-    PriorityQueue<AVFrame*, BufferCompare> bufferQueue;
+    Notifier notifier;
+    RingBuffer<AVFrame*> bufferQueue;
+    FrameScheduler scheduler;
+    std::atomic<int64_t> lastSeekLatency{-1};
 };
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <functional>
+#include "log.h"
+#include "utils.h"
+#include "video_scaler.h"
+
+#undef  LOG_TAG
+#define LOG_TAG "VideoScaler"
+
+// NOTES: frames smaller than this are not worth splitting
+#define MIN_SLICED_PIXELS   (1280*720)
+#define MIN_SLICE_HEIGHT    64
+
+static void getPlaneShifts(AVPixelFormat pix_fmt, int* shifts) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pix_fmt);
+    for (int i = 0; i < 4; i++) {
+        shifts[i] = 0;
+    }
+    if (!desc) {
+        return;
+    }
+    // components 1 and 2 are the chroma ones, they may share a plane (e.g. NV12)
+    for (int c = 0; c < desc->nb_components; c++) {
+        if (c == 1 || c == 2) {
+            shifts[desc->comp[c].plane] = desc->log2_chroma_h;
+        }
+    }
+}
+
+VideoScaler::~VideoScaler() {
+    release();
+}
+
+bool VideoScaler::init(int src_w, int src_h, AVPixelFormat src_pix_fmt,
+    int dst_w, int dst_h, AVPixelFormat dst_pix_fmt, int flags, int count) {
+    // the old contexts are reused by sws_getCachedContext() if their parameters match
+    std::vector<Slice> old;
+    old.swap(slices);
+    getPlaneShifts(src_pix_fmt, srcPlaneShift);
+    getPlaneShifts(dst_pix_fmt, dstPlaneShift);
+    dstPlanes = std::max(1, av_pix_fmt_count_planes(dst_pix_fmt));
+
+    if (count <= 0) {
+        count = 1;
+        if (int64_t(dst_w)*dst_h >= MIN_SLICED_PIXELS || int64_t(src_w)*src_h >= MIN_SLICED_PIXELS) {
+            count = std::min(ThreadPool::instance().size(), dst_h/MIN_SLICE_HEIGHT);
+        }
+    }
+    count = std::max(1, std::min(count, dst_h/2));
+
+    // slice boundaries are aligned to the chroma subsampling of both sides
+    int srcAlign = 1 << *std::max_element(srcPlaneShift, srcPlaneShift + 4);
+    int dstAlign = 1 << *std::max_element(dstPlaneShift, dstPlaneShift + 4);
+    int srcY = 0;
+    int dstY = 0;
+    for (int i = 1; i <= count; i++) {
+        Slice slice;
+        slice.srcY = srcY;
+        slice.dstY = dstY;
+        if (i == count) {
+            srcY = src_h;
+            dstY = dst_h;
+        } else {
+            dstY = dst_h*i/count/dstAlign*dstAlign;
+            srcY = int64_t(dstY)*src_h/dst_h/srcAlign*srcAlign;
+        }
+        slice.srcH = srcY - slice.srcY;
+        slice.dstH = dstY - slice.dstY;
+        if (slice.srcH <= 0 || slice.dstH <= 0) {
+            continue;
+        }
+        SwsContext* context = nullptr;
+        if (slices.size() < old.size()) {
+            context = old[slices.size()].context;
+            old[slices.size()].context = nullptr;
+        }
+        slice.context = sws_getCachedContext(context,
+            src_w, slice.srcH, src_pix_fmt,
+            dst_w, slice.dstH, dst_pix_fmt,
+            flags, nullptr, nullptr, nullptr);
+        if (!slice.context) {
+            LOGE("sws_getCachedContext failed: src_size=%dx%d, src_fmt=%s, dst_size=%dx%d, dst_fmt=%s",
+                src_w, slice.srcH, av_get_pix_fmt_name(src_pix_fmt),
+                dst_w, slice.dstH, av_get_pix_fmt_name(dst_pix_fmt));
+            for (Slice& o : old) {
+                sws_freeContext(o.context);
+            }
+            release();
+            return false;
+        }
+        slices.push_back(slice);
+    }
+    for (Slice& o : old) {
+        sws_freeContext(o.context);
+    }
+    LOGD("init succeed: src_size=%dx%d, src_fmt=%s, dst_size=%dx%d, dst_fmt=%s, slices=%d",
+        src_w, src_h, av_get_pix_fmt_name(src_pix_fmt),
+        dst_w, dst_h, av_get_pix_fmt_name(dst_pix_fmt), int(slices.size()));
+    return true;
+}
+
+void VideoScaler::release() {
+    for (Slice& slice : slices) {
+        sws_freeContext(slice.context);
+    }
+    slices.clear();
+}
+
+void VideoScaler::scaleSlice(const Slice& slice, const AVFrame* frame, uint8_t** dst_data, int* dst_linesize) {
+    const uint8_t* src[4] = {nullptr};
+    uint8_t* dst[4] = {nullptr};
+    for (int i = 0; i < 4; i++) {
+        if (frame->data[i]) {
+            src[i] = frame->data[i] + (slice.srcY >> srcPlaneShift[i])*frame->linesize[i];
+        }
+    }
+    // NOTES: dst_data/dst_linesize may only hold one plane for packed formats
+    int linesize[4] = {0};
+    for (int i = 0; i < dstPlanes; i++) {
+        dst[i] = dst_data[i] + (slice.dstY >> dstPlaneShift[i])*dst_linesize[i];
+        linesize[i] = dst_linesize[i];
+    }
+    sws_scale(slice.context, src, frame->linesize, 0, slice.srcH, dst, linesize);
+}
+
+void VideoScaler::scale(const AVFrame* frame, uint8_t** dst_data, int* dst_linesize) {
+    if (slices.size() == 1) {
+        scaleSlice(slices[0], frame, dst_data, dst_linesize);
+        return;
+    }
+    std::vector<std::function<void()>> tasks;
+    for (const Slice& slice : slices) {
+        const Slice* s = &slice;
+        tasks.push_back([this, s, frame, dst_data, dst_linesize] {
+            scaleSlice(*s, frame, dst_data, dst_linesize);
+        });
+    }
+    ThreadPool::instance().run(tasks);
+}
+
+
+VideoScalerCache::~VideoScalerCache() {
+    clear();
+}
+
+VideoScaler* VideoScalerCache::get(int src_w, int src_h, AVPixelFormat src_pix_fmt,
+    int dst_w, int dst_h, AVPixelFormat dst_pix_fmt, int flags) {
+    Key key = {src_w, src_h, src_pix_fmt, dst_w, dst_h, dst_pix_fmt, flags};
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->first == key) {
+            entries.splice(entries.begin(), entries, it);
+            return it->second;
+        }
+    }
+
+    // recycle the least recently used scaler if the cache is full
+    VideoScaler* scaler = nullptr;
+    if (entries.size() >= capacity && !entries.empty()) {
+        scaler = entries.back().second;
+        entries.pop_back();
+    } else {
+        scaler = new VideoScaler;
+    }
+    if (!scaler->init(src_w, src_h, src_pix_fmt, dst_w, dst_h, dst_pix_fmt, flags)) {
+        delete scaler;
+        return nullptr;
+    }
+    entries.push_front(std::make_pair(key, scaler));
+    return scaler;
+}
+
+void VideoScalerCache::clear() {
+    for (auto& entry : entries) {
+        delete entry.second;
+    }
+    entries.clear();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <list>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+//
+// Scales a video frame as horizontal slices, each slice has its own SwsContext and
+// runs on the shared thread pool. Small frames are scaled as one slice on the caller.
+//
+class VideoScaler {
+public:
+    VideoScaler() {}
+    ~VideoScaler();
+
+    // NOTES: slices 0 chooses the slice count from the frame size and the thread pool size
+    bool init(int src_w, int src_h, AVPixelFormat src_pix_fmt,
+        int dst_w, int dst_h, AVPixelFormat dst_pix_fmt,
+        int flags = SWS_BILINEAR, int slices = 0);
+    void release();
+    bool valid() {
+        return !slices.empty();
+    }
+    void scale(const AVFrame* frame, uint8_t** dst_data, int* dst_linesize);
+
+private:
+    struct Slice {
+        SwsContext* context = nullptr;
+        int srcY = 0;
+        int srcH = 0;
+        int dstY = 0;
+        int dstH = 0;
+    };
+    void scaleSlice(const Slice& slice, const AVFrame* frame, uint8_t** dst_data, int* dst_linesize);
+
+private:
+    std::vector<Slice> slices;
+    // vertical subsampling shift of each plane
+    int srcPlaneShift[4] = {0};
+    int dstPlaneShift[4] = {0};
+    int dstPlanes = 1;
+};
+
+
+//
+// Bounded LRU cache of video scalers keyed on the source/destination geometry and the
+// scale flags, so a size or format change never rebuilds the scaler it switches back to.
+//
+class VideoScalerCache {
+public:
+    VideoScalerCache(size_t capacity = 4) : capacity(capacity) {}
+    ~VideoScalerCache();
+
+    // NOTES: returns nullptr if the scaler can't be created
+    VideoScaler* get(int src_w, int src_h, AVPixelFormat src_pix_fmt,
+        int dst_w, int dst_h, AVPixelFormat dst_pix_fmt, int flags);
+    void clear();
+
+private:
+    struct Key {
+        int src_w;
+        int src_h;
+        AVPixelFormat src_pix_fmt;
+        int dst_w;
+        int dst_h;
+        AVPixelFormat dst_pix_fmt;
+        int flags;
+        bool operator==(const Key& k) const {
+            return src_w == k.src_w && src_h == k.src_h && src_pix_fmt == k.src_pix_fmt &&
+                dst_w == k.dst_w && dst_h == k.dst_h && dst_pix_fmt == k.dst_pix_fmt && flags == k.flags;
+        }
+    };
+    // the most recently used is at front
+    std::list<std::pair<Key, VideoScaler*>> entries;
+    size_t capacity;
+};
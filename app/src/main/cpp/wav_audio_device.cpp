@@ -0,0 +1,203 @@
+#include <string.h>
+#include <algorithm>
+#include "log.h"
+#include "ffwrapper.h"
+#include "wav_audio_device.h"
+
+#undef  LOG_TAG
+#define LOG_TAG "WavAudioDevice"
+
+// NOTES: how far write() may run ahead of the playback position, in milliseconds
+#define WAV_BUFFER_DURATION     200
+// NOTES: room for the samples a resampler delayed from the previous frames
+#define RESAMPLE_EXTRA_SAMPLES  256
+#define WAV_HEADER_SIZE         44
+
+static void putLE(uint8_t* p, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = uint8_t(v >> (8*i));
+    }
+}
+
+// NOTES: 16 bits stereo PCM, dataSize is patched when the file is closed
+static void fillWavHeader(uint8_t* h, int sampleRate, uint32_t dataSize) {
+    memcpy(h, "RIFF", 4);
+    putLE(h + 4, 36 + dataSize, 4);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    putLE(h + 16, 16, 4);
+    putLE(h + 20, 1, 2);
+    putLE(h + 22, 2, 2);
+    putLE(h + 24, sampleRate, 4);
+    putLE(h + 28, sampleRate*4, 4);
+    putLE(h + 32, 4, 2);
+    putLE(h + 34, 16, 2);
+    memcpy(h + 36, "data", 4);
+    putLE(h + 40, dataSize, 4);
+}
+
+WavAudioDevice::~WavAudioDevice() {
+    closeFile();
+    delete[] sampleBuffer;
+}
+
+bool WavAudioDevice::setProperty(int key, void* value) {
+    switch (key) {
+    case AUDIO_ENGIN:
+        // the resampler of the new engine is set up by the next write
+        ffWrapper = static_cast<FFWrapper*>(value);
+        frameFormat = -1;
+        break;
+    case AUDIO_SAMPLE_BUFFER_SIZE:
+        sampleBufferSize = std::max(sampleBufferSize, *static_cast<int*>(value));
+        break;
+    case AUDIO_SAMPLE_RATE:
+        {
+            std::unique_lock<std::mutex> lock(m);
+            sampleRate = *static_cast<int*>(value);
+            frameFormat = -1;
+            writtenFrames = 0;
+            playedBase = 0;
+        }
+        break;
+    case AUDIO_SAMPLE_FORMAT:
+        if (*static_cast<int*>(value) != AV_SAMPLE_FMT_S16) {
+            LOGW("setProperty: only AV_SAMPLE_FMT_S16 is supported");
+        }
+        break;
+    case AUDIO_FILE_PATH:
+        closeFile();
+        path = value ? static_cast<const char*>(value) : "";
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+int WavAudioDevice::getSampleFormat() {
+    return AV_SAMPLE_FMT_S16;
+}
+
+int64_t WavAudioDevice::playedFrames() {
+    if (!playing) {
+        return playedBase;
+    }
+    int64_t elapsed = monotonicTime() - startTime;
+    return std::min(writtenFrames, playedBase + elapsed*sampleRate/1000000);
+}
+
+int WavAudioDevice::getPlaybackPosition() {
+    std::unique_lock<std::mutex> lock(m);
+    return int(playedFrames());
+}
+
+int WavAudioDevice::write(void* buf, int buflen) {
+    AVFrame* frame = static_cast<AVFrame*>(buf);
+    if (sampleRate <= 0) {
+        std::unique_lock<std::mutex> lock(m);
+        sampleRate = frame->sample_rate;
+    }
+    if (frameRate != frame->sample_rate || frameFormat != frame->format) {
+        // the output keeps its rate, like the track of AudioTrackDevice
+        ffWrapper->setAudioResample(frame, AV_CH_LAYOUT_STEREO, sampleRate, AV_SAMPLE_FMT_S16);
+        frameRate = frame->sample_rate;
+        frameFormat = frame->format;
+    }
+
+    int maxSamples = av_rescale_rnd(frame->nb_samples, sampleRate, frame->sample_rate, AV_ROUND_UP) + RESAMPLE_EXTRA_SAMPLES;
+    if (!sampleBuffer || sampleBufferSize < 2 * 2 * maxSamples) {
+        delete[] sampleBuffer;
+        sampleBufferSize = std::max(sampleBufferSize, 2 * 2 * maxSamples);
+        sampleBuffer = new uint8_t[sampleBufferSize];
+    }
+    int samples = ffWrapper->resampleAudio(frame, &sampleBuffer, maxSamples);
+    int sampleSize = 2 * 2 * samples;
+    ffWrapper->freeFrame(frame);
+
+    if (!path.empty() && (file || openFile())) {
+        fileBytes += fwrite(sampleBuffer, 1, sampleSize, file);
+    }
+
+    std::unique_lock<std::mutex> lock(m);
+    if (playing && playedFrames() == writtenFrames) {
+        // underrun, playback resumes from the new samples
+        playedBase = writtenFrames;
+        startTime = monotonicTime();
+    }
+    writtenFrames += samples;
+    if (playing && sampleRate > 0) {
+        int64_t ahead = writtenFrames - playedFrames() - int64_t(sampleRate)*WAV_BUFFER_DURATION/1000;
+        if (ahead > 0) {
+            lock.unlock();
+            TimeSource::current()->sleepFor(ahead*1000000/sampleRate);
+        }
+    }
+    return sampleSize;
+}
+
+void WavAudioDevice::play() {
+    std::unique_lock<std::mutex> lock(m);
+    if (!playing) {
+        playing = true;
+        startTime = monotonicTime();
+    }
+}
+
+void WavAudioDevice::pause() {
+    std::unique_lock<std::mutex> lock(m);
+    playedBase = playedFrames();
+    playing = false;
+}
+
+void WavAudioDevice::flush() {
+    // NOTES: like AudioTrack, only works while paused, the samples not played yet are dropped
+    //        and the playback position restarts from 0
+    std::unique_lock<std::mutex> lock(m);
+    if (!playing) {
+        writtenFrames = 0;
+        playedBase = 0;
+    }
+}
+
+void WavAudioDevice::stop() {
+    pause();
+    // the file stays open, playback may restart after a seek
+    updateFile();
+}
+
+bool WavAudioDevice::openFile() {
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        LOGE("openFile: fopen(%s) failed", path.c_str());
+        path.clear();
+        return false;
+    }
+    uint8_t header[WAV_HEADER_SIZE];
+    fillWavHeader(header, sampleRate, 0);
+    fwrite(header, 1, sizeof(header), file);
+    fileBytes = 0;
+    LOGI("openFile: %s, sample_rate=%d", path.c_str(), sampleRate);
+    return true;
+}
+
+void WavAudioDevice::updateFile() {
+    if (!file) {
+        return;
+    }
+    uint8_t header[WAV_HEADER_SIZE];
+    fillWavHeader(header, sampleRate, uint32_t(fileBytes));
+    fseek(file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), file);
+    fseek(file, 0, SEEK_END);
+    fflush(file);
+}
+
+void WavAudioDevice::closeFile() {
+    if (!file) {
+        return;
+    }
+    updateFile();
+    fclose(file);
+    file = nullptr;
+    LOGI("closeFile: %s, %lld bytes", path.c_str(), (long long)fileBytes);
+}
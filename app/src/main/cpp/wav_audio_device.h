@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <mutex>
+#include "audio_device.h"
+
+class FFWrapper;
+
+//
+// Host stand-in of AudioTrackDevice without JNI. Samples are converted to S16 stereo the same way,
+// consumed in real time (write() blocks once enough is buffered, like a blocking AudioTrack) and
+// saved to a WAV file if AUDIO_FILE_PATH is set, otherwise they are dropped as by a null sink.
+//
+class WavAudioDevice: public AudioDevice {
+public:
+    WavAudioDevice() {}
+    ~WavAudioDevice();
+
+    bool setProperty(int key, void* value) override;
+    int getSampleRate() override {
+        return sampleRate;
+    }
+    int getSampleFormat() override;
+    int getChannels() override {
+        return 2;
+    }
+    int getPlaybackPosition() override;
+    int write(void* buf, int buflen) override;
+    void play() override;
+    void pause() override;
+    void flush() override;
+    void stop() override;
+
+private:
+    // NOTES: should be called with the lock held
+    int64_t playedFrames();
+    bool openFile();
+    // NOTES: patches the sizes in the header
+    void updateFile();
+    void closeFile();
+
+private:
+    std::mutex m;
+    FFWrapper* ffWrapper = nullptr;
+    // of the output
+    int sampleRate = 0;
+    // of the frames the resampler is set up for
+    int frameRate = 0;
+    int frameFormat = -1;
+    uint8_t* sampleBuffer = nullptr;
+    int sampleBufferSize = 0;
+    std::string path;
+    FILE* file = nullptr;
+    int64_t fileBytes = 0;
+    bool playing = false;
+    int64_t writtenFrames = 0;
+    // frames played before startTime
+    int64_t playedBase = 0;
+    // in microseconds of the monotonic time
+    int64_t startTime = 0;
+};
@@ -36,6 +36,7 @@ public class MainActivity extends Activity {
     private SeekBar seek = null;
     private TextView position = null;
     private TextView duration = null;
+    private Player player = null;
 
 
     @Override
@@ -51,10 +52,13 @@ public class MainActivity extends Activity {
                 WindowManager.LayoutParams.FLAG_FULLSCREEN);
 
 
+        player = new Player();
+
         // For xiaomi phone
         String url = "/storage/6464-3563/MyFiles/videos/music.avi";
         if (new File(url).canRead()) {
-            Player.setDataSource(url);
+            player.setIndexDirectory(getCacheDir().getAbsolutePath());
+            player.setDataSource(url);
         }
 
         SurfaceView playbackSurface = new SurfaceView(this);
@@ -112,9 +116,9 @@ public class MainActivity extends Activity {
                         if (System.currentTimeMillis() - downTime < 500) {
                             if (surfaceCreated) {
                                 if (isPlaying) {
-                                    Player.pause();
+                                    player.pause();
                                 } else {
-                                    Player.play();
+                                    player.play();
                                 }
                                 isPlaying = !isPlaying;
                             }
@@ -132,14 +136,14 @@ public class MainActivity extends Activity {
             public void surfaceCreated(SurfaceHolder holder) {
                 Log.i(TAG, "surfaceCreated");
                 surfaceCreated = true;
-                Player.setSurface(holder.getSurface());
+                player.setSurface(holder.getSurface());
                 stopThread = false;
                 new Thread(new Runnable() {
                     @Override
                     public void run() {
                         while (!stopThread) {
-                            int pos = Player.getPosition();
-                            int du = Player.getDuration();
+                            int pos = player.getPosition();
+                            int du = player.getDuration();
                             Message msg = Message.obtain();
                             msg.arg1 = pos;
                             msg.arg2 = du;
@@ -158,7 +162,7 @@ public class MainActivity extends Activity {
             public void surfaceChanged(SurfaceHolder holder, int format, int width, int height) {
                 Log.i(TAG, "surfaceChanged");
                 if (!isPlaying) {
-                    Player.play();
+                    player.play();
                     isPlaying = true;
                 }
             }
@@ -167,9 +171,9 @@ public class MainActivity extends Activity {
             public void surfaceDestroyed(SurfaceHolder holder) {
                 Log.i(TAG, "surfaceDestroyed");
                 if (isPlaying) {
-                    Player.stop();
+                    player.stop();
                 }
-                stopThread = false;
+                stopThread = true;
                 surfaceCreated = false;
             }
         });
@@ -193,11 +197,11 @@ public class MainActivity extends Activity {
             @Override
             public void onStopTrackingTouch(SeekBar seekBar) {
                 if (surfaceCreated) {
-                    Player.seek(1000*mProgress);
+                    player.seek(1000*mProgress);
                     if (isPlaying)
-                        Player.play();
+                        player.play();
                     else
-                        Player.pause();
+                        player.pause();
                 }
             }
         });
@@ -232,11 +236,19 @@ public class MainActivity extends Activity {
         Log.d(TAG, "onPause");
         super.onPause();
         if (isPlaying) {
-            Player.pause();
+            player.pause();
             isPlaying = false;
         }
     }
 
+    @Override
+    protected void onDestroy() {
+        Log.d(TAG, "onDestroy");
+        super.onDestroy();
+        stopThread = true;
+        player.release();
+    }
+
     @Override
     public void onRequestPermissionsResult(int requestCode, String[] permissions, int[] grantResults) {
         super.onRequestPermissionsResult(requestCode, permissions, grantResults);
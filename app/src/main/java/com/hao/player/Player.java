@@ -1,8 +1,35 @@
 package com.hao.player;
 
 import android.view.Surface;
+import java.nio.ByteBuffer;
 
 public class Player {
+    // video scale quality profiles, see ffwrapper.h
+    public static final int SCALE_QUALITY_FAST = 0;
+    public static final int SCALE_QUALITY_DEFAULT = 1;
+    public static final int SCALE_QUALITY_HIGH = 2;
+    // seek modes, see player.h
+    public static final int SEEK_MODE_KEYFRAME = 0;
+    public static final int SEEK_MODE_ACCURATE = 1;
+    // startup phases, the indexes of getStartupTimes(), see startup_timer.h
+    public static final int STARTUP_OPENED = 0;
+    public static final int STARTUP_PROBED = 1;
+    public static final int STARTUP_CODECS_OPENED = 2;
+    public static final int STARTUP_FIRST_PACKET = 3;
+    public static final int STARTUP_FIRST_DECODED = 4;
+    public static final int STARTUP_FIRST_DISPLAYED = 5;
+    // video quality of service stats, the indexes of getQoSStats(), see player.h
+    public static final int QOS_LEVEL = 0;
+    public static final int QOS_REPORTS = 1;
+    public static final int QOS_LEVEL_CHANGES = 2;
+    public static final int QOS_FILTER_SKIPPED_FRAMES = 3;
+    public static final int QOS_DECODER_SKIPPED_FRAMES = 4;
+    public static final int QOS_SKIPPED_PACKETS = 5;
+    // input modes of local files, see file_input.h
+    public static final int INPUT_MODE_DEFAULT = 0;
+    public static final int INPUT_MODE_MMAP = 1;
+    public static final int INPUT_MODE_READ_AHEAD = 2;
+
     static {
         System.loadLibrary("avutil");
         System.loadLibrary("avcodec");
@@ -12,14 +39,127 @@ public class Player {
         System.loadLibrary("haoplayer");
         nativeInit();
     }
+
+    // the native player, 0 once released
+    private long nativeHandle;
+
+    public Player() {
+        nativeHandle = nativeCreate();
+    }
+
+    // stops playing and frees the native player, the object can't be used afterwards
+    public synchronized void release() {
+        nativeRelease(nativeHandle);
+        nativeHandle = 0;
+    }
+
+    public synchronized void setSurface(Surface surface) {
+        nativeSetSurface(nativeHandle, surface);
+    }
+
+    public synchronized void setDataSource(String source) {
+        nativeSetDataSource(nativeHandle, source);
+    }
+
+    // plays the media in a direct buffer in place, its content must not change until stop() or
+    // release(). name, which may be null, identifies the media for a fast start
+    public synchronized void setDataSource(ByteBuffer buffer, String name) {
+        nativeSetDataSourceBuffer(nativeHandle, buffer, name);
+    }
+
+    // sources appended are played after the data source without a gap, each one is opened
+    // and decoded ahead while the one before it plays
+    public synchronized void appendDataSource(String source) {
+        nativeAppendDataSource(nativeHandle, source);
+    }
+
+    public synchronized void clearPlaylist() {
+        nativeClearPlaylist(nativeHandle);
+    }
+
+    public synchronized void setIndexDirectory(String directory) {
+        nativeSetIndexDirectory(nativeHandle, directory);
+    }
+
+    // http(s) media is cached in directory, shared by all players, up to capacity bytes, so
+    // replays and seeks back don't download it again. null disables it, should be called before play()
+    public synchronized void setCacheDirectory(String directory, long capacity) {
+        nativeSetCacheDirectory(nativeHandle, directory, capacity);
+    }
+
+    public synchronized void play() {
+        nativePlay(nativeHandle);
+    }
+
+    public synchronized void pause() {
+        nativePause(nativeHandle);
+    }
+
+    public synchronized void stop() {
+        nativeStop(nativeHandle);
+    }
+
+    public synchronized void seek(int position) {
+        nativeSeek(nativeHandle, position);
+    }
+
+    public synchronized void setSeekMode(int mode) {
+        nativeSetSeekMode(nativeHandle, mode);
+    }
+
+    public synchronized void setVideoScaleQuality(int quality) {
+        nativeSetVideoScaleQuality(nativeHandle, quality);
+    }
+
+    public synchronized int getDuration() {
+        return nativeGetDuration(nativeHandle);
+    }
+
+    public synchronized int getPosition() {
+        return nativeGetPosition(nativeHandle);
+    }
+
+    // probes less of the data source, or nothing if it was opened before, should be called before play()
+    public synchronized void setFastStart(boolean enabled) {
+        nativeSetFastStart(nativeHandle, enabled);
+    }
+
+    // how local files are read, blockSize bytes times blockCount are read ahead of the demuxer,
+    // 0 keeps the default size or count. should be called before play()
+    public synchronized void setInputMode(int mode, int blockSize, int blockCount) {
+        nativeSetInputMode(nativeHandle, mode, blockSize, blockCount);
+    }
+
+    // milliseconds from play() to each STARTUP_XXX phase, -1 for the ones not reached yet
+    public synchronized int[] getStartupTimes() {
+        return nativeGetStartupTimes(nativeHandle);
+    }
+
+    // the QOS_XXX stats of the video decoder since play(), kept across seeks and playlist switches
+    public synchronized long[] getQoSStats() {
+        return nativeGetQoSStats(nativeHandle);
+    }
+
     private native static void nativeInit();
-    public native static void setSurface(Surface surface);
-    public native static void setDataSource(String source);
-    public native static void play();
-    public native static void pause();
-    public native static void stop();
-    public native static void seek(int position);
-    public native static int getDuration();
-    public native static int getPosition();
+    private native static long nativeCreate();
+    private native static void nativeRelease(long handle);
+    private native static void nativeSetSurface(long handle, Surface surface);
+    private native static void nativeSetDataSource(long handle, String source);
+    private native static void nativeSetDataSourceBuffer(long handle, ByteBuffer buffer, String name);
+    private native static void nativeAppendDataSource(long handle, String source);
+    private native static void nativeClearPlaylist(long handle);
+    private native static void nativeSetIndexDirectory(long handle, String directory);
+    private native static void nativeSetCacheDirectory(long handle, String directory, long capacity);
+    private native static void nativePlay(long handle);
+    private native static void nativePause(long handle);
+    private native static void nativeStop(long handle);
+    private native static void nativeSeek(long handle, int position);
+    private native static void nativeSetSeekMode(long handle, int mode);
+    private native static void nativeSetVideoScaleQuality(long handle, int quality);
+    private native static int nativeGetDuration(long handle);
+    private native static int nativeGetPosition(long handle);
+    private native static void nativeSetFastStart(long handle, boolean enabled);
+    private native static int[] nativeGetStartupTimes(long handle);
+    private native static long[] nativeGetQoSStats(long handle);
+    private native static void nativeSetInputMode(long handle, int mode, int blockSize, int blockCount);
 }
-
@@ -0,0 +1,82 @@
+package com.hao.player;
+
+import android.graphics.Bitmap;
+import java.nio.ByteBuffer;
+
+// Seek bar previews of a media file, made without a Player, see thumbnail_engine.h
+public class ThumbnailEngine {
+    // a grid of thumbnails, tile i is at column i % columns and row i / columns
+    public static class Sprite {
+        public Bitmap bitmap;
+        public int tileWidth;
+        public int tileHeight;
+        public int columns;
+        public int rows;
+        // in milliseconds, the position of each tile, -1 if it couldn't be made
+        public int[] positions;
+    }
+
+    static {
+        System.loadLibrary("avutil");
+        System.loadLibrary("avcodec");
+        System.loadLibrary("avformat");
+        System.loadLibrary("swresample");
+        System.loadLibrary("swscale");
+        System.loadLibrary("haoplayer");
+    }
+
+    // the native engine, 0 once released
+    private long nativeHandle;
+
+    // workers 0 means one per cpu core
+    public ThumbnailEngine(int workers) {
+        nativeHandle = nativeCreate(workers);
+    }
+
+    // closes the sessions of the workers, the object can't be used afterwards
+    public synchronized void release() {
+        nativeRelease(nativeHandle);
+        nativeHandle = 0;
+    }
+
+    // returns false if the source has no decodable video
+    public synchronized boolean open(String source) {
+        return nativeOpen(nativeHandle, source);
+    }
+
+    // in milliseconds, 0 if unknown
+    public synchronized int getDuration() {
+        return nativeGetDuration(nativeHandle);
+    }
+
+    // count thumbnails from the middle of count equal parts of the duration, null if none could
+    // be made. it decodes on worker threads and blocks until they are done, so not on the ui thread
+    public synchronized Sprite generate(int count, int tileWidth, int tileHeight, int columns) {
+        if (count <= 0 || tileWidth <= 0 || tileHeight <= 0 || columns <= 0) {
+            return null;
+        }
+        int[] positions = new int[count];
+        byte[] pixels = nativeGenerate(nativeHandle, count, tileWidth, tileHeight, columns, positions);
+        if (pixels == null) {
+            return null;
+        }
+        Sprite sprite = new Sprite();
+        sprite.tileWidth = tileWidth;
+        sprite.tileHeight = tileHeight;
+        sprite.columns = Math.min(columns, count);
+        sprite.rows = (count + sprite.columns - 1) / sprite.columns;
+        sprite.positions = positions;
+        // the pixels are RGBA bytes, which is how an ARGB_8888 bitmap is laid out in memory
+        sprite.bitmap = Bitmap.createBitmap(sprite.columns * tileWidth, sprite.rows * tileHeight,
+            Bitmap.Config.ARGB_8888);
+        sprite.bitmap.copyPixelsFromBuffer(ByteBuffer.wrap(pixels));
+        return sprite;
+    }
+
+    private native static long nativeCreate(int workers);
+    private native static void nativeRelease(long handle);
+    private native static boolean nativeOpen(long handle, String source);
+    private native static int nativeGetDuration(long handle);
+    private native static byte[] nativeGenerate(long handle, int count, int tileWidth, int tileHeight,
+        int columns, int[] positions);
+}